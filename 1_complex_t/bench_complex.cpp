@@ -0,0 +1,165 @@
+/*
+  complex_t benchmark: batch division against std::complex, fused
+  complex_array expressions against chained loops, and sorting and
+  deduplication of complex_polar_t values in every data distribution.
+  usage: bench_complex [--size 1K,1M] [--dist few-unique] ... (see --help)
+*/
+
+#include <complex>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <memory>
+
+#include <bench_suite.hpp>
+
+#include "complex_t.hpp"
+#include "complex_array.hpp"
+
+static void DIVISION_BENCHMARKS( shared::bench_suite& suite, std::size_t size,
+  unsigned seed )
+{
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<> dis(-1e3, 1e3);
+  std::vector<double> num_re(size), num_im(size), den_re(size), den_im(size);
+  std::vector<double> out_re(size), out_im(size);
+  std::vector< std::complex<double> > cpp_num(size), cpp_den(size), cpp_out(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    num_re[i] = dis(gen); num_im[i] = dis(gen);
+    den_re[i] = dis(gen); den_im[i] = dis(gen);
+    cpp_num[i] = std::complex<double>( num_re[i], num_im[i] );
+    cpp_den[i] = std::complex<double>( den_re[i], den_im[i] );
+  }
+
+  suite.run( "division, std::complex", "std::complex<double>",
+    "std::allocator", size,
+    [&]() {
+      for (std::size_t i = 0; i < size; ++i)
+        cpp_out[i] = cpp_num[i] / cpp_den[i];
+      shared::clobber_memory();
+    } );
+  suite.run( "division, complex_division::fast", "double[2]",
+    "std::allocator", size,
+    [&]() {
+      complex_divide<complex_division::fast>( num_re.data(), num_im.data(),
+        den_re.data(), den_im.data(), out_re.data(), out_im.data(), size );
+      shared::clobber_memory();
+    } );
+  suite.run( "division, complex_division::smith", "double[2]",
+    "std::allocator", size,
+    [&]() {
+      complex_divide<complex_division::smith>( num_re.data(), num_im.data(),
+        den_re.data(), den_im.data(), out_re.data(), out_im.data(), size );
+      shared::clobber_memory();
+    } );
+}
+
+// a = b * c + d
+static void EXPRESSION_BENCHMARKS( shared::bench_suite& suite, std::size_t size,
+  unsigned seed )
+{
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<> dis(-1e3, 1e3);
+  std::vector<complex_t> vec_b(size), vec_c(size), vec_d(size), vec_a(size);
+  complex_array arr_b(size), arr_c(size), arr_d(size), arr_a(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    vec_b[i] = complex_t( dis(gen), dis(gen) );
+    vec_c[i] = complex_t( dis(gen), dis(gen) );
+    vec_d[i] = complex_t( dis(gen), dis(gen) );
+    arr_b.set( i, vec_b[i] );
+    arr_c.set( i, vec_c[i] );
+    arr_d.set( i, vec_d[i] );
+  }
+
+  // one pass per operator, materializing the intermediate array
+  std::vector<complex_t> temp(size);
+  suite.run( "b * c + d, chained arrays", "complex_t", "std::allocator", size,
+    [&]() {
+      for (std::size_t i = 0; i < size; ++i) { temp[i] = vec_b[i] * vec_c[i]; }
+      for (std::size_t i = 0; i < size; ++i) { vec_a[i] = temp[i] + vec_d[i]; }
+      shared::clobber_memory();
+    } );
+  suite.run( "b * c + d, compound operators", "complex_t", "std::allocator",
+    size,
+    [&]() {
+      for (std::size_t i = 0; i < size; ++i) {
+        vec_a[i] = vec_b[i];
+        vec_a[i] *= vec_c[i];
+        vec_a[i] += vec_d[i];
+      }
+      shared::clobber_memory();
+    } );
+  suite.run( "b * c + d, complex_array fused", "complex_array",
+    "std::allocator", size,
+    [&]() { arr_a = arr_b * arr_c + arr_d; shared::clobber_memory(); } );
+}
+
+static void POLAR_BENCHMARKS( shared::bench_suite& suite, const std::string& dist,
+  const std::vector<std::size_t>& keys )
+{
+  const std::size_t size = keys.size();
+  // golden angle steps, up to 8 turns, so most angles need normalizing
+  const auto make_value = []( std::size_t k ) {
+    return complex_polar_t( 1.0 + k % 7,
+      2.399963229728653 * (k % 8192) - 8.0 * M_PI );
+  };
+  std::vector<complex_polar_t> unsorted, values;
+  unsorted.reserve( size );
+  for (std::size_t k : keys) { unsorted.push_back( make_value(k) ); }
+
+  suite.run( "complex_polar_t construction, " + dist, "complex_polar_t",
+    "std::allocator", size,
+    [&]() { values.clear(); values.reserve( size ); },
+    [&]() {
+      for (std::size_t k : keys) { values.push_back( make_value(k) ); }
+      shared::clobber_memory();
+    } );
+
+  const auto by_radius_angle =
+    []( const complex_polar_t& a, const complex_polar_t& b ) {
+      return (a.radius < b.radius) ||
+             (a.radius == b.radius && a.angle < b.angle);
+    };
+  suite.run( "complex_polar_t std::sort, " + dist, "complex_polar_t",
+    "std::allocator", size,
+    [&]() { values = unsorted; },
+    [&]() {
+      std::sort( values.begin(), values.end(), by_radius_angle );
+      shared::clobber_memory();
+    } );
+
+  if ( size < 2 ) { return; }
+  values = unsorted;
+  std::sort( values.begin(), values.end(), by_radius_angle );
+  std::unique_ptr<bool[]> result( new bool[size-1] );
+  suite.run( "complex_polar_t complex_equal of neighbours, " + dist,
+    "complex_polar_t", "std::allocator", size,
+    [&]() {
+      shared::do_not_optimize( complex_equal( values.data(), values.data()+1,
+        result.get(), size-1 ) );
+    } );
+}
+
+int main( int argc, char* argv[] ) {
+  shared::bench_suite suite( argc, argv );
+  if (!suite) { return 2; }
+  const shared::bench_options& opts = suite.options();
+
+  for (std::size_t size : opts.sizes) {
+    const std::string count = std::to_string(size);
+    suite.section( "division, " + count + " values" );
+    DIVISION_BENCHMARKS( suite, size, opts.seed );
+    suite.section( "expressions, " + count + " values" );
+    EXPRESSION_BENCHMARKS( suite, size, opts.seed );
+
+    std::vector<std::size_t> keys( size );
+    for (shared::data_distribution d : opts.distributions) {
+      const std::string dist = shared::distribution_name(d);
+      suite.section( "complex_polar_t, " + count + " " + dist + " values" );
+      shared::fill_data( keys, d, opts.seed );
+      POLAR_BENCHMARKS( suite, dist, keys );
+    }
+  }
+  return suite.finish();
+}
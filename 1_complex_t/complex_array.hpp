@@ -0,0 +1,255 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <stdexcept>
+
+#include "complex_t.hpp"
+
+/*
+  Expression templates over arrays of complex numbers.
+  Values are stored split (real and imaginary parts in separate arrays), and
+  whole expressions like "a = b * c + d" are evaluated in one loop without
+  temporaries. Products followed by a sum are fused into FMA instructions
+  when the target has them (FP_FAST_FMA). Arrays in one expression must
+  have the same size, std::invalid_argument is thrown otherwise.
+*/
+
+namespace complex_expression {
+  typedef std::size_t size_type;
+
+  inline double fma( double a, double b, double c ) {
+    #ifdef FP_FAST_FMA
+      return std::fma( a, b, c );
+    #else
+      return a*b + c;
+    #endif
+  }
+
+  // size() of a scalar, which fits any array
+  static const size_type broadcast = static_cast<size_type>(-1);
+
+  // the size of a node over operands of sizes a and b
+  inline size_type common_size( size_type a, size_type b ) {
+    if ( a == broadcast ) { return b; }
+    if ( b == broadcast || a == b ) { return a; }
+    throw std::invalid_argument( "complex_array: operand sizes differ" );
+  }
+
+  // every expression node provides size() and eval(i, re, im)
+  template< class E >
+  struct base {
+    inline const E& self() const { return static_cast<const E&>(*this); }
+  };
+
+  /* element operations, same signature as complex_division policies */
+  struct op_add {
+    static inline void apply( double a, double b, double c, double d,
+      double& re, double& im ) { re = a + c; im = b + d; }
+  };
+  struct op_sub {
+    static inline void apply( double a, double b, double c, double d,
+      double& re, double& im ) { re = a - c; im = b - d; }
+  };
+  struct op_mul {
+    static inline void apply( double a, double b, double c, double d,
+      double& re, double& im ) { re = fma( a, c, -b*d ); im = fma( a, d, b*c ); }
+  };
+  typedef COMPLEX_T_DIVISION op_div;
+
+  // complex_t broadcast over the whole expression
+  struct scalar : base<scalar> {
+    const double real, imag;
+    explicit scalar( const complex_t& c ): real(c.real), imag(c.imag) {}
+    inline size_type size() const { return broadcast; }
+    inline void eval( size_type, double& re, double& im ) const {
+      re = real; im = imag;
+    }
+  };
+
+  // arrays are held by reference, intermediate nodes by value
+  template< class E >
+  struct operand { typedef const E type; };
+
+  template< class Op, class L, class R >
+  struct binary : base< binary<Op, L, R> > {
+    typename operand<L>::type left;
+    typename operand<R>::type right;
+    const size_type count;
+
+    binary( const L& l, const R& r )
+    : left(l), right(r), count( common_size( l.size(), r.size() ) ) {}
+
+    inline size_type size() const { return count; }
+
+    inline void eval( size_type i, double& re, double& im ) const {
+      double l_re, l_im, r_re, r_im;
+      left.eval( i, l_re, l_im );
+      right.eval( i, r_re, r_im );
+      Op::apply( l_re, l_im, r_re, r_im, re, im );
+    }
+  };
+
+  // x * y + z, two FMAs per component
+  template< class X, class Y, class Z >
+  struct muladd : base< muladd<X, Y, Z> > {
+    typename operand<X>::type x;
+    typename operand<Y>::type y;
+    typename operand<Z>::type z;
+    const size_type count;
+
+    muladd( const X& x_, const Y& y_, const Z& z_ )
+    : x(x_), y(y_), z(z_),
+      count( common_size( common_size( x_.size(), y_.size() ), z_.size() ) ) {}
+
+    inline size_type size() const { return count; }
+
+    inline void eval( size_type i, double& re, double& im ) const {
+      double x_re, x_im, y_re, y_im, z_re, z_im;
+      x.eval( i, x_re, x_im );
+      y.eval( i, y_re, y_im );
+      z.eval( i, z_re, z_im );
+      re = fma( x_re, y_re, fma( -x_im, y_im, z_re ) );
+      im = fma( x_re, y_im, fma( x_im, y_re, z_im ) );
+    }
+  };
+} //end of namespace "complex_expression"
+
+/* ========================================================================== */
+
+class complex_array : public complex_expression::base<complex_array> {
+  public:
+    typedef complex_expression::size_type size_type;
+
+  private:
+    std::vector<double> re_data;
+    std::vector<double> im_data;
+
+  public:
+    explicit complex_array( size_type count = 0,
+      const complex_t& value = complex_t() )
+    : re_data(count, value.real), im_data(count, value.imag) {}
+
+    template< class E >
+    complex_array( const complex_expression::base<E>& expr ) {
+      assign( expr.self() );
+    }
+
+    template< class E >
+    complex_array& operator= ( const complex_expression::base<E>& expr ) {
+      assign( expr.self() );
+      return (*this);
+    }
+
+    /* data access */
+    inline size_type size() const { return re_data.size(); }
+
+    inline complex_t operator[] ( size_type pos ) const {
+      return complex_t( re_data[pos], im_data[pos] );
+    }
+
+    inline void set( size_type pos, const complex_t& value ) {
+      re_data[pos] = value.real;
+      im_data[pos] = value.imag;
+    }
+
+    inline const double* real() const { return re_data.data(); }
+    inline double* real() { return re_data.data(); }
+    inline const double* imag() const { return im_data.data(); }
+    inline double* imag() { return im_data.data(); }
+
+    inline void eval( size_type i, double& re, double& im ) const {
+      re = re_data[i];
+      im = im_data[i];
+    }
+
+    /* compound assignment, evaluated in place */
+    template< class E >
+    complex_array& operator+= ( const complex_expression::base<E>& expr ) {
+      return apply<complex_expression::op_add>( expr.self() );
+    }
+    template< class E >
+    complex_array& operator-= ( const complex_expression::base<E>& expr ) {
+      return apply<complex_expression::op_sub>( expr.self() );
+    }
+    template< class E >
+    complex_array& operator*= ( const complex_expression::base<E>& expr ) {
+      return apply<complex_expression::op_mul>( expr.self() );
+    }
+    template< class E >
+    complex_array& operator/= ( const complex_expression::base<E>& expr ) {
+      return apply<complex_expression::op_div>( expr.self() );
+    }
+
+  private:
+    // element i of the result depends only on element i of the operands,
+    // so evaluating straight into our own storage is safe even if aliased
+    template< class E >
+    void assign( const E& expr ) {
+      const size_type count = expr.size();
+      re_data.resize( count );
+      im_data.resize( count );
+      double* re = re_data.data();
+      double* im = im_data.data();
+      for (size_type i = 0; i < count; ++i) {
+        expr.eval( i, re[i], im[i] );
+      }
+    }
+
+    template< class Op, class E >
+    complex_array& apply( const E& expr ) {
+      complex_expression::common_size( size(), expr.size() );
+      double* re = re_data.data();
+      double* im = im_data.data();
+      for (size_type i = 0; i < size(); ++i) {
+        double e_re, e_im;
+        expr.eval( i, e_re, e_im );
+        Op::apply( re[i], im[i], e_re, e_im, re[i], im[i] );
+      }
+      return (*this);
+    }
+};
+
+namespace complex_expression {
+  template<>
+  struct operand<complex_array> { typedef const complex_array& type; };
+
+  /* operators between expressions */
+  #define COMPLEX_EXPRESSION_OPERATOR(op, op_name) \
+    template< class L, class R > \
+    inline binary<op_name, L, R> operator op \
+      ( const base<L>& l, const base<R>& r ) \
+      { return binary<op_name, L, R>( l.self(), r.self() ); } \
+    template< class L > \
+    inline binary<op_name, L, scalar> operator op \
+      ( const base<L>& l, const complex_t& r ) \
+      { return binary<op_name, L, scalar>( l.self(), scalar(r) ); } \
+    template< class R > \
+    inline binary<op_name, scalar, R> operator op \
+      ( const complex_t& l, const base<R>& r ) \
+      { return binary<op_name, scalar, R>( scalar(l), r.self() ); }
+    COMPLEX_EXPRESSION_OPERATOR(+, op_add)
+    COMPLEX_EXPRESSION_OPERATOR(-, op_sub)
+    COMPLEX_EXPRESSION_OPERATOR(*, op_mul)
+    COMPLEX_EXPRESSION_OPERATOR(/, op_div)
+  #undef COMPLEX_EXPRESSION_OPERATOR
+
+  /* product followed by a sum becomes muladd */
+  template< class X, class Y, class R >
+  inline muladd<X, Y, R> operator+
+    ( const binary<op_mul, X, Y>& l, const base<R>& r )
+    { return muladd<X, Y, R>( l.left, l.right, r.self() ); }
+  template< class X, class Y, class L >
+  inline muladd<X, Y, L> operator+
+    ( const base<L>& l, const binary<op_mul, X, Y>& r )
+    { return muladd<X, Y, L>( r.left, r.right, l.self() ); }
+  template< class X, class Y, class Z, class W >
+  inline muladd< X, Y, binary<op_mul, Z, W> > operator+
+    ( const binary<op_mul, X, Y>& l, const binary<op_mul, Z, W>& r )
+    { return muladd< X, Y, binary<op_mul, Z, W> >( l.left, l.right, r ); }
+  template< class X, class Y >
+  inline muladd<X, Y, scalar> operator+
+    ( const binary<op_mul, X, Y>& l, const complex_t& r )
+    { return muladd<X, Y, scalar>( l.left, l.right, scalar(r) ); }
+} //end of namespace "complex_expression"
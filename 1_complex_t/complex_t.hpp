@@ -1,19 +1,78 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <limits>
+#include <algorithm>
 
-static bool isequal( double a, double b ) {
-  return ( std::abs(a - b) <= std::numeric_limits<double>::epsilon() *
-    std::max( std::abs(a), std::abs(b) ) );
+#ifndef M_PI
+  #define M_PI  3.14159265358979323846
+#endif
+
+const double COMPLEX_T_REL_EPS = 4.0 * std::numeric_limits<double>::epsilon();
+const double COMPLEX_T_ABS_EPS = std::numeric_limits<double>::epsilon();
+
+// relative tolerance, with an absolute floor so values near zero compare too
+static bool isequal( double a, double b,
+  double rel_eps = COMPLEX_T_REL_EPS, double abs_eps = COMPLEX_T_ABS_EPS )
+{
+  const double diff = std::abs(a - b);
+  return ( diff <= abs_eps ||
+           diff <= rel_eps * std::max( std::abs(a), std::abs(b) ) );
+}
+
+// maps angle to (-pi, pi] like std::arg, no reduction for angles already there
+static double anglepi( double x ) {
+  if ( x > -M_PI && x <= M_PI ) { return x; }
+  x = std::remainder( x, 2.0*M_PI );
+  return (x > -M_PI) ? x : x + 2.0*M_PI;
 }
 
-static bool angle2pi( double x ) {
-  x = std::fmod( x, 2.0*M_PI );
-  if (x < 0) { x += 2.0*M_PI; }
-  return x;
+// distance between angles along the circle, for angles in (-pi, pi]
+static bool isequal_angle( double a, double b ) {
+  const double diff = std::abs(a - b);
+  return std::min( diff, 2.0*M_PI - diff ) <= 2.0*M_PI * COMPLEX_T_REL_EPS;
 }
 
+/* complex division policies, see complex_t::divide() */
+namespace complex_division {
+  // multiplies by the reciprocal of |divisor|^2: one division per call, but
+  // overflows (underflows) when divisor components exceed ~1e154 (~1e-154)
+  struct fast {
+    static inline void apply( double a, double b, double c, double d,
+      double& re, double& im )
+    {
+      const double inv = 1.0 / (c*c + d*d);
+      re = (a*c + b*d) * inv;
+      im = (b*c - a*d) * inv;
+    }
+  };
+
+  // Smith's algorithm: scales by the larger divisor component, so there is
+  // no intermediate overflow; written without branches to let batch loops
+  // vectorize
+  struct smith {
+    static inline void apply( double a, double b, double c, double d,
+      double& re, double& im )
+    {
+      const bool swap = std::abs(c) < std::abs(d);
+      const double p = swap ? d : c;
+      const double q = swap ? c : d;
+      const double s = swap ? b : a;
+      const double t = swap ? a : b;
+      const double r = q / p;
+      const double inv = 1.0 / (p + q*r);
+      re = (s + t*r) * inv;
+      im = (swap ? -1.0 : 1.0) * (t - s*r) * inv;
+    }
+  };
+} //end of namespace "complex_division"
+
+#ifndef COMPLEX_T_DIVISION
+  #define COMPLEX_T_DIVISION complex_division::smith
+#endif
+
 class complex_t {
   public:
     double real;
@@ -52,11 +111,14 @@ class complex_t {
     }
 
     complex_t operator/ ( const complex_t& num ) const {
-      double divisor = num.real*num.real + num.imag*num.imag;
-      return complex_t(
-        (real*num.real + imag*num.imag) / divisor,
-        (imag*num.real - real*num.imag) / divisor
-      );
+      return divide<COMPLEX_T_DIVISION>( num );
+    }
+
+    template< class Policy >
+    complex_t divide( const complex_t& num ) const {
+      double re, im;
+      Policy::apply( real, imag, num.real, num.imag, re, im );
+      return complex_t( re, im );
     }
 
     virtual double abs() const {
@@ -76,10 +138,14 @@ class complex_t {
       return !(*this == num);
     }
     complex_t& operator+= ( const complex_t& num ) {
-      return (*this = *this + num);
+      real += num.real;
+      imag += num.imag;
+      return *this;
     }
     complex_t& operator-= ( const complex_t& num ) {
-      return (*this = *this - num);
+      real -= num.real;
+      imag -= num.imag;
+      return *this;
     }
     complex_t& operator*= ( const complex_t& num ) {
       return (*this = *this * num);
@@ -89,6 +155,13 @@ class complex_t {
     }
 };
 
+/*
+  Values are kept normalized: radius >= 0 and angle in (-pi, pi]. Every
+  constructor and operator maintains this, so comparisons don't have to
+  reduce angles. Code assigning radius or angle directly should call
+  normalize() afterwards; equality still copes with unnormalized angles,
+  only slower.
+*/
 class complex_polar_t : public complex_t {
   public:
     double radius;
@@ -97,11 +170,22 @@ class complex_polar_t : public complex_t {
     complex_polar_t( double rad = 0.0, double ang = 0.0 ) {
       radius = rad;
       angle = ang;
+      normalize();
     }
 
     complex_polar_t( complex_t c ) {
       radius = c.abs();
       angle = std::atan2( c.imag, c.real );
+      normalize();  // atan2() gives -pi for a negative zero imaginary part
+    }
+
+    complex_polar_t& normalize() {
+      if (radius < 0) {
+        radius = -radius;
+        angle += M_PI;
+      }
+      angle = anglepi( angle );
+      return *this;
     }
 
     //Cartesian coordinates
@@ -118,9 +202,11 @@ class complex_polar_t : public complex_t {
       return *this;
     }
 
+    // all angles are equal at (near) zero radius
     bool operator== ( const complex_polar_t& num ) const {
       return isequal( radius, num.radius ) &&
-             isequal( angle2pi(angle), angle2pi(num.angle) );
+             ( std::max( radius, num.radius ) <= COMPLEX_T_ABS_EPS ||
+               isequal_angle( anglepi(angle), anglepi(num.angle) ) );
     }
 
     complex_polar_t operator+ ( const complex_polar_t& num ) const {
@@ -165,3 +251,101 @@ class complex_polar_t : public complex_t {
       return (*this = *this / num);
     }
 };
+
+/* ========================================================================== */
+
+/* batch division, element-wise out[i] = num[i] / den[i] */
+
+// split (real and imaginary arrays) layout, this one vectorizes best
+template< class Policy >
+void complex_divide( const double* num_re, const double* num_im,
+  const double* den_re, const double* den_im,
+  double* out_re, double* out_im, std::size_t count )
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    Policy::apply( num_re[i], num_im[i], den_re[i], den_im[i],
+      out_re[i], out_im[i] );
+  }
+}
+
+template< class Policy >
+void complex_divide( const complex_t* num, const complex_t* den,
+  complex_t* out, std::size_t count )
+{
+  for (std::size_t i = 0; i < count; ++i) {
+    Policy::apply( num[i].real, num[i].imag, den[i].real, den[i].imag,
+      out[i].real, out[i].imag );
+  }
+}
+
+/* batch comparison, result[i] = (lhs[i] == rhs[i]), returns count of equal */
+
+template< class T >
+std::size_t complex_equal( const T* lhs, const T* rhs, bool* result,
+  std::size_t count )
+{
+  std::size_t equal_count = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    result[i] = (lhs[i] == rhs[i]);
+    equal_count += result[i];
+  }
+  return equal_count;
+}
+
+/* ========================================================================== */
+
+/* ordering and hashing, for sorting and hash containers */
+
+// lexicographic order: by real part, then by imaginary part
+struct complex_less {
+  inline bool operator() ( const complex_t& a, const complex_t& b ) const {
+    return (a.real < b.real) || (a.real == b.real && a.imag < b.imag);
+  }
+};
+
+/*
+  Snaps values to a square grid with the tolerance as cell size: values in
+  one cell are equal for complex_grid_equal and get the same
+  complex_grid_hash. Unlike operator== this relation is transitive, so it
+  is safe for hash containers and std::unique, but two values closer than
+  the tolerance still may fall into adjacent cells. Components must stay
+  within +-9e18 cells.
+*/
+class complex_grid {
+  private:
+    double inv_cell;
+
+  public:
+    explicit complex_grid( double tolerance = 1e-9 )
+    : inv_cell( 1.0 / tolerance ) {}
+
+    inline std::int64_t cell( double x ) const {
+      return static_cast<std::int64_t>( std::floor( x * inv_cell + 0.5 ) );
+    }
+};
+
+struct complex_grid_hash : complex_grid {
+  explicit complex_grid_hash( double tolerance = 1e-9 )
+  : complex_grid(tolerance) {}
+
+  // both cell coordinates mixed by the MurmurHash3 finalizer
+  inline std::size_t operator() ( const complex_t& c ) const {
+    std::uint64_t h = static_cast<std::uint64_t>( cell(c.real) ) *
+      0x9E3779B97F4A7C15ULL ^ static_cast<std::uint64_t>( cell(c.imag) );
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return static_cast<std::size_t>(h);
+  }
+};
+
+struct complex_grid_equal : complex_grid {
+  explicit complex_grid_equal( double tolerance = 1e-9 )
+  : complex_grid(tolerance) {}
+
+  inline bool operator() ( const complex_t& a, const complex_t& b ) const {
+    return cell(a.real) == cell(b.real) && cell(a.imag) == cell(b.imag);
+  }
+};
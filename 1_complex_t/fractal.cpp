@@ -0,0 +1,83 @@
+/*
+  Mandelbrot/Julia renderer, used as a complex_t workload benchmark.
+  usage: fractal [mandelbrot|julia] [width] [height] [max_iter] [threads]
+  Renders the same image with every backend, prints iterations per second
+  for each of them and writes the picture to <mode>.pgm.
+*/
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include <measure_exec.hpp>
+
+#include "fractal.hpp"
+
+typedef shared::measure<std::chrono::microseconds> time_measure;
+
+template< class Render >
+static void RUN_BACKEND( const char* name, const fractal::image_t& expected,
+  fractal::image_t& image, Render render )
+{
+  fractal::iter_count total = 0;
+  const auto time = time_measure::execution( [&]() { total = render(image); } );
+  const double giter_per_sec = (time > 0) ? total / (time * 1e3) : 0.0;
+  std::cout << "  " << name << ": " << time / 1000 << " ms, "
+    << giter_per_sec << " Giter/s"
+    << ( (image == expected) ? "" : " (image differs from scalar!)" )
+    << std::endl;
+}
+
+int main( int argc, char* argv[] ) {
+  const std::string mode = (argc > 1) ? argv[1] : "mandelbrot";
+  fractal::params_t p;
+  if (argc > 2) { p.width = std::strtoul( argv[2], nullptr, 10 ); }
+  if (argc > 3) { p.height = std::strtoul( argv[3], nullptr, 10 ); }
+  if (argc > 4) { p.max_iter = std::strtoul( argv[4], nullptr, 10 ); }
+  const unsigned threads = (argc > 5) ? std::strtoul( argv[5], nullptr, 10 )
+                                      : std::thread::hardware_concurrency();
+  if ( mode == "julia" ) {
+    p.julia = true;
+    p.min = complex_t( -1.6, -1.0 );
+    p.max = complex_t( 1.6, 1.0 );
+  }
+  else if ( mode != "mandelbrot" ) {
+    std::cerr << "unknown mode: " << mode << std::endl;
+    return 1;
+  }
+
+  std::cout << mode << " " << p.width << "x" << p.height
+    << ", max_iter " << p.max_iter << ", " << threads << " threads:"
+    << std::endl;
+
+  fractal::image_t expected, image;
+  RUN_BACKEND( "scalar complex_t", expected, expected,
+    [&]( fractal::image_t& img ) {
+      return fractal::render( p, img, fractal::scalar_kernel() );
+    } );
+  RUN_BACKEND( "lanes x4", expected, image,
+    [&]( fractal::image_t& img ) {
+      return fractal::render( p, img, fractal::lanes_kernel<4>() );
+    } );
+  RUN_BACKEND( "lanes x8", expected, image,
+    [&]( fractal::image_t& img ) {
+      return fractal::render( p, img, fractal::lanes_kernel<8>() );
+    } );
+  RUN_BACKEND( "threaded scalar complex_t", expected, image,
+    [&]( fractal::image_t& img ) {
+      return fractal::render_parallel( p, img, fractal::scalar_kernel(),
+        threads );
+    } );
+  RUN_BACKEND( "threaded lanes x8", expected, image,
+    [&]( fractal::image_t& img ) {
+      return fractal::render_parallel( p, img, fractal::lanes_kernel<8>(),
+        threads );
+    } );
+
+  const std::string path = mode + ".pgm";
+  if ( !fractal::write_pgm( path.c_str(), p, expected ) ) {
+    std::cerr << "can't write " << path << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+
+#include "complex_t.hpp"
+
+/*
+  Escape-time renderer for Mandelbrot and Julia sets.
+  Every pixel gets the number of iterations of z = z*z + c before |z| > 2
+  (max_iter if it never escapes). Kernels render one rectangular tile and
+  return the total iteration count, so callers can report iterations/second:
+    - scalar_kernel iterates one point at a time with complex_t;
+    - lanes_kernel<N> iterates N points at once with per-lane escape masks,
+      written as plain fixed-size loops for the compiler to vectorize;
+    - render_parallel() spreads tiles of any kernel over threads.
+  The lanes kernel repeats complex_t arithmetic operation by operation, so
+  all backends produce the same image.
+*/
+
+namespace fractal {
+  typedef std::size_t size_type;
+  typedef unsigned long long iter_count;
+  typedef std::vector<unsigned> image_t;
+
+  struct params_t {
+    size_type width, height;
+    complex_t min, max;  // lower-left and upper-right corners of the view
+    unsigned max_iter;
+    bool julia;          // z0 = pixel, c = julia_c instead of z0 = 0, c = pixel
+    complex_t julia_c;
+
+    params_t( size_type w = 1024, size_type h = 768, unsigned iter = 256 )
+    : width(w), height(h), min(-2.5, -1.25), max(1.0, 1.25),
+      max_iter(iter), julia(false), julia_c(-0.8, 0.156) {}
+
+    inline double x_at( size_type x ) const {
+      return min.real + (max.real - min.real) * x / width;
+    }
+    inline double y_at( size_type y ) const {
+      return max.imag - (max.imag - min.imag) * y / height;
+    }
+  };
+
+  struct tile_t { size_type x0, y0, x1, y1; };
+
+  /* ======================================================================== */
+
+  struct scalar_kernel {
+    iter_count operator() ( const params_t& p, const tile_t& t,
+      unsigned* image ) const
+    {
+      iter_count total = 0;
+      for (size_type y = t.y0; y < t.y1; ++y) {
+        for (size_type x = t.x0; x < t.x1; ++x) {
+          const complex_t point( p.x_at(x), p.y_at(y) );
+          const complex_t c( p.julia ? p.julia_c.real : point.real,
+                             p.julia ? p.julia_c.imag : point.imag );
+          complex_t z( p.julia ? point.real : 0.0, p.julia ? point.imag : 0.0 );
+          unsigned n = 0;
+          while ( n < p.max_iter && z.real*z.real + z.imag*z.imag <= 4.0 ) {
+            z = z*z + c;
+            ++n;
+          }
+          image[y * p.width + x] = n;
+          total += n;
+        }
+      }
+      return total;
+    }
+  };
+
+  template< unsigned LANES >
+  struct lanes_kernel {
+    iter_count operator() ( const params_t& p, const tile_t& t,
+      unsigned* image ) const
+    {
+      iter_count total = 0;
+      for (size_type y = t.y0; y < t.y1; ++y) {
+        const double point_im = p.y_at(y);
+        for (size_type x = t.x0; x < t.x1; x += LANES) {
+          double zr[LANES], zi[LANES], cr[LANES], ci[LANES];
+          unsigned n[LANES];
+          for (unsigned l = 0; l < LANES; ++l) {
+            // lanes past the tile edge just repeat the last column
+            const double point_re = p.x_at( std::min<size_type>( x+l, t.x1-1 ) );
+            zr[l] = p.julia ? point_re : 0.0;
+            zi[l] = p.julia ? point_im : 0.0;
+            cr[l] = p.julia ? p.julia_c.real : point_re;
+            ci[l] = p.julia ? p.julia_c.imag : point_im;
+            n[l] = 0;
+          }
+
+          for (unsigned iter = 0; iter < p.max_iter; ++iter) {
+            unsigned active = 0;
+            for (unsigned l = 0; l < LANES; ++l) {
+              const double rr = zr[l]*zr[l];
+              const double ii = zi[l]*zi[l];
+              const bool inside = rr + ii <= 4.0;
+              const double new_zr = (rr - ii) + cr[l];
+              const double new_zi = (zr[l]*zi[l] + zi[l]*zr[l]) + ci[l];
+              zr[l] = inside ? new_zr : zr[l];
+              zi[l] = inside ? new_zi : zi[l];
+              n[l] += inside;
+              active += inside;
+            }
+            if (active == 0) { break; }
+          }
+
+          const size_type lanes_used = std::min<size_type>( LANES, t.x1 - x );
+          for (size_type l = 0; l < lanes_used; ++l) {
+            image[y * p.width + x + l] = n[l];
+            total += n[l];
+          }
+        }
+      }
+      return total;
+    }
+  };
+
+  /* ======================================================================== */
+
+  template< class Kernel >
+  iter_count render( const params_t& p, image_t& image, Kernel kernel ) {
+    image.resize( p.width * p.height );
+    const tile_t whole = { 0, 0, p.width, p.height };
+    return kernel( p, whole, image.data() );
+  }
+
+  // square tiles are handed out to worker threads through an atomic counter,
+  // so threads that got cheap tiles (outside the set) take more of them
+  template< class Kernel >
+  iter_count render_parallel( const params_t& p, image_t& image, Kernel kernel,
+    unsigned threads = std::thread::hardware_concurrency(),
+    size_type tile_size = 64 )
+  {
+    image.resize( p.width * p.height );
+    if (threads == 0) { threads = 1; }
+
+    const size_type tiles_x = (p.width + tile_size - 1) / tile_size;
+    const size_type tiles_y = (p.height + tile_size - 1) / tile_size;
+    const size_type tiles_count = tiles_x * tiles_y;
+    std::atomic<size_type> next_tile(0);
+    std::vector<iter_count> totals( threads, 0 );
+
+    auto worker = [&]( unsigned id ) {
+      iter_count local_total = 0;
+      for (size_type i = next_tile++; i < tiles_count; i = next_tile++) {
+        tile_t t;
+        t.x0 = (i % tiles_x) * tile_size;
+        t.y0 = (i / tiles_x) * tile_size;
+        t.x1 = std::min( t.x0 + tile_size, p.width );
+        t.y1 = std::min( t.y0 + tile_size, p.height );
+        local_total += kernel( p, t, image.data() );
+      }
+      totals[id] = local_total;
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve( threads - 1 );
+    try {
+      for (unsigned id = 1; id < threads; ++id) {
+        pool.emplace_back( worker, id );
+      }
+    } catch (...) {
+      // a joinable std::thread must not be destroyed
+      for (auto& thread : pool) { thread.join(); }
+      throw;
+    }
+    worker(0);
+    for (auto& thread : pool) { thread.join(); }
+
+    iter_count total = 0;
+    for (iter_count t : totals) { total += t; }
+    return total;
+  }
+
+  /* ======================================================================== */
+
+  // binary greymap, points inside the set are black
+  inline bool write_pgm( const char* path, const params_t& p,
+    const image_t& image )
+  {
+    std::ofstream file( path, std::ios::binary );
+    if (!file) { return false; }
+    file << "P5\n" << p.width << " " << p.height << "\n255\n";
+    std::vector<char> row( p.width );
+    for (size_type y = 0; y < p.height; ++y) {
+      for (size_type x = 0; x < p.width; ++x) {
+        const unsigned n = image[y * p.width + x];
+        row[x] = static_cast<char>( (n >= p.max_iter) ? 0 :
+          static_cast<unsigned>( 255.0 * std::sqrt( double(n) / p.max_iter ) ) );
+      }
+      file.write( row.data(), row.size() );
+    }
+    return static_cast<bool>(file);
+  }
+} //end of namespace "fractal"
@@ -6,7 +6,10 @@
 #endif
 
 #include <complex>
+
 #include "complex_t.hpp"
+#include "complex_array.hpp"
+#include "fractal.hpp"
 
 #include "catch/catch_with_main.hpp"
 
@@ -128,6 +131,63 @@ TEST_CASE( "complex_polar_t equality operators", "[operator]" ) {
   }
 }
 
+TEST_CASE( "complex_polar_t normalization", "[init]" ) {
+  SECTION( "angle in (-pi, pi]" ) {
+    REQUIRE( complex_polar_t( 1.0, 1.5 * M_PI ).angle == Approx( -0.5 * M_PI ) );
+    REQUIRE( complex_polar_t( 1.0, 100.5 * M_PI ).angle == Approx( 0.5 * M_PI ) );
+    REQUIRE( complex_polar_t( 1.0, -M_PI ).angle == M_PI );
+    REQUIRE( complex_polar_t( 1.0, 2.0 * M_PI ).angle == 0.0 );
+    REQUIRE( complex_polar_t( complex_t( 1.0, -1.0 ) ).angle ==
+      Approx( -0.25 * M_PI ) );
+    REQUIRE( complex_polar_t( complex_t( -1.0, -0.0 ) ).angle == M_PI );
+    REQUIRE( (my_cmpl_pl2 * my_cmpl_pl2).angle == Approx( M_PI ) );
+    REQUIRE( (my_cmpl_pl2 / my_cmpl_pl1).angle > -M_PI );
+  }
+  SECTION( "negative radius" ) {
+    complex_polar_t c( -2.0, M_PI / 4.0 );
+    REQUIRE( c.radius == 2.0 );
+    REQUIRE( c.angle == Approx( -0.75 * M_PI ) );
+  }
+  SECTION( "manual changes" ) {
+    complex_polar_t c = my_cmpl_pl1;
+    c.angle += 6.0 * M_PI;
+    c.normalize();
+    REQUIRE( c.angle == Approx( CMPL_PL_ANG1 ) );
+  }
+}
+
+TEST_CASE( "tolerant equality", "[operator]" ) {
+  SECTION( "values near zero" ) {
+    REQUIRE( complex_t( 1e-17, -1e-17 ) == complex_t() );
+    REQUIRE( complex_t( 0.1 + 0.2 - 0.3, 0.0 ) == complex_t() );
+    REQUIRE( complex_t( 1e-3, 0.0 ) != complex_t() );
+  }
+  SECTION( "angles around zero" ) {
+    REQUIRE( complex_polar_t( 1.0, 1e-17 ) == complex_polar_t( 1.0, -1e-17 ) );
+    REQUIRE( complex_polar_t( 1.0, 1e-3 ) != complex_polar_t( 1.0, -1e-3 ) );
+  }
+  SECTION( "zero radius" ) {
+    REQUIRE( complex_polar_t( 0.0, 1.0 ) == complex_polar_t( 0.0, 2.0 ) );
+  }
+  SECTION( "polar roundtrip" ) {
+    REQUIRE( complex_polar_t( my_cmpl_pl1.to_xy() ) == my_cmpl_pl1 );
+    REQUIRE( complex_polar_t( my_cmpl_pl2.to_xy() ) == my_cmpl_pl2 );
+  }
+  SECTION( "batch" ) {
+    const complex_polar_t lhs[] = { my_cmpl_pl1, my_cmpl_pl2, my_cmpl_pl1 };
+    const complex_polar_t rhs[] = {
+      complex_polar_t( CMPL_PL_RAD1, CMPL_PL_ANG1 + 2.0 * M_PI ),
+      my_cmpl_pl1,
+      complex_polar_t( my_cmpl_pl1.to_xy() )
+    };
+    bool result[3];
+    REQUIRE( complex_equal( lhs, rhs, result, 3 ) == 2 );
+    REQUIRE( result[0] );
+    REQUIRE( !result[1] );
+    REQUIRE( result[2] );
+  }
+}
+
 /* ========================================================================== */
 
 TEST_CASE( "complex_t arithmetic operators", "[operator]" ) {
@@ -176,6 +236,54 @@ TEST_CASE( "complex_polar_t arithmetic operators", "[operator]" ) {
   }
 }
 
+TEST_CASE( "complex_t division policies", "[operator]" ) {
+  SECTION( "fast" ) {
+    REQUIRE_CMPL_EQUAL( cpp_cmpl_xy1 / cpp_cmpl_xy2,
+      my_cmpl_xy1.divide<complex_division::fast>( my_cmpl_xy2 ) );
+    REQUIRE_CMPL_EQUAL( cpp_cmpl_xy2 / cpp_cmpl_xy1,
+      my_cmpl_xy2.divide<complex_division::fast>( my_cmpl_xy1 ) );
+  }
+  SECTION( "smith" ) {
+    REQUIRE_CMPL_EQUAL( cpp_cmpl_xy1 / cpp_cmpl_xy2,
+      my_cmpl_xy1.divide<complex_division::smith>( my_cmpl_xy2 ) );
+    REQUIRE_CMPL_EQUAL( cpp_cmpl_xy2 / cpp_cmpl_xy1,
+      my_cmpl_xy2.divide<complex_division::smith>( my_cmpl_xy1 ) );
+  }
+  SECTION( "smith, overflow" ) {
+    const complex_t huge( 1e300, 1e300 );
+    REQUIRE_CMPL_EQUAL( 1.0, 0.0, huge / huge );
+    const std::complex<double> cpp_num( 3e307, -4e307 );
+    const std::complex<double> cpp_den( 1e-3, 2e306 );
+    REQUIRE_CMPL_EQUAL( cpp_num / cpp_den,
+      complex_t( 3e307, -4e307 ) / complex_t( 1e-3, 2e306 ) );
+  }
+  SECTION( "smith, underflow" ) {
+    const complex_t tiny( 1e-300, 1e-300 );
+    REQUIRE_CMPL_EQUAL( 1.0, 0.0, tiny / tiny );
+    const std::complex<double> cpp_num( 5e-310, 7e-310 );
+    const std::complex<double> cpp_den( 3e-308, -1e-309 );
+    REQUIRE_CMPL_EQUAL( cpp_num / cpp_den,
+      complex_t( 5e-310, 7e-310 ) / complex_t( 3e-308, -1e-309 ) );
+  }
+  SECTION( "batch" ) {
+    const complex_t num[] = { my_cmpl_xy1, my_cmpl_xy2, complex_t( 1e300, 1e300 ) };
+    const complex_t den[] = { my_cmpl_xy2, my_cmpl_xy1, complex_t( 1e300, 1e300 ) };
+    complex_t out[3];
+    complex_divide<complex_division::smith>( num, den, out, 3 );
+    REQUIRE_CMPL_EQUAL( cpp_cmpl_xy1 / cpp_cmpl_xy2, out[0] );
+    REQUIRE_CMPL_EQUAL( cpp_cmpl_xy2 / cpp_cmpl_xy1, out[1] );
+    REQUIRE_CMPL_EQUAL( 1.0, 0.0, out[2] );
+
+    const double num_re[] = { CMPL_XY_REAL1, CMPL_XY_REAL2 };
+    const double num_im[] = { CMPL_XY_IMAG1, CMPL_XY_IMAG2 };
+    double out_re[2], out_im[2];
+    complex_divide<complex_division::fast>( num_re, num_im, num_re+1, num_im+1,
+      out_re, out_im, 1 );
+    REQUIRE_CMPL_EQUAL( cpp_cmpl_xy1 / cpp_cmpl_xy2,
+      complex_t( out_re[0], out_im[0] ) );
+  }
+}
+
 /* ========================================================================== */
 
 TEST_CASE( "complex_t functions", "[functions]" ) {
@@ -212,4 +320,102 @@ TEST_CASE( "complex_polar_t functions", "[functions]" ) {
   }
 }
 
+/* ========================================================================== */
+
+TEST_CASE( "complex_array expressions", "[expression]" ) {
+  const complex_t values1[] = { my_cmpl_xy1, my_cmpl_xy2, complex_t( -3.0, 0.5 ) };
+  const complex_t values2[] = { my_cmpl_xy2, complex_t( 0.25, -7.0 ), my_cmpl_xy1 };
+  const std::size_t count = 3;
+  complex_array arr1( count ), arr2( count );
+  std::complex<double> cpp1[count], cpp2[count];
+  for (std::size_t i = 0; i < count; ++i) {
+    arr1.set( i, values1[i] );
+    arr2.set( i, values2[i] );
+    cpp1[i] = std::complex<double>( values1[i].real, values1[i].imag );
+    cpp2[i] = std::complex<double>( values2[i].real, values2[i].imag );
+  }
+
+  SECTION( "element-wise operators" ) {
+    complex_array sum = arr1 + arr2;
+    complex_array diff = arr1 - arr2;
+    complex_array prod = arr1 * arr2;
+    complex_array quot = arr1 / arr2;
+    for (std::size_t i = 0; i < count; ++i) {
+      REQUIRE_CMPL_EQUAL( cpp1[i] + cpp2[i], sum[i] );
+      REQUIRE_CMPL_EQUAL( cpp1[i] - cpp2[i], diff[i] );
+      REQUIRE_CMPL_EQUAL( cpp1[i] * cpp2[i], prod[i] );
+      REQUIRE_CMPL_EQUAL( cpp1[i] / cpp2[i], quot[i] );
+    }
+  }
+  SECTION( "fused expressions and scalars" ) {
+    const std::complex<double> cpp_scalar( CMPL_XY_REAL2, CMPL_XY_IMAG2 );
+    complex_array res1 = arr1 * arr2 + arr1;
+    complex_array res2 = arr2 + arr1 * my_cmpl_xy2;
+    complex_array res3 = arr1 * arr2 + arr2 * arr1 - my_cmpl_xy1;
+    complex_array res4 = (arr1 - arr2) / my_cmpl_xy2 + my_cmpl_xy1 * arr2;
+    for (std::size_t i = 0; i < count; ++i) {
+      REQUIRE_CMPL_EQUAL( cpp1[i] * cpp2[i] + cpp1[i], res1[i] );
+      REQUIRE_CMPL_EQUAL( cpp2[i] + cpp1[i] * cpp_scalar, res2[i] );
+      REQUIRE_CMPL_EQUAL(
+        cpp1[i] * cpp2[i] + cpp2[i] * cpp1[i] - cpp_cmpl_xy1, res3[i] );
+      REQUIRE_CMPL_EQUAL(
+        (cpp1[i] - cpp2[i]) / cpp_scalar + cpp_cmpl_xy1 * cpp2[i], res4[i] );
+    }
+  }
+  SECTION( "compound and aliased assignment" ) {
+    complex_array res = arr1;
+    res *= arr2;
+    res += arr1 * arr2;
+    res /= arr2;
+    res -= arr1;
+    res = res * res + arr2;
+    for (std::size_t i = 0; i < count; ++i) {
+      std::complex<double> c = (cpp1[i] * cpp2[i] * 2.0) / cpp2[i] - cpp1[i];
+      REQUIRE_CMPL_EQUAL( c * c + cpp2[i], res[i] );
+    }
+  }
+  SECTION( "operands of different sizes" ) {
+    complex_array longer( count + 1 ), empty;
+    REQUIRE_THROWS_AS( arr1 + longer, std::invalid_argument );
+    REQUIRE_THROWS_AS( arr1 * arr2 + longer, std::invalid_argument );
+    REQUIRE_THROWS_AS( longer += arr1, std::invalid_argument );
+    REQUIRE_THROWS_AS( empty * my_cmpl_xy1 + arr1, std::invalid_argument );
+    complex_array scaled = empty * my_cmpl_xy1;
+    REQUIRE( scaled.size() == 0 );
+  }
+}
+
+/* ========================================================================== */
 
+TEST_CASE( "fractal renderer backends", "[fractal]" ) {
+  // odd sizes to leave partial tiles and partially filled lanes
+  fractal::params_t p( 101, 67, 200 );
+  fractal::image_t expected, image;
+
+  SECTION( "mandelbrot" ) {
+    const fractal::iter_count total =
+      fractal::render( p, expected, fractal::scalar_kernel() );
+    REQUIRE( expected[ 33*p.width + 71 ] == p.max_iter );  // near the origin, inside
+    REQUIRE( expected[ 0 ] < 3 );                          // top-left corner, outside
+    REQUIRE( fractal::render( p, image, fractal::lanes_kernel<4>() ) == total );
+    REQUIRE( image == expected );
+    REQUIRE( fractal::render( p, image, fractal::lanes_kernel<8>() ) == total );
+    REQUIRE( image == expected );
+    REQUIRE( fractal::render_parallel( p, image, fractal::scalar_kernel(),
+      3, 16 ) == total );
+    REQUIRE( image == expected );
+    REQUIRE( fractal::render_parallel( p, image, fractal::lanes_kernel<8>(),
+      4, 32 ) == total );
+    REQUIRE( image == expected );
+  }
+  SECTION( "julia" ) {
+    p.julia = true;
+    const fractal::iter_count total =
+      fractal::render( p, expected, fractal::scalar_kernel() );
+    REQUIRE( fractal::render( p, image, fractal::lanes_kernel<4>() ) == total );
+    REQUIRE( image == expected );
+    REQUIRE( fractal::render_parallel( p, image, fractal::lanes_kernel<8>(),
+      2, 8 ) == total );
+    REQUIRE( image == expected );
+  }
+}
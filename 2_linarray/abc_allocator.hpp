@@ -1,9 +1,26 @@
 #pragma once
 
 #include <memory>
+#include <new>
+#include <cstdlib>
+#include <type_traits>
 
-template<typename T>
+#if defined(_WIN32) && !defined(__cpp_aligned_new)
+  #include <malloc.h>
+#endif
+
+/*
+  Alignment is in bytes, a power of two; 0 keeps the alignment of plain
+  ::operator new. Over-aligned blocks (e.g. 64 for cache lines and
+  AVX-512 loads, 4096 for pages) are padded to a whole number of
+  alignment units, so two blocks never share a cache line, and linarray
+  uses that padding as extra capacity.
+*/
+template< typename T, std::size_t Alignment = 0 >
 class abc_allocator {
+  static_assert( (Alignment & (Alignment - 1)) == 0,
+    "alignment must be a power of two" );
+
   public:
     typedef T                 value_type;
     typedef       value_type* pointer;
@@ -13,32 +30,85 @@ class abc_allocator {
     typedef std::size_t       size_type;
     typedef std::ptrdiff_t    difference_type;
 
+    static const size_type alignment = Alignment;
+
   public:
     template<typename U>
     struct rebind {
-      typedef abc_allocator<U> other;
+      typedef abc_allocator<U, Alignment> other;
     };
 
   public:
     abc_allocator() {}
 
     template< typename U >
-    abc_allocator( const abc_allocator<U>& ) {}
+    abc_allocator( const abc_allocator<U, Alignment>& ) {}
 
     inline pointer allocate( size_type cnt ) {
-      return reinterpret_cast<pointer>( ::operator new( cnt*sizeof(T) ) );
+      return allocate( cnt, is_plain() );
     }
+
     inline void deallocate( pointer p, size_type ) {
+      deallocate( p, is_plain() );
+    }
+
+  private:
+    // dispatched at compile time: the default allocator only ever needs
+    // ::operator new, which every toolchain has
+    typedef std::integral_constant<bool, Alignment == 0> is_plain;
+
+    inline static pointer allocate( size_type cnt, std::true_type ) {
+      return reinterpret_cast<pointer>( ::operator new( cnt*sizeof(T) ) );
+    }
+    inline static void deallocate( pointer p, std::true_type ) {
       ::operator delete(p);
     }
+
+    inline static pointer allocate( size_type cnt, std::false_type ) {
+      const size_type bytes = padded_bytes( cnt );
+      #if defined(__cpp_aligned_new)
+        return reinterpret_cast<pointer>(
+          ::operator new( bytes, std::align_val_t(Alignment) ) );
+      #elif defined(_WIN32)
+        void* p = ::_aligned_malloc( bytes, Alignment );
+        if ( p == nullptr ) { throw std::bad_alloc(); }
+        return reinterpret_cast<pointer>(p);
+      #else
+        void* p = nullptr;
+        const size_type align = (Alignment < sizeof(void*)) ? sizeof(void*) : Alignment;
+        if ( ::posix_memalign( &p, align, bytes ) != 0 ) {
+          throw std::bad_alloc();
+        }
+        return reinterpret_cast<pointer>(p);
+      #endif
+    }
+    inline static void deallocate( pointer p, std::false_type ) {
+      #if defined(__cpp_aligned_new)
+        ::operator delete( p, std::align_val_t(Alignment) );
+      #elif defined(_WIN32)
+        ::_aligned_free(p);
+      #else
+        std::free(p);
+      #endif
+    }
+
+    inline static size_type padded_bytes( size_type cnt ) {
+      return (cnt*sizeof(T) + Alignment - 1) / Alignment * Alignment;
+    }
 };
 
-template< typename T, typename U >
-bool operator== ( const abc_allocator<T>&, const abc_allocator<U>& ) {
+template< typename T, std::size_t Alignment >
+const typename abc_allocator<T, Alignment>::size_type
+  abc_allocator<T, Alignment>::alignment;
+
+template< typename T, typename U, std::size_t Alignment >
+bool operator== ( const abc_allocator<T, Alignment>&,
+  const abc_allocator<U, Alignment>& ) {
   return true;
 }
 
-template< typename T, typename U >
-bool operator!= ( const abc_allocator<T>&, const abc_allocator<U>& ) {
+template< typename T, typename U, std::size_t Alignment >
+bool operator!= ( const abc_allocator<T, Alignment>&,
+  const abc_allocator<U, Alignment>& ) {
   return false;
 }
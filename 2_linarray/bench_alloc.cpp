@@ -0,0 +1,207 @@
+/*
+  Allocator benchmark: std::allocator against abc_allocator for one large
+  block, many small blocks freed in the given order, and the containers
+  built on them (linarray growth, hash_set tables). Also the cost of
+  value-initializing a large linarray<double> that is overwritten right
+  away, against default-initialized elements; --counters adds the page
+  faults. For 4 GB: bench_alloc --size 512M --counters --filter doubles
+  Vectorized sum and copy kernels run on 64-byte aligned buffers from
+  abc_allocator<int, 64> and on the same buffers shifted by one int.
+  Finally the read bandwidth of pinned threads summing their slices of an
+  array placed by serial first touch, parallel first touch or interleaving
+  over the NUMA nodes (all the same on a single-node machine).
+  usage: bench_alloc [--size 1K,1M] [--dist shuffled] ... (see --help)
+*/
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <thread>
+#include <iostream>
+
+#include <bench_suite.hpp>
+
+#include "linarray.hpp"
+#include "abc_allocator.hpp"
+#include "hash_set.hpp"
+#include "numa_allocator.hpp"
+
+static const std::size_t SMALL_BLOCK = 16;
+
+template< class IntAlloc >
+static void ALLOC_BENCHMARKS( shared::bench_suite& suite, const char* allocator,
+  const std::string& dist, const std::vector<int>& order, bool permutation )
+{
+  typedef std::allocator_traits<IntAlloc> traits;
+  const std::size_t size = order.size();
+  IntAlloc alloc;
+
+  suite.run( "single block, " + dist, "int", allocator, size,
+    [&]() {
+      int* p = traits::allocate( alloc, size );
+      shared::do_not_optimize( p );
+      traits::deallocate( alloc, p, size );
+    } );
+
+  // blocks are freed in the order of the data, which must be a permutation
+  if ( permutation ) {
+    std::vector<int*> blocks( size );
+    suite.run( "small blocks, freed " + dist, "int", allocator, size,
+      [&]() {
+        for (int*& p : blocks) { p = traits::allocate( alloc, SMALL_BLOCK ); }
+        shared::clobber_memory();
+        for (int i : order) { traits::deallocate( alloc, blocks[i], SMALL_BLOCK ); }
+      } );
+  }
+
+  suite.run( "linarray push_back, " + dist, "int", allocator, size,
+    [&]() {
+      linarray< int, IntAlloc > larr;
+      for (int i : order) { larr.push_back( i ); }
+      shared::do_not_optimize( larr.data() );
+    } );
+
+  suite.run( "hash_set insert, " + dist, "int", allocator, size,
+    [&]() {
+      hash_set< int, std::hash<int>, std::equal_to<int>, IntAlloc >
+        set( order.cbegin(), order.cend() );
+      shared::do_not_optimize( set.size() );
+    } );
+}
+
+// a sized array, then every element written as if read from a file
+static void INIT_BENCHMARKS( shared::bench_suite& suite, std::size_t size ) {
+  const auto fill = []( double* data, std::size_t count ) {
+    for (std::size_t i = 0; i < count; ++i) { data[i] = 0.5 * i; }
+  };
+  suite.run( "doubles, value-initialized", "double", "std::allocator", size,
+    [&]() {
+      linarray<double> larr( size );
+      fill( larr.data(), size );
+      shared::do_not_optimize( larr.data() );
+    } );
+  suite.run( "doubles, default-initialized", "double", "std::allocator", size,
+    [&]() {
+      linarray<double> larr( size, default_init );
+      fill( larr.data(), size );
+      shared::do_not_optimize( larr.data() );
+    } );
+  suite.run( "doubles, resize_and_overwrite", "double", "std::allocator", size,
+    [&]() {
+      linarray<double> larr;
+      larr.resize_and_overwrite( size,
+        [&]( double* data, std::size_t count ) {
+          fill( data, count );
+          return count;
+        } );
+      shared::do_not_optimize( larr.data() );
+    } );
+}
+
+// views of size ints inside cache line aligned buffers, optionally shifted
+static void ALIGNMENT_BENCHMARKS( shared::bench_suite& suite,
+  std::size_t size )
+{
+  typedef abc_allocator<int, 64> line_alloc;
+  linarray<int, line_alloc> source( size + 16 ), dest( size + 16 );
+  shared::fill_data( source, shared::dist_shuffled );
+
+  for (std::size_t shift : { 0, 1 }) {
+    const std::string offset = shift ? ", misaligned" : ", aligned";
+    const int* src = source.data() + shift;
+    int* dst = dest.data() + shift;
+    suite.run( "sum kernel" + offset, "int", "abc_allocator<64>", size,
+      [&]() {
+        long long sum = 0;  // the sum of size ints overflows int
+        for (std::size_t i = 0; i < size; ++i) { sum += src[i]; }
+        shared::do_not_optimize( sum );
+      } );
+    suite.run( "copy kernel" + offset, "int", "abc_allocator<64>", size,
+      [&]() {
+        for (std::size_t i = 0; i < size; ++i) { dst[i] = src[i]; }
+        shared::clobber_memory();
+      } );
+  }
+}
+
+typedef linarray< double, numa_allocator<double> > numa_linarray;
+
+// every pinned thread sums the slice parallel_fill() gave it
+static double PARALLEL_SUM( const numa_linarray& larr, unsigned threads ) {
+  std::vector<double> sums( threads );
+  std::vector<std::thread> workers;
+  const std::size_t count = larr.size();
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back( [&, t]() {
+      numa::pin_thread( t );
+      double sum = 0.0;
+      const double* first = larr.data() + count * t / threads;
+      const double* last = larr.data() + count * (t + 1) / threads;
+      for (; first != last; ++first) { sum += *first; }
+      sums[t] = sum;
+    } );
+  }
+  for (std::thread& worker : workers) { worker.join(); }
+  return std::accumulate( sums.cbegin(), sums.cend(), 0.0 );
+}
+
+static void NUMA_BENCHMARKS( shared::bench_suite& suite, std::size_t size ) {
+  const unsigned threads = std::max( 1u, std::thread::hardware_concurrency() );
+  const std::string alloc = "numa_allocator, " + std::to_string(threads)
+    + " threads, " + std::to_string( numa::node_count() ) + " nodes";
+  const auto measure = [&]( const std::string& name, numa::placement where,
+    bool parallel_touch )
+  {
+    if ( !suite.selected( name ) ) { return; }
+    numa_linarray larr( size, default_init, numa_allocator<double>( where ) );
+    if ( parallel_touch ) {
+      numa::parallel_fill( larr.begin(), larr.end(), 1.0, threads );
+    }
+    else {
+      std::fill( larr.begin(), larr.end(), 1.0 );
+    }
+    const shared::bench_stats s = suite.run( name, "double", alloc, size,
+      [&]() { shared::do_not_optimize( PARALLEL_SUM( larr, threads ) ); } );
+    if ( s.median > 0.0 ) {
+      std::cout << "      " << size * sizeof(double) / s.median << " GB/s"
+        << std::endl;
+    }
+  };
+  measure( "parallel sum, serial first touch", numa::first_touch, false );
+  measure( "parallel sum, parallel first touch", numa::first_touch, true );
+  measure( "parallel sum, interleaved", numa::interleaved, false );
+}
+
+int main( int argc, char* argv[] ) {
+  shared::bench_suite suite( argc, argv );
+  if (!suite) { return 2; }
+  const shared::bench_options& opts = suite.options();
+
+  for (std::size_t size : opts.sizes) {
+    suite.section( "initialization, " + std::to_string(size) + " doubles" );
+    INIT_BENCHMARKS( suite, size );
+
+    suite.section( "alignment, " + std::to_string(size) + " ints" );
+    ALIGNMENT_BENCHMARKS( suite, size );
+
+    suite.section( "NUMA placement, " + std::to_string(size) + " doubles" );
+    NUMA_BENCHMARKS( suite, size );
+
+    for (shared::data_distribution d : opts.distributions) {
+      const std::string dist = shared::distribution_name(d);
+      suite.section( "allocators, " + std::to_string(size) + " " + dist );
+
+      std::vector<int> order( size );
+      shared::fill_data( order, d, opts.seed );
+      const bool permutation = d == shared::dist_sorted ||
+        d == shared::dist_reversed || d == shared::dist_shuffled;
+      ALLOC_BENCHMARKS< std::allocator<int> >( suite, "std::allocator", dist, order,
+        permutation );
+      ALLOC_BENCHMARKS< abc_allocator<int> >( suite, "abc_allocator", dist, order,
+        permutation );
+    }
+  }
+  return suite.finish();
+}
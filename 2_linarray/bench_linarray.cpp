@@ -0,0 +1,717 @@
+/*
+  Container benchmark: linarray against std::vector for growth, bulk
+  append, copying, traversal and one-pass removal (also against a loop of
+  erase()), and hash_set against std::unordered_set for deduplication of
+  int keys (every data distribution) and of complex values on a grid.
+  flat_set and flat_map against std::set and std::map: bulk build from
+  shuffled keys, merging a batch of 1% new keys, and lookups of which half
+  miss (for 10M keys: --size 10M --filter table). Lookups in
+  static_search_index, one by one and in batches, against std::lower_bound
+  on the sorted keys (for 100M keys: --size 100M --filter search).
+  FIFO throughput of ring_buffer against std::deque, and against a
+  linarray popped with erase(cbegin()) for a window of 1024 elements.
+  Snapshots of a cow_array against a deep linarray copy, and the chunks a
+  writer copies after a snapshot (for a 1 GB table: --size 256M --filter
+  snapshot).
+  Also: single append latency and memory peak of segmented_array, appends
+  from 1 to 64 producer threads to a concurrent_array against a mutex-
+  guarded linarray, the startup cost of a persistent mapped_array against
+  reading the same file into a linarray, and binary save/load throughput
+  against text. File benchmarks read a warm page cache unless it is
+  dropped between runs (echo 3 > /proc/sys/vm/drop_caches).
+  usage: bench_linarray [--size 1K,1M] [--dist few-unique] ... (see --help)
+*/
+
+#include <vector>
+#include <unordered_set>
+#include <set>
+#include <map>
+#include <deque>
+#include <string>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+
+#include <bench_suite.hpp>
+#include <complex_t.hpp>
+
+#include "linarray.hpp"
+#include "hash_set.hpp"
+#include "mapped_array.hpp"
+#include "linarray_io.hpp"
+#include "segmented_array.hpp"
+#include "concurrent_array.hpp"
+#include "flat_set.hpp"
+#include "flat_map.hpp"
+#include "search_index.hpp"
+#include "ring_buffer.hpp"
+#include "cow_array.hpp"
+
+// bytes allocated through counting_allocator, now and at most
+struct alloc_counter {
+  static std::size_t current, peak;
+  static void reset() { current = peak = 0; }
+};
+std::size_t alloc_counter::current = 0;
+std::size_t alloc_counter::peak = 0;
+
+template< typename T >
+struct counting_allocator {
+  typedef T value_type;
+
+  counting_allocator() {}
+  template< typename U >
+  counting_allocator( const counting_allocator<U>& ) {}
+
+  T* allocate( std::size_t cnt ) {
+    alloc_counter::current += cnt * sizeof(T);
+    alloc_counter::peak = std::max( alloc_counter::peak, alloc_counter::current );
+    return static_cast<T*>( ::operator new( cnt * sizeof(T) ) );
+  }
+  void deallocate( T* p, std::size_t cnt ) {
+    alloc_counter::current -= cnt * sizeof(T);
+    ::operator delete(p);
+  }
+};
+
+template< typename T, typename U >
+bool operator== ( const counting_allocator<T>&, const counting_allocator<U>& ) {
+  return true;
+}
+
+template< typename T, typename U >
+bool operator!= ( const counting_allocator<T>&, const counting_allocator<U>& ) {
+  return false;
+}
+
+template< class C >
+static void CONTAINER_BENCHMARKS( shared::bench_suite& suite,
+  const char* container, const std::vector<int>& source )
+{
+  const std::size_t size = source.size();
+  const std::string prefix = std::string(container) + " ";
+
+  suite.run( prefix + "push_back", "int", "std::allocator", size,
+    [&]() {
+      C con;
+      for (int x : source) { con.push_back( x ); }
+      shared::do_not_optimize( con.data() );
+    } );
+
+  const C filled( source.cbegin(), source.cend() );
+  C copy;
+  suite.run( prefix + "copy assignment", "int", "std::allocator", size,
+    [&]() { copy = filled; shared::do_not_optimize( copy.data() ); } );
+
+  suite.run( prefix + "traversal", "int", "std::allocator", size,
+    [&]() {
+      shared::do_not_optimize(
+        std::accumulate( filled.cbegin(), filled.cend(), 0LL ) );
+    } );
+}
+
+// growth without reallocation: total time of appends, then every single
+// append timed once for the latency distribution, and the memory peak
+template< class C >
+static void APPEND_BENCHMARKS( shared::bench_suite& suite,
+  const char* container, std::size_t size )
+{
+  const std::string name = std::string(container) + " append";
+  if ( !suite.selected( name ) ) { return; }
+  suite.run( name, "int", "counting_allocator", size,
+    [&]() {
+      C con;
+      for (std::size_t i = 0; i < size; ++i) { con.push_back( i ); }
+      shared::do_not_optimize( con.back() );
+    } );
+
+  std::vector<double> latency( size );
+  alloc_counter::reset();
+  {
+    C con;
+    for (std::size_t i = 0; i < size; ++i) {
+      const auto start = std::chrono::steady_clock::now();
+      con.push_back( i );
+      latency[i] = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start ).count();
+    }
+    shared::do_not_optimize( con.back() );
+  }
+  const double max_latency = *std::max_element( latency.cbegin(), latency.cend() );
+  const shared::bench_stats s = shared::bench_stats::from_samples( latency, 1 );
+  std::cout << "      single append: median "
+    << shared::bench_stats::format_time( s.median )
+    << ", p99 " << shared::bench_stats::format_time( s.p99 )
+    << ", max " << shared::bench_stats::format_time( max_latency )
+    << "; memory peak " << alloc_counter::peak / 1e6 << " MB"
+    << " for " << size * sizeof(int) / 1e6 << " MB of data" << std::endl;
+}
+
+// runs producer(thread index) on the given number of threads
+template< typename F >
+static void RUN_THREADS( unsigned threads, F producer ) {
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; ++t) { pool.emplace_back( producer, t ); }
+  for (std::thread& thread : pool) { thread.join(); }
+}
+
+// the same number of ints appended by 1 to 64 threads, then sealed
+static void CONCURRENT_BENCHMARKS( shared::bench_suite& suite,
+  std::size_t size )
+{
+  for (unsigned threads = 1; threads <= 64; threads *= 2) {
+    const std::string suffix = ", " + std::to_string(threads) + " threads";
+    const std::size_t per_thread = size / threads;
+
+    suite.run( "mutex linarray append" + suffix, "int", "std::allocator", size,
+      [&]() {
+        linarray<int> larr;
+        std::mutex larr_mutex;
+        RUN_THREADS( threads, [&]( unsigned t ) {
+          for (std::size_t i = 0; i < per_thread; ++i) {
+            std::lock_guard<std::mutex> lock( larr_mutex );
+            larr.push_back( t * per_thread + i );
+          }
+        } );
+        shared::do_not_optimize( larr.data() );
+      } );
+
+    suite.run( "concurrent_array append" + suffix, "int", "std::allocator",
+      size,
+      [&]() {
+        concurrent_array<int> carr;
+        RUN_THREADS( threads, [&]( unsigned t ) {
+          for (std::size_t i = 0; i < per_thread; ++i) {
+            carr.push_back( t * per_thread + i );
+          }
+        } );
+        shared::do_not_optimize( carr[0] );
+      } );
+  }
+
+  concurrent_array<int> carr;
+  suite.run( "concurrent_array seal", "int", "std::allocator", size,
+    [&]() {
+      for (std::size_t i = 0; i < size; ++i) { carr.push_back( i ); }
+    },
+    [&]() {
+      linarray<int> sealed = carr.seal();
+      shared::do_not_optimize( sealed.data() );
+    } );
+}
+
+// one range appended to an empty container
+static void BULK_BENCHMARKS( shared::bench_suite& suite,
+  const std::vector<int>& source )
+{
+  const std::size_t size = source.size();
+  suite.run( "std::vector bulk insert", "int", "std::allocator", size,
+    [&]() {
+      std::vector<int> vec;
+      vec.insert( vec.cend(), source.cbegin(), source.cend() );
+      shared::do_not_optimize( vec.data() );
+    } );
+  suite.run( "linarray bulk append, pointers", "int", "std::allocator", size,
+    [&]() {
+      linarray<int> larr;
+      larr.append( source.data(), source.data() + size );
+      shared::do_not_optimize( larr.data() );
+    } );
+  suite.run( "linarray bulk append, iterators", "int", "std::allocator", size,
+    [&]() {
+      linarray<int> larr;
+      larr.append( source.cbegin(), source.cend() );
+      shared::do_not_optimize( larr.data() );
+    } );
+}
+
+// removing a share of shuffled keys: linarray::erase_if, a loop of
+// erase() (quadratic, so only up to 100K elements) and std::remove_if
+static void COMPACTION_BENCHMARKS( shared::bench_suite& suite,
+  const std::vector<int>& source )
+{
+  const std::size_t size = source.size();
+  for (int percent : { 10, 50, 90 }) {
+    const std::string share = ", " + std::to_string(percent) + "% removed";
+    const auto removed = [percent]( int x ) { return x % 100 < percent; };
+    linarray<int> larr;
+    std::vector<int> vec;
+    const auto fill_larr = [&]() { larr.assign( source.cbegin(), source.cend() ); };
+
+    suite.run( "linarray erase_if" + share, "int", "std::allocator", size,
+      fill_larr,
+      [&]() { shared::do_not_optimize( larr.erase_if( removed ) ); } );
+    if ( size <= 100000 ) {
+      suite.run( "linarray erase() loop" + share, "int", "std::allocator", size,
+        fill_larr,
+        [&]() {
+          for (linarray<int>::iterator it = larr.begin(); it != larr.end(); ) {
+            if ( removed(*it) ) { it = larr.erase(it); } else { ++it; }
+          }
+          shared::do_not_optimize( larr.data() );
+        } );
+    }
+    suite.run( "std::vector remove_if" + share, "int", "std::allocator", size,
+      [&]() { vec.assign( source.cbegin(), source.cend() ); },
+      [&]() {
+        vec.erase( std::remove_if( vec.begin(), vec.end(), removed ), vec.end() );
+        shared::do_not_optimize( vec.data() );
+      } );
+  }
+}
+
+static void DEDUP_BENCHMARKS( shared::bench_suite& suite, const std::string& dist,
+  const std::vector<int>& keys )
+{
+  const std::size_t size = keys.size();
+  suite.run( "std::unordered_set dedup, " + dist, "int", "std::allocator", size,
+    [&]() {
+      std::unordered_set<int> set( keys.cbegin(), keys.cend() );
+      shared::do_not_optimize( set.size() );
+    } );
+  suite.run( "hash_set dedup, " + dist, "int", "std::allocator", size,
+    [&]() {
+      hash_set<int> set( keys.cbegin(), keys.cend() );
+      shared::do_not_optimize( set.size() );
+    } );
+}
+
+// keys are a permutation of [0, size), queries hit and miss half the time
+static void SORTED_TABLE_BENCHMARKS( shared::bench_suite& suite,
+  const std::vector<int>& keys, unsigned seed )
+{
+  const std::size_t size = keys.size();
+  std::vector< std::pair<int, int> > entries( size );
+  for (std::size_t i = 0; i < size; ++i) { entries[i] = std::make_pair( keys[i], 1 ); }
+  std::vector<int> queries( size ), batch( size / 100 + 1 );
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> any( 0, static_cast<int>( 2 * size ) );
+  for (int& q : queries) { q = any(gen); }
+  for (int& b : batch) { b = any(gen); }
+
+  suite.run( "table std::set build", "int", "std::allocator", size,
+    [&]() {
+      std::set<int> set( keys.cbegin(), keys.cend() );
+      shared::do_not_optimize( set.size() );
+    } );
+  suite.run( "table flat_set build", "int", "std::allocator", size,
+    [&]() {
+      flat_set<int> set( keys.cbegin(), keys.cend() );
+      shared::do_not_optimize( set.size() );
+    } );
+  suite.run( "table std::map build", "int", "std::allocator", size,
+    [&]() {
+      std::map<int, int> map( entries.cbegin(), entries.cend() );
+      shared::do_not_optimize( map.size() );
+    } );
+  suite.run( "table flat_map build", "int", "std::allocator", size,
+    [&]() {
+      flat_map<int, int> map( entries.cbegin(), entries.cend() );
+      shared::do_not_optimize( map.size() );
+    } );
+
+  const std::set<int> std_set( keys.cbegin(), keys.cend() );
+  const flat_set<int> set( keys.cbegin(), keys.cend() );
+  const std::map<int, int> std_map( entries.cbegin(), entries.cend() );
+  const flat_map<int, int> map( entries.cbegin(), entries.cend() );
+
+  std::set<int> std_work;
+  suite.run( "table std::set batch insert", "int", "std::allocator",
+    batch.size(),
+    [&]() { std_work = std_set; },
+    [&]() { std_work.insert( batch.cbegin(), batch.cend() ); } );
+  flat_set<int> work;
+  suite.run( "table flat_set batch insert", "int", "std::allocator",
+    batch.size(),
+    [&]() { work = set; },
+    [&]() { work.insert( batch.cbegin(), batch.cend() ); } );
+
+  suite.run( "table std::set lookups", "int", "std::allocator", size,
+    [&]() {
+      std::size_t hits = 0;
+      for (int q : queries) { hits += std_set.count( q ); }
+      shared::do_not_optimize( hits );
+    } );
+  suite.run( "table flat_set lookups", "int", "std::allocator", size,
+    [&]() {
+      std::size_t hits = 0;
+      for (int q : queries) { hits += set.count( q ); }
+      shared::do_not_optimize( hits );
+    } );
+  suite.run( "table std::map lookups", "int", "std::allocator", size,
+    [&]() {
+      long sum = 0;
+      for (int q : queries) {
+        const std::map<int, int>::const_iterator it = std_map.find( q );
+        if ( it != std_map.cend() ) { sum += it->second; }
+      }
+      shared::do_not_optimize( sum );
+    } );
+  suite.run( "table flat_map lookups", "int", "std::allocator", size,
+    [&]() {
+      long sum = 0;
+      for (int q : queries) {
+        const flat_map<int, int>::const_iterator it = map.find( q );
+        if ( it != map.cend() ) { sum += it->second; }
+      }
+      shared::do_not_optimize( sum );
+    } );
+}
+
+// even keys of [0, 2 * size), random queries over the same range
+static void SEARCH_INDEX_BENCHMARKS( shared::bench_suite& suite,
+  std::size_t size, unsigned seed )
+{
+  if ( !suite.selected( "search" ) ) { return; }
+  linarray<int> keys( size, default_init );
+  for (std::size_t i = 0; i < size; ++i) { keys[i] = static_cast<int>( 2 * i ); }
+  const static_search_index<int> index( keys.cbegin(), keys.cend() );
+  std::vector<int> queries( size );
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> any( 0, static_cast<int>( 2 * size ) );
+  for (int& q : queries) { q = any(gen); }
+  std::vector<std::size_t> ranks( size );
+
+  suite.run( "search std::lower_bound", "int", "std::allocator", size,
+    [&]() {
+      for (std::size_t i = 0; i < size; ++i) {
+        ranks[i] = std::lower_bound( keys.cbegin(), keys.cend(), queries[i] )
+          - keys.cbegin();
+      }
+      shared::clobber_memory();
+    } );
+  suite.run( "search static_search_index", "int", "abc_allocator<64>", size,
+    [&]() {
+      for (std::size_t i = 0; i < size; ++i) {
+        ranks[i] = index.lower_bound( queries[i] );
+      }
+      shared::clobber_memory();
+    } );
+  suite.run( "search static_search_index, batched", "int", "abc_allocator<64>",
+    size,
+    [&]() {
+      index.lower_bound( queries.cbegin(), queries.cend(), ranks.begin() );
+      shared::clobber_memory();
+    } );
+}
+
+static const std::size_t QUEUE_WINDOW = 1024;
+
+// every element is pushed at the back and popped at the front once
+template< class Q >
+static void QUEUE_BENCHMARKS( shared::bench_suite& suite, const char* queue,
+  std::size_t size )
+{
+  suite.run( std::string("queue fill and drain, ") + queue, "int",
+    "std::allocator", size,
+    [&]() {
+      Q q;
+      for (std::size_t i = 0; i < size; ++i) { q.push_back( static_cast<int>(i) ); }
+      long sum = 0;
+      while ( !q.empty() ) { sum += q.front(); q.pop_front(); }
+      shared::do_not_optimize( sum );
+    } );
+  suite.run( std::string("queue sliding window, ") + queue, "int",
+    "std::allocator", size,
+    [&]() {
+      Q q;
+      long sum = 0;
+      for (std::size_t i = 0; i < size; ++i) {
+        q.push_back( static_cast<int>(i) );
+        if ( q.size() > QUEUE_WINDOW ) { sum += q.front(); q.pop_front(); }
+      }
+      shared::do_not_optimize( sum );
+    } );
+}
+
+// pop_front() by erase(), one move of the whole window per element
+struct linarray_queue : linarray<int> {
+  inline void pop_front() { erase( cbegin() ); }
+};
+
+static void QUEUE_LIMIT_BENCHMARKS( shared::bench_suite& suite,
+  std::size_t size )
+{
+  suite.run( "queue sliding window, linarray erase(cbegin())", "int",
+    "std::allocator", size,
+    [&]() {
+      linarray_queue q;
+      long sum = 0;
+      for (std::size_t i = 0; i < size; ++i) {
+        q.push_back( static_cast<int>(i) );
+        if ( q.size() > QUEUE_WINDOW ) { sum += q.front(); q.pop_front(); }
+      }
+      shared::do_not_optimize( sum );
+    } );
+  suite.run( "queue sliding window, ring_buffer with limit", "int",
+    "std::allocator", size,
+    [&]() {
+      ring_buffer<int> q;
+      q.set_limit( QUEUE_WINDOW );
+      for (std::size_t i = 0; i < size; ++i) { q.push_back( static_cast<int>(i) ); }
+      shared::do_not_optimize( q.front() );
+    } );
+}
+
+// a snapshot, then writes at random positions: the time includes copying
+// the chunk table and every chunk written to, the bytes copied per byte
+// written are the write amplification
+static void SNAPSHOT_BENCHMARKS( shared::bench_suite& suite,
+  std::size_t size, unsigned seed )
+{
+  if ( !suite.selected( "snapshot" ) ) { return; }
+  typedef cow_array< int, counting_allocator<int> > t_table;
+  linarray<int> source( size, default_init );
+  std::iota( source.begin(), source.end(), 0 );
+  t_table table( source.cbegin(), source.cend() );
+
+  linarray<int> copy;
+  suite.run( "snapshot, linarray copy", "int", "std::allocator", size,
+    [&]() { copy = source; shared::do_not_optimize( copy.data() ); } );
+  copy = linarray<int>();
+  suite.run( "snapshot, cow_array copy", "int", "counting_allocator", size,
+    [&]() {
+      const t_table snap( table );
+      shared::do_not_optimize( snap.chunk_data( 0 ) );
+    } );
+
+  std::vector<std::size_t> positions( std::min<std::size_t>( size, 100000 ) );
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<std::size_t> any( 0, size - 1 );
+  for (std::size_t& pos : positions) { pos = any(gen); }
+
+  for (std::size_t writes = 1; writes <= positions.size(); writes *= 100) {
+    const auto snapshot_and_write = [&]() {
+      const t_table snap( table );
+      for (std::size_t i = 0; i < writes; ++i) { ++table[positions[i]]; }
+      shared::do_not_optimize( snap.chunk_data( 0 ) );
+      return table.chunks() - table.shared_chunks();
+    };
+    suite.run( "snapshot and " + std::to_string(writes) + " random writes, cow_array",
+      "int", "counting_allocator", size, snapshot_and_write );
+
+    alloc_counter::reset();
+    const std::size_t copied_chunks = snapshot_and_write();
+    const double written = static_cast<double>( writes * sizeof(int) );
+    std::cout << "      copied " << copied_chunks << " of " << table.chunks()
+      << " chunks, " << alloc_counter::peak / 1e6 << " MB: "
+      << alloc_counter::peak / written << " bytes per byte written" << std::endl;
+  }
+}
+
+// about 12 samples per grid cell, jittered within the tolerance
+static void COMPLEX_DEDUP_BENCHMARKS( shared::bench_suite& suite,
+  std::size_t size, unsigned seed )
+{
+  const double tolerance = 1e-3;
+  const int cells = std::max( 1, static_cast<int>( std::sqrt( size / 12.0 ) ) );
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<> cell(0, cells-1);
+  std::uniform_real_distribution<> jitter(-tolerance / 4.0, tolerance / 4.0);
+
+  linarray<complex_t> samples( size );
+  for (complex_t& c : samples) {
+    c = complex_t( cell(gen) * tolerance + jitter(gen),
+                   cell(gen) * tolerance + jitter(gen) );
+  }
+
+  suite.run( "std::unordered_set complex grid dedup", "complex_t",
+    "std::allocator", size,
+    [&]() {
+      std::unordered_set<complex_t, complex_grid_hash, complex_grid_equal>
+        set( 0, complex_grid_hash(tolerance), complex_grid_equal(tolerance) );
+      for (const complex_t& c : samples) { set.insert( c ); }
+      shared::do_not_optimize( set.size() );
+    } );
+  suite.run( "hash_set complex grid dedup", "complex_t", "std::allocator", size,
+    [&]() {
+      hash_set<complex_t, complex_grid_hash, complex_grid_equal>
+        set( 0, complex_grid_hash(tolerance), complex_grid_equal(tolerance) );
+      set.insert( samples.cbegin(), samples.cend() );
+      shared::do_not_optimize( set.size() );
+    } );
+}
+
+// time from opening a file to the first element used: a mapped_array,
+// against a plain dump (count, then elements) read into a linarray
+static void PERSISTENCE_BENCHMARKS( shared::bench_suite& suite,
+  std::size_t size )
+{
+  if ( !suite.selected( "startup" ) ) { return; }
+  const char* mapped_path = "bench_mapped_array.bin";
+  const char* dump_path = "bench_linarray_dump.bin";
+  {
+    mapped_array<int> marr( mapped_path, mapped_array<int>::create );
+    marr.resize( size );
+    shared::fill_data( marr, shared::dist_shuffled );
+    marr.flush();
+
+    std::ofstream dump( dump_path, std::ios::binary );
+    const std::uint64_t count = size;
+    dump.write( reinterpret_cast<const char*>(&count), sizeof(count) );
+    dump.write( reinterpret_cast<const char*>( marr.data() ),
+      size * sizeof(int) );
+  }
+
+  suite.run( "startup, mapped_array open", "int", "mmap", size,
+    [&]() {
+      const mapped_array<int> marr( mapped_path, mapped_array<int>::open_read );
+      shared::do_not_optimize( marr[size / 2] );
+    } );
+  suite.run( "startup, read into linarray", "int", "std::allocator", size,
+    [&]() {
+      std::ifstream dump( dump_path, std::ios::binary );
+      std::uint64_t count = 0;
+      dump.read( reinterpret_cast<char*>(&count), sizeof(count) );
+      linarray<int> larr( count );
+      dump.read( reinterpret_cast<char*>( larr.data() ), count * sizeof(int) );
+      shared::do_not_optimize( larr[size / 2] );
+    } );
+  std::remove( mapped_path );
+  std::remove( dump_path );
+}
+
+static void PRINT_THROUGHPUT( const shared::bench_stats& s, std::size_t bytes )
+{
+  if ( s.median > 0.0 ) {
+    std::cout << "      " << bytes / s.median << " GB/s" << std::endl;
+  }
+}
+
+// save and load throughput of the binary format, against writing and
+// parsing the elements one by one as text
+static void SERIALIZATION_BENCHMARKS( shared::bench_suite& suite,
+  std::size_t size, unsigned seed )
+{
+  const char* path = "bench_linarray_io.bin";
+  const char* text_path = "bench_linarray_io.txt";
+  const std::size_t bytes = size * sizeof(int);
+  linarray<int> source( size );
+  shared::fill_data( source, shared::dist_shuffled, seed );
+
+  PRINT_THROUGHPUT( suite.run( "save, writev", "int", "std::allocator", size,
+    [&]() { linarray_io::save_file( source, path ); } ), bytes );
+  PRINT_THROUGHPUT( suite.run( "save, O_DIRECT", "int", "std::allocator", size,
+    [&]() { linarray_io::save_file( source, path, true ); } ), bytes );
+  PRINT_THROUGHPUT( suite.run( "save, text", "int", "std::allocator", size,
+    [&]() {
+      std::ofstream out( text_path );
+      for (int x : source) { out << x << '\n'; }
+    } ), bytes );
+
+  linarray_io::save_file( source, path );
+  PRINT_THROUGHPUT( suite.run( "load, read", "int", "std::allocator", size,
+    [&]() {
+      linarray<int> larr;
+      linarray_io::load_file( larr, path );
+      shared::do_not_optimize( larr[size / 2] );
+    } ), bytes );
+  PRINT_THROUGHPUT( suite.run( "load, O_DIRECT", "int", "std::allocator", size,
+    [&]() {
+      linarray<int> larr;
+      linarray_io::load_file( larr, path, true );
+      shared::do_not_optimize( larr[size / 2] );
+    } ), bytes );
+  PRINT_THROUGHPUT( suite.run( "load, chunks of 64K", "int", "std::allocator",
+    size,
+    [&]() {
+      linarray_io::chunk_reader<int> reader( path );
+      linarray<int> chunk;
+      long long sum = 0;
+      while ( reader.next( chunk, 1 << 16 ) > 0 ) { sum += chunk.back(); }
+      shared::do_not_optimize( sum );
+    } ), bytes );
+  if ( suite.selected( "load, text" ) ) {
+    std::ofstream out( text_path );
+    for (int x : source) { out << x << '\n'; }
+  }
+  PRINT_THROUGHPUT( suite.run( "load, text", "int", "std::allocator", size,
+    [&]() {
+      std::ifstream in( text_path );
+      linarray<int> larr;
+      int x;
+      while ( in >> x ) { larr.push_back( x ); }
+      shared::do_not_optimize( larr[size / 2] );
+    } ), bytes );
+  std::remove( path );
+  std::remove( text_path );
+}
+
+#if defined(SHARED_TRACE)
+// cost of one empty traced scope
+static void TRACE_BENCHMARKS( shared::bench_suite& suite ) {
+  suite.run( "empty trace scope", "-", "-", 1,
+    []() { TRACE_SCOPE( "empty" ); shared::clobber_memory(); } );
+}
+#endif
+
+int main( int argc, char* argv[] ) {
+  shared::bench_suite suite( argc, argv );
+  if (!suite) { return 2; }
+  const shared::bench_options& opts = suite.options();
+  #if defined(SHARED_TRACE)
+    suite.section( "tracing" );
+    TRACE_BENCHMARKS( suite );
+  #endif
+
+  for (std::size_t size : opts.sizes) {
+    const std::string count = std::to_string(size);
+    std::vector<int> keys( size );
+
+    suite.section( "containers, " + count + " ints" );
+    shared::fill_data( keys, shared::dist_shuffled, opts.seed );
+    CONTAINER_BENCHMARKS< std::vector<int> >( suite, "std::vector", keys );
+    CONTAINER_BENCHMARKS< linarray<int> >( suite, "linarray", keys );
+    BULK_BENCHMARKS( suite, keys );
+
+    suite.section( "compaction, " + count + " ints" );
+    COMPACTION_BENCHMARKS( suite, keys );
+
+    suite.section( "appends, " + count + " ints" );
+    APPEND_BENCHMARKS< linarray<int, counting_allocator<int>> >(
+      suite, "linarray", size );
+    APPEND_BENCHMARKS< segmented_array<int, counting_allocator<int>> >(
+      suite, "segmented_array", size );
+
+    suite.section( "concurrent appends, " + count + " ints" );
+    CONCURRENT_BENCHMARKS( suite, size );
+
+    for (shared::data_distribution d : opts.distributions) {
+      const std::string dist = shared::distribution_name(d);
+      suite.section( "deduplication, " + count + " " + dist + " ints" );
+      shared::fill_data( keys, d, opts.seed );
+      DEDUP_BENCHMARKS( suite, dist, keys );
+    }
+
+    suite.section( "sorted tables, " + count + " ints" );
+    shared::fill_data( keys, shared::dist_shuffled, opts.seed );
+    SORTED_TABLE_BENCHMARKS( suite, keys, opts.seed );
+
+    suite.section( "queues, " + count + " ints" );
+    QUEUE_BENCHMARKS< std::deque<int> >( suite, "std::deque", size );
+    QUEUE_BENCHMARKS< ring_buffer<int> >( suite, "ring_buffer", size );
+    QUEUE_LIMIT_BENCHMARKS( suite, size );
+
+    suite.section( "snapshots, " + count + " ints" );
+    SNAPSHOT_BENCHMARKS( suite, size, opts.seed );
+
+    suite.section( "search index, " + count + " ints" );
+    SEARCH_INDEX_BENCHMARKS( suite, size, opts.seed );
+
+    suite.section( "deduplication, " + count + " complex values" );
+    COMPLEX_DEDUP_BENCHMARKS( suite, size, opts.seed );
+
+    suite.section( "persistence, " + count + " ints" );
+    PERSISTENCE_BENCHMARKS( suite, size );
+
+    suite.section( "serialization, " + count + " ints" );
+    SERIALIZATION_BENCHMARKS( suite, size, opts.seed );
+  }
+  return suite.finish();
+}
@@ -0,0 +1,179 @@
+/*
+  Parallel algorithms benchmark: custom::parallel_for_each, _transform,
+  _reduce and _inclusive_scan over a linarray<double>, on pools of 1, 2,
+  4, ... threads up to the number of cores, with the speedup over one
+  thread. The memory-bound lambdas do one multiply-add per element and are
+  limited by the memory bandwidth; the compute-bound one iterates the
+  Mandelbrot map up to 64 times per element and should scale with the
+  cores. The scheduler itself is measured by spawning and syncing empty
+  tasks (the cost per task), a task-per-call Fibonacci recursion and a
+  recursive fork/join sum. Pool sizes can be restricted with the filter, e.g.
+  bench_parallel --size 16M --filter "4 threads"
+  usage: bench_parallel [--size 1K,1M] ... (see --help)
+*/
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <iostream>
+
+#include <bench_suite.hpp>
+#include <thread_pool.hpp>
+
+#include "linarray.hpp"
+#include "parallel_algorithms.hpp"
+
+static const int MAX_ITERATIONS = 64;
+
+// the escape time of c = (x, x/2) - an uneven amount of work per element
+static double ESCAPE_TIME( double x ) {
+  const double c_re = x, c_im = 0.5 * x;
+  double re = 0.0, im = 0.0;
+  int i = 0;
+  for (; i < MAX_ITERATIONS && re * re + im * im <= 4.0; ++i) {
+    const double t = re * re - im * im + c_re;
+    im = 2.0 * re * im + c_im;
+    re = t;
+  }
+  return i;
+}
+
+// 1, 2, 4, ... and the number of cores
+static std::vector<unsigned> THREAD_COUNTS() {
+  const unsigned cores = shared::thread_pool::default_threads();
+  std::vector<unsigned> counts;
+  for (unsigned t = 1; t < cores; t *= 2) { counts.push_back( t ); }
+  counts.push_back( cores );
+  return counts;
+}
+
+static void SCALING_BENCHMARKS( shared::bench_suite& suite, std::size_t size ) {
+  linarray<double> input( size, default_init );
+  for (std::size_t i = 0; i < size; ++i) {
+    input[i] = -2.0 + 2.5 * static_cast<double>(i) / size;
+  }
+  linarray<double> output( size, default_init );
+  std::vector<double> single( 5, 0.0 );   // medians on one thread
+
+  for (unsigned threads : THREAD_COUNTS()) {
+    shared::thread_pool pool( threads );
+    const std::string label = std::to_string(threads) + " threads";
+    int kernel = 0;
+    const auto report = [&]( const shared::bench_stats& s ) {
+      if ( s.median > 0.0 ) {
+        if ( threads == 1 ) { single[kernel] = s.median; }
+        if ( single[kernel] > 0.0 ) {
+          std::cout << "      speedup " << single[kernel] / s.median
+            << ", " << size * sizeof(double) / s.median << " GB/s" << std::endl;
+        }
+      }
+      ++kernel;
+    };
+
+    report( suite.run( "memory-bound for_each, " + label, "double",
+      "std::allocator", size,
+      [&]() {
+        custom::parallel_for_each( output.begin(), output.end(),
+          []( double& x ) { x = 0.5 * x + 1.0; }, pool );
+        shared::clobber_memory();
+      } ) );
+    report( suite.run( "memory-bound transform, " + label, "double",
+      "std::allocator", size,
+      [&]() {
+        custom::parallel_transform( input.cbegin(), input.cend(),
+          output.begin(), []( double x ) { return 0.5 * x + 1.0; }, pool );
+        shared::clobber_memory();
+      } ) );
+    report( suite.run( "memory-bound reduce, " + label, "double",
+      "std::allocator", size,
+      [&]() {
+        shared::do_not_optimize( custom::parallel_reduce(
+          input.cbegin(), input.cend(), 0.0, pool ) );
+      } ) );
+    report( suite.run( "memory-bound inclusive_scan, " + label, "double",
+      "std::allocator", size,
+      [&]() {
+        custom::parallel_inclusive_scan( input.cbegin(), input.cend(),
+          output.begin(), pool );
+        shared::clobber_memory();
+      } ) );
+    report( suite.run( "compute-bound transform, " + label, "double",
+      "std::allocator", size,
+      [&]() {
+        custom::parallel_transform( input.cbegin(), input.cend(),
+          output.begin(), ESCAPE_TIME, pool );
+        shared::clobber_memory();
+      } ) );
+  }
+}
+
+static const int FIB_N = 25;          // 242785 calls, one task each
+static const std::size_t SUM_LEAF = 4096;
+
+static long FIB( shared::thread_pool& pool, int n ) {
+  if ( n < 2 ) { return n; }
+  long a = 0;
+  shared::task_group group( pool );
+  group.spawn( [&]() { a = FIB( pool, n - 1 ); } );
+  const long b = FIB( pool, n - 2 );
+  group.sync();
+  return a + b;
+}
+
+static double RECURSIVE_SUM( shared::thread_pool& pool, const double* first,
+  const double* last )
+{
+  const std::size_t count = last - first;
+  if ( count <= SUM_LEAF ) { return std::accumulate( first, last, 0.0 ); }
+  const double* middle = first + count / 2;
+  double left = 0.0;
+  shared::task_group group( pool );
+  group.spawn( [&]() { left = RECURSIVE_SUM( pool, first, middle ); } );
+  const double right = RECURSIVE_SUM( pool, middle, last );
+  group.sync();
+  return left + right;
+}
+
+static void SCHEDULER_BENCHMARKS( shared::bench_suite& suite, std::size_t size ) {
+  linarray<double> input( size, 1.0 );
+  for (unsigned threads : THREAD_COUNTS()) {
+    shared::thread_pool pool( threads );
+    const std::string label = std::to_string(threads) + " threads";
+
+    suite.run( "spawn and sync empty tasks, " + label, "task",
+      "work-stealing", size,
+      [&]() {
+        shared::task_group group( pool );
+        for (std::size_t i = 0; i < size; ++i) { group.spawn( []() {} ); }
+        group.sync();
+      } );
+    suite.run( "fork/join fib(" + std::to_string(FIB_N) + "), " + label,
+      "task", "work-stealing", 242785,
+      [&]() { shared::do_not_optimize( FIB( pool, FIB_N ) ); } );
+    suite.run( "fork/join sum, " + label, "double", "work-stealing", size,
+      [&]() {
+        shared::do_not_optimize(
+          RECURSIVE_SUM( pool, input.data(), input.data() + size ) );
+      } );
+  }
+}
+
+int main( int argc, char* argv[] ) {
+  shared::bench_suite suite( argc, argv );
+  if (!suite) { return 2; }
+  const shared::bench_options& opts = suite.options();
+
+  for (std::size_t size : opts.sizes) {
+    suite.section( "parallel algorithms, " + std::to_string(size)
+      + " doubles, " + std::to_string( shared::thread_pool::default_threads() )
+      + " cores" );
+    SCALING_BENCHMARKS( suite, size );
+
+    suite.section( "work-stealing scheduler, " + std::to_string(size)
+      + " tasks or doubles" );
+    SCHEDULER_BENCHMARKS( suite, size );
+  }
+  return suite.finish();
+}
@@ -0,0 +1,79 @@
+/*
+  Sorting benchmark: std::sort, custom::heap_sort and custom::parallel_sort
+  (on the shared work-stealing pool) over std::vector and linarray with
+  both allocators, for every size and data distribution.
+  usage: bench_sort [--size 1K,1M] [--dist shuffled] ... (see --help)
+*/
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <bench_suite.hpp>
+
+#include "linarray.hpp"
+#include "abc_allocator.hpp"
+#include "heapsort.hpp"
+#include "parallel_algorithms.hpp"
+
+struct STD_SORT {
+  static const char* name() { return "std::sort"; }
+  template< class C > void operator() ( C& con ) const
+    { std::sort( con.begin(), con.end() ); }
+};
+struct HEAP_SORT {
+  static const char* name() { return "custom::heap_sort"; }
+  template< class C > void operator() ( C& con ) const
+    { custom::heap_sort( con.begin(), con.end() ); }
+};
+struct PARALLEL_SORT {
+  static const char* name() { return "custom::parallel_sort"; }
+  template< class C > void operator() ( C& con ) const
+    { custom::parallel_sort( con.begin(), con.end() ); }
+};
+
+// sorts a fresh copy of source in every sample
+template< class Sort, class C >
+static void SORT_BENCHMARK( shared::bench_suite& suite, const char* container,
+  const char* allocator, const std::string& dist, const C& source )
+{
+  const std::string name = std::string(container) + " " + Sort::name()
+    + ", " + dist;
+  C work;
+  suite.run( name, "int", allocator, source.size(),
+    [&]() { work = source; },
+    [&]() { Sort()( work ); shared::clobber_memory(); } );
+}
+
+template< class Sort >
+static void SORT_BENCHMARKS( shared::bench_suite& suite, const std::string& dist,
+  const std::vector<int>& vec, const linarray<int>& larr_std,
+  const linarray<int, abc_allocator<int>>& larr_abc )
+{
+  SORT_BENCHMARK<Sort>( suite, "std::vector", "std::allocator", dist, vec );
+  SORT_BENCHMARK<Sort>( suite, "linarray", "std::allocator", dist, larr_std );
+  SORT_BENCHMARK<Sort>( suite, "linarray", "abc_allocator", dist, larr_abc );
+}
+
+int main( int argc, char* argv[] ) {
+  shared::bench_suite suite( argc, argv );
+  if (!suite) { return 2; }
+  const shared::bench_options& opts = suite.options();
+
+  for (std::size_t size : opts.sizes) {
+    for (shared::data_distribution d : opts.distributions) {
+      const std::string dist = shared::distribution_name(d);
+      suite.section( "sorting " + std::to_string(size) + " " + dist + " ints" );
+
+      std::vector<int> vec( size );
+      shared::fill_data( vec, d, opts.seed );
+      const linarray<int> larr_std( vec.cbegin(), vec.cend() );
+      const linarray<int, abc_allocator<int>> larr_abc( vec.cbegin(), vec.cend() );
+
+      SORT_BENCHMARKS<STD_SORT>( suite, dist, vec, larr_std, larr_abc );
+      SORT_BENCHMARKS<HEAP_SORT>( suite, dist, vec, larr_std, larr_abc );
+      SORT_BENCHMARKS<PARALLEL_SORT>( suite, dist, vec, larr_std, larr_abc );
+    }
+  }
+  return suite.finish();
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <new>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+#include "linarray.hpp"
+#include "segmented_array.hpp"
+
+/*
+  Append-only array for many producer threads. push_back() and
+  emplace_back() take a slot with one atomic increment and construct the
+  element in place, without locks. The storage is split into segments as in
+  segmented_array, so growing never moves an element and references stay
+  valid while other threads append. The thread whose slot opens a new
+  segment allocates it, the others appending to that segment wait until it
+  is published. The thread that appended an element can read it back by its
+  index right away. Everyone else can read the elements once the producers
+  are done, e.g. joined. seal() then moves the elements into one contiguous
+  linarray, e.g. for sorting.
+  A slot is taken before its element exists: if allocating the segment or
+  constructing the element throws, the slot stays counted by size() but is
+  marked as not constructed, and clear() and seal() skip it. A failed
+  segment allocation makes the producers waiting for it throw bad_alloc
+  too, until clear(). reserve(), clear() and seal() are not thread-safe.
+*/
+template< class T, class Allocator = std::allocator<T> >
+class concurrent_array {
+  private:
+    typedef std::allocator_traits<Allocator>        alloc_traits;
+    typedef segmented_array<T, Allocator>           layout;
+    typedef typename alloc_traits::template
+      rebind_alloc<bool>                            flag_allocator;
+    typedef std::allocator_traits<flag_allocator>   flag_traits;
+
+  public:
+    typedef Allocator                               allocator_type;
+    typedef typename alloc_traits::value_type       value_type;
+    typedef value_type&                             reference;
+    typedef const value_type&                       const_reference;
+    typedef typename alloc_traits::size_type        size_type;
+    typedef typename alloc_traits::pointer          pointer;
+
+  private:
+    allocator_type allocator;
+    std::atomic<pointer> directory[layout::max_segments];
+    // per slot: the element is constructed, set by the slot's producer
+    bool* ready[layout::max_segments];
+    std::atomic<size_type> s_count;
+    std::atomic<bool> alloc_failed;
+
+  public:
+    explicit concurrent_array( const allocator_type& alloc = Allocator() )
+    : allocator(alloc), s_count(0), alloc_failed(false)
+    {
+      for (std::atomic<pointer>& seg : directory) { seg.store( nullptr ); }
+      std::fill_n( ready, layout::max_segments, nullptr );
+    }
+
+    ~concurrent_array() {
+      clear();
+      for (unsigned seg = 0; seg < layout::max_segments; ++seg) {
+        pointer p = directory[seg].load();
+        if ( p != nullptr ) {
+          alloc_traits::deallocate( allocator, p,
+            layout::segment_capacity(seg) );
+          flag_allocator flags( allocator );
+          flag_traits::deallocate( flags, ready[seg],
+            layout::segment_capacity(seg) );
+        }
+      }
+    }
+
+    inline allocator_type get_allocator() const { return allocator; }
+
+    /* data access */
+    inline const_reference operator[] ( size_type pos ) const {
+      const unsigned seg = layout::segment_of( pos );
+      return directory[seg].load( std::memory_order_acquire )
+        [ pos - layout::segment_start(seg) ];
+    }
+    inline reference operator[] ( size_type pos ) {
+      const unsigned seg = layout::segment_of( pos );
+      return directory[seg].load( std::memory_order_acquire )
+        [ pos - layout::segment_start(seg) ];
+    }
+
+    /* capacity */
+    // slots taken so far, the number of elements once producers are done
+    inline size_type size() const { return s_count.load(); }
+    inline bool empty() const { return size() == 0; }
+
+    // allocates the segments up front, so producers never wait for them
+    void reserve( size_type count ) {
+      for (unsigned seg = 0; count > layout::segment_start(seg); ++seg) {
+        if ( directory[seg].load() == nullptr ) { add_segment( seg ); }
+      }
+    }
+
+    /* management */
+    // the index of the new element
+    inline size_type push_back( const_reference value ) {
+      return emplace_back( value );
+    }
+
+    template< typename... Args >
+    size_type emplace_back( Args&&... args ) {
+      const size_type pos = s_count.fetch_add( 1, std::memory_order_relaxed );
+      const pointer p = slot( pos );
+      alloc_traits::construct( allocator, std::addressof( *p ),
+        std::forward<Args>(args)... );
+      const unsigned seg = layout::segment_of( pos );
+      ready[seg][pos - layout::segment_start(seg)] = true;
+      return pos;
+    }
+
+    // destroys the elements, keeps the segments for reuse
+    void clear() {
+      for_each_run( [this]( pointer first, pointer last ) {
+        for (; first != last; ++first) {
+          alloc_traits::destroy( allocator, std::addressof( *first ) );
+        }
+      } );
+      const size_type count = size();
+      for (unsigned seg = 0; count > layout::segment_start(seg); ++seg) {
+        if ( directory[seg].load() != nullptr ) {
+          std::fill_n( ready[seg], segment_count( seg, count ), false );
+        }
+      }
+      s_count.store(0);
+      alloc_failed.store( false );
+    }
+
+    // moves all constructed elements into a contiguous array, in slot
+    // order, and leaves this one empty
+    linarray<T, Allocator> seal() {
+      linarray<T, Allocator> sealed =
+        moved_elements( std::is_trivially_default_constructible<T>() );
+      clear();
+      return sealed;
+    }
+
+  private:
+    concurrent_array( const concurrent_array& );
+    concurrent_array& operator= ( const concurrent_array& );
+
+    inline static size_type segment_count( unsigned seg, size_type count ) {
+      return std::min( count - layout::segment_start(seg),
+        layout::segment_capacity(seg) );
+    }
+
+    // calls f( first, last ) for every run of constructed elements
+    template< class F >
+    void for_each_run( F f ) {
+      const size_type count = size();
+      for (unsigned seg = 0; count > layout::segment_start(seg); ++seg) {
+        const pointer first = directory[seg].load( std::memory_order_acquire );
+        if ( first == nullptr ) { continue; }     // its allocation failed
+        const bool* flags = ready[seg];
+        const size_type seg_count = segment_count( seg, count );
+        for (size_type i = 0; i < seg_count; ) {
+          size_type j = i;
+          while ( j < seg_count && flags[j] ) { ++j; }
+          if ( j > i ) { f( first + i, first + j ); }
+          for (i = j; i < seg_count && !flags[i]; ++i) {}
+        }
+      }
+    }
+
+    // trivial elements: one uninitialized block, then one bulk move
+    linarray<T, Allocator> moved_elements( std::true_type ) {
+      size_type constructed = 0;
+      for_each_run( [&constructed]( pointer first, pointer last ) {
+        constructed += last - first;
+      } );
+      linarray<T, Allocator> sealed( constructed, default_init, allocator );
+      pointer dest = sealed.begin();
+      for_each_run( [&dest]( pointer first, pointer last ) {
+        dest = std::move( first, last, dest );
+      } );
+      return sealed;
+    }
+
+    // others are move-constructed, run by run: T needs no default constructor
+    linarray<T, Allocator> moved_elements( std::false_type ) {
+      const std::move_iterator<pointer> none;
+      linarray<T, Allocator> sealed( none, none, allocator );
+      for_each_run( [&sealed]( pointer first, pointer last ) {
+        sealed.append( std::make_move_iterator( first ),
+          std::make_move_iterator( last ) );
+      } );
+      return sealed;
+    }
+
+    pointer slot( size_type pos ) {
+      const unsigned seg = layout::segment_of( pos );
+      pointer first = directory[seg].load( std::memory_order_acquire );
+      if ( first == nullptr ) {
+        first = ( pos == layout::segment_start(seg) )
+          ? add_segment( seg ) : wait_segment( seg );
+      }
+      return first + (pos - layout::segment_start(seg));
+    }
+
+    // by the only thread that got the first slot of the segment; the flags
+    // are published with the elements
+    pointer add_segment( unsigned seg ) {
+      const size_type capacity = layout::segment_capacity(seg);
+      flag_allocator flags( allocator );
+      pointer first;
+      try {
+        ready[seg] = flag_traits::allocate( flags, capacity );
+        try {
+          first = alloc_traits::allocate( allocator, capacity );
+        } catch (...) {
+          flag_traits::deallocate( flags, ready[seg], capacity );
+          throw;
+        }
+      } catch (...) {
+        ready[seg] = nullptr;
+        alloc_failed.store( true );
+        throw;
+      }
+      std::fill_n( ready[seg], capacity, false );
+      directory[seg].store( first, std::memory_order_release );
+      return first;
+    }
+
+    pointer wait_segment( unsigned seg ) {
+      pointer first;
+      while ( (first = directory[seg].load( std::memory_order_acquire ))
+              == nullptr )
+      {
+        if ( alloc_failed.load() ) { throw std::bad_alloc(); }
+        std::this_thread::yield();
+      }
+      return first;
+    }
+};
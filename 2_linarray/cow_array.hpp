@@ -0,0 +1,451 @@
+#pragma once
+
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <initializer_list>
+
+#include "linarray.hpp"
+
+/*
+  Array with copy-on-write storage, for consistent snapshots of large
+  tables: a copy is O(1) and shares the storage of the original. The
+  elements are kept in linarray chunks of up to ChunkBytes (64 KB by
+  default; a power of two elements, as linarray allocates) behind a table
+  of chunk pointers, and both the table and the chunks are reference
+  counted. The first mutation through a non-const accessor
+  (operator[], iterators, chunk_data(), back(), push_back(), ...) of an
+  array that shares its storage copies the table (one pointer per chunk),
+  and each chunk is copied when it is first written to, so a write after a
+  snapshot copies one chunk, not the array. Const access never copies:
+  read through const references, cbegin() and chunk_data() of a const
+  array on hot paths. As with std::shared_ptr, one object must not be
+  written and used by two threads at once, but copies that share storage
+  may be used from different threads: a writer takes snapshots, hands them
+  to readers, and keeps writing. Iterators are random access, but slower
+  than linarray's pointers; a chunk is contiguous.
+*/
+namespace {
+  // the largest power of two not above n, 1 for n == 0
+  constexpr std::size_t floor_power_of_two( std::size_t n, std::size_t p = 1 ) {
+    return (p > n / 2) ? p : floor_power_of_two( n, 2 * p );
+  }
+} //end of namespace
+
+template< class T, class Allocator = std::allocator<T>,
+  std::size_t ChunkBytes = 65536 >
+class cow_array {
+  private:
+    typedef std::allocator_traits<Allocator>        alloc_traits;
+
+  public:
+    typedef Allocator                               allocator_type;
+    typedef typename alloc_traits::value_type       value_type;
+    typedef value_type&                             reference;
+    typedef const value_type&                       const_reference;
+    typedef typename alloc_traits::size_type        size_type;
+    typedef typename alloc_traits::difference_type  difference_type;
+    typedef typename alloc_traits::pointer          pointer;
+    typedef typename alloc_traits::const_pointer    const_pointer;
+
+    static const size_type chunk_capacity =         // elements per chunk
+      floor_power_of_two( ChunkBytes / sizeof(T) );
+
+  private:
+    typedef linarray<T, Allocator> elements_type;
+
+    struct chunk {
+      std::atomic<size_type> refs;
+      elements_type elements;
+
+      // empty, with room for a whole chunk
+      explicit chunk( const allocator_type& alloc )
+      : refs(1), elements(0, alloc)
+      {
+        elements.reserve( chunk_capacity );
+      }
+      chunk( size_type count, const_reference value, const allocator_type& alloc )
+      : refs(1), elements(count, value, alloc) {}
+      template< typename ForwardIt >
+      chunk( ForwardIt first, ForwardIt last, const allocator_type& alloc )
+      : refs(1), elements(first, last, alloc) {}
+      chunk( const chunk& other )
+      : refs(1), elements(other.elements, other.elements.get_allocator()) {}
+    };
+
+    typedef typename alloc_traits::template
+      rebind_alloc<chunk*>                          table_allocator;
+
+    // every chunk is full but the last one
+    struct table {
+      std::atomic<size_type> refs;
+      linarray<chunk*, table_allocator> chunks;
+
+      explicit table( const allocator_type& alloc )
+      : refs(1), chunks(0, table_allocator(alloc)) {}
+      table( const table& other )
+      : refs(1), chunks(other.chunks, other.chunks.get_allocator())
+      {
+        for (chunk* c : chunks) { acquire( c ); }
+      }
+      ~table() {
+        for (chunk* c : chunks) { release( c ); }
+      }
+    };
+
+    template< bool Const >
+    class iterator_t {
+      friend class cow_array;
+      friend class iterator_t<!Const>;
+      typedef typename std::conditional< Const,
+        const cow_array*, cow_array* >::type container_ptr;
+
+      container_ptr con;
+      size_type pos;
+
+      iterator_t( container_ptr c, size_type p ) : con(c), pos(p) {}
+
+    public:
+      typedef std::random_access_iterator_tag iterator_category;
+      typedef typename cow_array::value_type value_type;
+      typedef typename cow_array::difference_type difference_type;
+      typedef typename std::conditional< Const,
+        cow_array::const_pointer, cow_array::pointer >::type pointer;
+      typedef typename std::conditional< Const,
+        const_reference, cow_array::reference >::type reference;
+
+      iterator_t() : con(nullptr), pos(0) {}
+      // iterator to const_iterator; a template, so the implicit copy
+      // constructor and assignment stay
+      template< bool C = Const, typename std::enable_if< C, int >::type = 0 >
+      iterator_t( const iterator_t<false>& other )
+      : con(other.con), pos(other.pos) {}
+
+      inline reference operator* () const { return (*con)[pos]; }
+      inline pointer operator-> () const { return std::addressof( **this ); }
+      inline reference operator[] ( difference_type n ) const {
+        return (*con)[pos + n];
+      }
+
+      inline iterator_t& operator++ () { ++pos; return *this; }
+      inline iterator_t operator++ (int) { iterator_t it(*this); ++pos; return it; }
+      inline iterator_t& operator-- () { --pos; return *this; }
+      inline iterator_t operator-- (int) { iterator_t it(*this); --pos; return it; }
+
+      inline iterator_t& operator+= ( difference_type n ) { pos += n; return *this; }
+      inline iterator_t& operator-= ( difference_type n ) { pos -= n; return *this; }
+      inline iterator_t operator+ ( difference_type n ) const {
+        return iterator_t( con, pos + n );
+      }
+      inline iterator_t operator- ( difference_type n ) const {
+        return iterator_t( con, pos - n );
+      }
+      friend inline iterator_t operator+ ( difference_type n, const iterator_t& it ) {
+        return it + n;
+      }
+      inline difference_type operator- ( const iterator_t& other ) const {
+        return static_cast<difference_type>(pos)
+          - static_cast<difference_type>(other.pos);
+      }
+
+      inline bool operator== ( const iterator_t& other ) const { return pos == other.pos; }
+      inline bool operator!= ( const iterator_t& other ) const { return pos != other.pos; }
+      inline bool operator< ( const iterator_t& other ) const { return pos < other.pos; }
+      inline bool operator> ( const iterator_t& other ) const { return pos > other.pos; }
+      inline bool operator<= ( const iterator_t& other ) const { return pos <= other.pos; }
+      inline bool operator>= ( const iterator_t& other ) const { return pos >= other.pos; }
+    };
+
+  public:
+    typedef iterator_t<false>                       iterator;
+    typedef iterator_t<true>                        const_iterator;
+    typedef std::reverse_iterator<iterator>         reverse_iterator;
+    typedef std::reverse_iterator<const_iterator>   const_reverse_iterator;
+
+  private:
+    allocator_type allocator;
+    table* s_table;
+    size_type s_count;
+
+  public:
+    explicit cow_array( size_type count = 0,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), s_table( new table(alloc) ), s_count(0)
+    {
+      fill_or_release( [&]() { resize( count ); } );
+    }
+
+    cow_array( size_type count, const_reference value,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), s_table( new table(alloc) ), s_count(0)
+    {
+      fill_or_release( [&]() { resize( count, value ); } );
+    }
+
+    //note: same magic as in linarray, against conflict with fill constructor
+    template< typename InputIt,
+      typename std::enable_if<
+        !std::is_integral<InputIt>::value
+      >::type* = nullptr >
+    cow_array( InputIt first, InputIt last,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), s_table( new table(alloc) ), s_count(0)
+    {
+      fill_or_release( [&]() { append( first, last ); } );
+    }
+
+    // shares the storage, O(1)
+    cow_array( const cow_array& other )
+    : allocator(other.allocator), s_table( acquire( other.s_table ) ),
+      s_count(other.s_count) {}
+
+    cow_array( std::initializer_list<value_type> init,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), s_table( new table(alloc) ), s_count(0)
+    {
+      fill_or_release( [&]() { append( init.begin(), init.end() ); } );
+    }
+
+    ~cow_array() {
+      release( s_table );
+    }
+
+    /* assignment operators */
+    cow_array& operator= ( const cow_array& other ) {
+      table* shared = acquire( other.s_table );
+      release( s_table );
+      allocator = other.allocator;
+      s_table = shared;
+      s_count = other.s_count;
+      return (*this);
+    }
+
+    cow_array& operator= ( std::initializer_list<value_type> init ) {
+      cow_array( init, allocator ).swap( *this );
+      return (*this);
+    }
+
+    inline allocator_type get_allocator() const { return allocator; }
+
+    // a copy to hand to readers, unchanged by later writes to this array
+    inline cow_array snapshot() const { return *this; }
+
+    /* iterators */
+    inline const_iterator cbegin() const { return const_iterator( this, 0 ); }
+    inline iterator begin() { return iterator( this, 0 ); }
+
+    inline const_iterator cend() const { return const_iterator( this, s_count ); }
+    inline iterator end() { return iterator( this, s_count ); }
+
+    inline const_reverse_iterator
+      crbegin() const { return const_reverse_iterator( cend() ); }
+    inline reverse_iterator
+      rbegin() { return reverse_iterator( end() ); }
+
+    inline const_reverse_iterator
+      crend() const { return const_reverse_iterator( cbegin() ); }
+    inline reverse_iterator
+      rend() { return reverse_iterator( begin() ); }
+
+    /* data access, the non-const one copies shared storage first */
+    inline const_reference operator[] ( size_type pos ) const {
+      return s_table->chunks[pos / chunk_capacity]->elements[pos % chunk_capacity];
+    }
+    inline reference operator[] ( size_type pos ) {
+      return own_chunk( pos / chunk_capacity ).elements[pos % chunk_capacity];
+    }
+
+    inline const_reference front() const { return (*this)[0]; }
+    inline reference front() { return (*this)[0]; }
+
+    inline const_reference back() const { return (*this)[s_count - 1]; }
+    inline reference back() { return (*this)[s_count - 1]; }
+
+    /* chunks */
+    inline size_type chunks() const { return s_table->chunks.size(); }
+    inline size_type chunk_size( size_type k ) const {
+      return s_table->chunks[k]->elements.size();
+    }
+    inline const_pointer chunk_data( size_type k ) const {
+      return s_table->chunks[k]->elements.data();
+    }
+    inline pointer chunk_data( size_type k ) { return own_chunk( k ).elements.data(); }
+
+    // whether a write into chunk k copies it first
+    inline bool is_shared( size_type k ) const {
+      return !unique( s_table ) || !unique( s_table->chunks[k] );
+    }
+
+    // the chunks still shared with copies of this array
+    size_type shared_chunks() const {
+      if ( !unique( s_table ) ) { return chunks(); }
+      size_type count = 0;
+      for (const chunk* c : s_table->chunks) { count += !unique( c ); }
+      return count;
+    }
+
+    /* capacity */
+    inline bool empty() const { return s_count == 0; }
+    inline size_type size() const { return s_count; }
+
+    /* management */
+    void swap( cow_array& other ) {
+      std::swap( allocator, other.allocator );
+      std::swap( s_table, other.s_table );
+      std::swap( s_count, other.s_count );
+    }
+
+    // drops this array's references, the copies keep their elements
+    inline void clear() { cow_array( 0, allocator ).swap( *this ); }
+
+    inline void resize( size_type count ) { resize( count, T() ); }
+
+    // only the last chunk and the chunks past it change
+    void resize( size_type count, const_reference value ) {
+      table& t = own_table();
+      const size_type new_chunks = (count + chunk_capacity - 1) / chunk_capacity;
+      for (; t.chunks.size() > new_chunks; t.chunks.pop_back()) {
+        release( t.chunks.back() );
+      }
+      s_count = 0;
+      if ( !t.chunks.empty() ) {
+        const size_type last = t.chunks.size() - 1;
+        const size_type last_size =
+          std::min( chunk_capacity, count - last * chunk_capacity );
+        if ( t.chunks[last]->elements.size() != last_size ) {
+          own_chunk( last ).elements.resize( last_size, value );
+        }
+        s_count = last * chunk_capacity + last_size;
+      }
+      while ( t.chunks.size() < new_chunks ) {
+        const size_type chunk_count = std::min( chunk_capacity, count - s_count );
+        add_chunk( new chunk( chunk_count, value, allocator ) );
+        s_count += chunk_count;
+      }
+    }
+
+    template< typename InputIt,
+      typename std::enable_if<
+        !std::is_integral<InputIt>::value
+      >::type* = nullptr >
+    inline void append( InputIt first, InputIt last ) {
+      append_range( first, last,
+        typename std::iterator_traits<InputIt>::iterator_category() );
+    }
+
+    inline void push_back( const_reference value ) { emplace_back( value ); }
+
+    template< typename... Args >
+    void emplace_back( Args&&... args ) {
+      if ( s_count % chunk_capacity == 0 ) {
+        std::unique_ptr<chunk> c( new chunk( allocator ) );
+        c->elements.emplace_back( std::forward<Args>(args)... );
+        add_chunk( c.release() );
+      }
+      else {
+        // a copied last chunk has only room for its elements
+        elements_type& last = own_chunk( chunks() - 1 ).elements;
+        last.reserve( chunk_capacity );
+        last.emplace_back( std::forward<Args>(args)... );
+      }
+      ++s_count;
+    }
+
+    void pop_back() {
+      chunk& c = own_chunk( chunks() - 1 );
+      c.elements.pop_back();
+      --s_count;
+      if ( c.elements.empty() ) {
+        release( &c );
+        s_table->chunks.pop_back();
+      }
+    }
+
+  private:
+    /* reference counting */
+    template< class Shared >
+    inline static Shared* acquire( Shared* p ) {
+      p->refs.fetch_add( 1, std::memory_order_relaxed );
+      return p;
+    }
+
+    // the last owner deletes, after the other owners are done with it
+    template< class Shared >
+    inline static void release( Shared* p ) {
+      if ( p->refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) { delete p; }
+    }
+
+    // for constructors: if the fill throws, the table and the chunks added
+    // so far are released, since no destructor will run
+    template< class Fill >
+    void fill_or_release( Fill fill ) {
+      try {
+        fill();
+      } catch (...) {
+        release( s_table );
+        throw;
+      }
+    }
+
+    // acquire: reads by former owners happen before our writes
+    template< class Shared >
+    inline static bool unique( const Shared* p ) {
+      return p->refs.load( std::memory_order_acquire ) == 1;
+    }
+
+    table& own_table() {
+      if ( !unique( s_table ) ) {
+        table* copy = new table( *s_table );
+        release( s_table );
+        s_table = copy;
+      }
+      return *s_table;
+    }
+
+    chunk& own_chunk( size_type k ) {
+      chunk*& c = own_table().chunks[k];
+      if ( !unique( c ) ) {
+        chunk* copy = new chunk( *c );
+        release( c );
+        c = copy;
+      }
+      return *c;
+    }
+
+    // takes over the new chunk, even when the table cannot grow
+    void add_chunk( chunk* c ) {
+      std::unique_ptr<chunk> owner( c );
+      own_table().chunks.push_back( c );
+      owner.release();
+    }
+
+    // the last chunk is filled up, then every full chunk is copied at once
+    template< typename ForwardIt >
+    void append_range( ForwardIt first, ForwardIt last,
+      std::forward_iterator_tag )
+    {
+      size_type remaining = std::distance( first, last );
+      for (; remaining > 0 && s_count % chunk_capacity != 0; --remaining) {
+        push_back( *first++ );
+      }
+      while ( remaining > 0 ) {
+        const size_type chunk_count = std::min( chunk_capacity, remaining );
+        const ForwardIt chunk_last = std::next( first, chunk_count );
+        add_chunk( new chunk( first, chunk_last, allocator ) );
+        s_count += chunk_count;
+        remaining -= chunk_count;
+        first = chunk_last;
+      }
+    }
+
+    template< typename InputIt >
+    void append_range( InputIt first, InputIt last, std::input_iterator_tag ) {
+      for (; first != last; ++first) { push_back( *first ); }
+    }
+};
+
+template< class T, class Allocator, std::size_t ChunkBytes >
+const typename cow_array<T, Allocator, ChunkBytes>::size_type
+  cow_array<T, Allocator, ChunkBytes>::chunk_capacity;
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <utility>
+#include <tuple>
+#include <stdexcept>
+#include <functional>
+#include <initializer_list>
+
+#include "flat_set.hpp"
+
+/*
+  Sorted map over one linarray of (key, value) pairs, see flat_set.hpp for
+  the lookup, bulk build and invalidation rules. The pairs are stored with
+  a non-const key, so they can be sorted and moved in place: values may be
+  changed through iterators, keys must not.
+*/
+struct flat_map_key_of {
+  template< class Pair >
+  inline const typename Pair::first_type& operator() ( const Pair& p ) const {
+    return p.first;
+  }
+};
+
+template< class Key, class T, class Compare = std::less<Key>,
+  class Allocator = std::allocator< std::pair<Key, T> > >
+class flat_map
+  : public flat_table< std::pair<Key, T>, Key, flat_map_key_of, Compare, Allocator >
+{
+  private:
+    typedef flat_table< std::pair<Key, T>, Key, flat_map_key_of, Compare,
+      Allocator > base;
+
+  public:
+    typedef T                                       mapped_type;
+    typedef typename base::value_type               value_type;
+    typedef typename base::size_type                size_type;
+    typedef typename base::mutable_iterator         iterator;
+    typedef typename base::const_iterator           const_iterator;
+
+    explicit flat_map( const Compare& c = Compare(),
+      const Allocator& alloc = Allocator() )
+    : base( c, alloc ) {}
+
+    template< typename InputIt >
+    flat_map( InputIt first, InputIt last, const Compare& c = Compare(),
+      const Allocator& alloc = Allocator() )
+    : base( c, alloc )
+    {
+      base::insert( first, last );
+    }
+
+    flat_map( std::initializer_list<value_type> init,
+      const Compare& c = Compare(), const Allocator& alloc = Allocator() )
+    : base( c, alloc )
+    {
+      base::insert( init.begin(), init.end() );
+    }
+
+    /* iterators, with mutable values */
+    using base::begin;
+    using base::end;
+    inline iterator begin() { return base::elements.begin(); }
+    inline iterator end() { return base::elements.end(); }
+
+    /* lookup */
+    using base::find;
+    inline iterator find( const Key& key ) {
+      return const_cast<iterator>( base::find( key ) );
+    }
+
+    template< class K, class C = Compare, class = typename C::is_transparent >
+    inline iterator find( const K& key ) {
+      return const_cast<iterator>( base::find_of( key ) );
+    }
+
+    // throws std::out_of_range for a missing key
+    const T& at( const Key& key ) const {
+      const const_iterator pos = base::find( key );
+      if ( pos == base::cend() ) { throw std::out_of_range( "flat_map::at" ); }
+      return pos->second;
+    }
+    inline T& at( const Key& key ) {
+      return const_cast<T&>( static_cast<const flat_map&>(*this).at( key ) );
+    }
+
+    // inserts T() for a missing key
+    T& operator[] ( const Key& key ) {
+      return try_emplace( key ).first->second;
+    }
+
+    /* management */
+    using base::insert;
+
+    inline std::pair<iterator, bool> insert( const value_type& value ) {
+      return try_emplace( value.first, value.second );
+    }
+
+    // constructs the value only if the key is missing
+    template< typename... Args >
+    std::pair<iterator, bool> try_emplace( const Key& key, Args&&... args ) {
+      const std::pair<iterator, bool> found = base::locate( key );
+      if ( found.second ) { return std::make_pair( found.first, false ); }
+      const iterator pos = base::elements.emplace( found.first,
+        std::piecewise_construct, std::forward_as_tuple( key ),
+        std::forward_as_tuple( std::forward<Args>(args)... ) );
+      return std::make_pair( pos, true );
+    }
+
+    template< typename M >
+    std::pair<iterator, bool> insert_or_assign( const Key& key, M&& value ) {
+      const std::pair<iterator, bool> result = try_emplace( key,
+        std::forward<M>(value) );
+      if ( !result.second ) { result.first->second = std::forward<M>(value); }
+      return result;
+    }
+};
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <functional>
+#include <initializer_list>
+
+#include "linarray.hpp"
+#include "heapsort.hpp"
+
+/*
+  Sorted containers over one linarray: lookups are binary searches over
+  contiguous elements, there is no allocation per element, and iteration
+  is a linear scan. A single insert or erase moves the elements after it,
+  so tables are best built in bulk: a range is appended, sorted once with
+  custom::heap_sort and deduplicated, and inserting a range into a
+  non-empty table merges the sorted batch in (std::inplace_merge). Among
+  equivalent keys the one already in the table wins; within one batch,
+  which of the equivalent keys is kept is unspecified (heap_sort is not
+  stable). Lookups also take other key types, e.g. a string literal for
+  std::string keys, when Compare declares is_transparent, as
+  transparent_less does. Iterators and references are invalidated by
+  every insert and erase.
+*/
+struct transparent_less {
+  typedef void is_transparent;
+
+  template< class A, class B >
+  inline bool operator() ( const A& a, const B& b ) const { return a < b; }
+};
+
+template< class Value, class Key, class KeyOf, class Compare, class Allocator >
+class flat_table {
+  protected:
+    typedef linarray<Value, Allocator>                  sequence_type;
+    typedef typename sequence_type::iterator            mutable_iterator;
+
+  public:
+    typedef Key                                         key_type;
+    typedef Value                                       value_type;
+    typedef Compare                                     key_compare;
+    typedef Allocator                                   allocator_type;
+    typedef typename sequence_type::size_type           size_type;
+    typedef typename sequence_type::difference_type     difference_type;
+    typedef typename sequence_type::const_reference     const_reference;
+    typedef typename sequence_type::const_iterator      const_iterator;
+    typedef std::reverse_iterator<const_iterator>       const_reverse_iterator;
+
+  protected:
+    sequence_type elements;
+    Compare comp;
+
+  public:
+    explicit flat_table( const Compare& c = Compare(),
+      const Allocator& alloc = Allocator() )
+    : elements(0, alloc), comp(c) {}
+
+    inline allocator_type get_allocator() const { return elements.get_allocator(); }
+    inline key_compare key_comp() const { return comp; }
+
+    // the sorted elements, e.g. for binary I/O or a search index
+    inline const sequence_type& sequence() const { return elements; }
+
+    /* iterators */
+    inline const_iterator cbegin() const { return elements.cbegin(); }
+    inline const_iterator begin() const { return cbegin(); }
+    inline const_iterator cend() const { return elements.cend(); }
+    inline const_iterator end() const { return cend(); }
+
+    inline const_reverse_iterator
+      crbegin() const { return const_reverse_iterator( cend() ); }
+    inline const_reverse_iterator
+      crend() const { return const_reverse_iterator( cbegin() ); }
+
+    /* capacity */
+    inline bool empty() const { return elements.empty(); }
+    inline size_type size() const { return elements.size(); }
+    inline size_type capacity() const { return elements.capacity(); }
+
+    inline void shrink_to_fit() { elements.shrink_to_fit(); }
+
+    /* lookup */
+    inline const_iterator lower_bound( const Key& key ) const {
+      return lower_bound_of( key );
+    }
+    inline const_iterator upper_bound( const Key& key ) const {
+      return upper_bound_of( key );
+    }
+    inline const_iterator find( const Key& key ) const { return find_of( key ); }
+    inline size_type count( const Key& key ) const { return find( key ) != cend(); }
+    inline bool contains( const Key& key ) const { return find( key ) != cend(); }
+    inline std::pair<const_iterator, const_iterator>
+      equal_range( const Key& key ) const
+    {
+      const const_iterator first = lower_bound_of( key );
+      return std::make_pair( first, matches( first, key ) ? first + 1 : first );
+    }
+
+    /* heterogeneous lookup, with a transparent Compare */
+    template< class K, class C = Compare, class = typename C::is_transparent >
+    inline const_iterator lower_bound( const K& key ) const {
+      return lower_bound_of( key );
+    }
+    template< class K, class C = Compare, class = typename C::is_transparent >
+    inline const_iterator upper_bound( const K& key ) const {
+      return upper_bound_of( key );
+    }
+    template< class K, class C = Compare, class = typename C::is_transparent >
+    inline const_iterator find( const K& key ) const { return find_of( key ); }
+    template< class K, class C = Compare, class = typename C::is_transparent >
+    inline size_type count( const K& key ) const {
+      return std::distance( lower_bound_of( key ), upper_bound_of( key ) );
+    }
+    template< class K, class C = Compare, class = typename C::is_transparent >
+    inline bool contains( const K& key ) const { return find_of( key ) != cend(); }
+
+    /* management */
+    void swap( flat_table& other ) {
+      elements.swap( other.elements );
+      std::swap( comp, other.comp );
+    }
+
+    inline void clear() { elements.clear(); }
+
+    // appends the batch, sorts and deduplicates it, merges it in
+    template< typename InputIt >
+    void insert( InputIt first, InputIt last ) {
+      const size_type old_size = size();
+      elements.append( first, last );
+      const mutable_iterator middle = elements.begin() + old_size;
+      custom::heap_sort( middle, elements.end(), value_less( comp ) );
+      if ( old_size != 0 ) {
+        std::inplace_merge( elements.begin(), middle, elements.end(),
+          value_less( comp ) );
+      }
+      elements.unique( value_equivalent( comp ) );
+    }
+
+    inline void insert( std::initializer_list<value_type> init ) {
+      insert( init.begin(), init.end() );
+    }
+
+    const_iterator erase( const_iterator pos ) { return elements.erase( pos ); }
+    const_iterator erase( const_iterator first, const_iterator last ) {
+      return elements.erase( first, last );
+    }
+    size_type erase( const Key& key ) {
+      const const_iterator pos = find( key );
+      if ( pos == cend() ) { return 0; }
+      elements.erase( pos );
+      return 1;
+    }
+
+    template< class Predicate >
+    inline size_type erase_if( Predicate pred ) { return elements.erase_if( pred ); }
+
+  protected:
+    struct value_less {
+      Compare comp;
+      explicit value_less( const Compare& c ) : comp(c) {}
+      inline bool operator() ( const Value& a, const Value& b ) const {
+        return comp( KeyOf()(a), KeyOf()(b) );
+      }
+    };
+
+    struct value_equivalent {
+      Compare comp;
+      explicit value_equivalent( const Compare& c ) : comp(c) {}
+      inline bool operator() ( const Value& a, const Value& b ) const {
+        return !comp( KeyOf()(a), KeyOf()(b) ) && !comp( KeyOf()(b), KeyOf()(a) );
+      }
+    };
+
+    template< class K >
+    const_iterator lower_bound_of( const K& key ) const {
+      return std::lower_bound( cbegin(), cend(), key,
+        [this]( const Value& v, const K& k ) { return comp( KeyOf()(v), k ); } );
+    }
+
+    template< class K >
+    const_iterator upper_bound_of( const K& key ) const {
+      return std::upper_bound( cbegin(), cend(), key,
+        [this]( const K& k, const Value& v ) { return comp( k, KeyOf()(v) ); } );
+    }
+
+    template< class K >
+    inline bool matches( const_iterator pos, const K& key ) const {
+      return pos != cend() && !comp( key, KeyOf()(*pos) );
+    }
+
+    template< class K >
+    inline const_iterator find_of( const K& key ) const {
+      const const_iterator pos = lower_bound_of( key );
+      return matches( pos, key ) ? pos : cend();
+    }
+
+    // lower bound of the key and whether it is there already
+    template< class K >
+    inline std::pair<mutable_iterator, bool> locate( const K& key ) {
+      const const_iterator pos = lower_bound_of( key );
+      return std::make_pair( const_cast<mutable_iterator>( pos ),
+        matches( pos, key ) );
+    }
+};
+
+/* ========================================================================== */
+
+struct flat_set_key_of {
+  template< class T >
+  inline const T& operator() ( const T& value ) const { return value; }
+};
+
+template< class Key, class Compare = std::less<Key>,
+  class Allocator = std::allocator<Key> >
+class flat_set
+  : public flat_table< Key, Key, flat_set_key_of, Compare, Allocator >
+{
+  private:
+    typedef flat_table< Key, Key, flat_set_key_of, Compare, Allocator > base;
+
+  public:
+    typedef typename base::const_iterator iterator;
+    typedef typename base::const_iterator const_iterator;
+    typedef typename base::size_type size_type;
+
+    explicit flat_set( const Compare& c = Compare(),
+      const Allocator& alloc = Allocator() )
+    : base( c, alloc ) {}
+
+    template< typename InputIt >
+    flat_set( InputIt first, InputIt last, const Compare& c = Compare(),
+      const Allocator& alloc = Allocator() )
+    : base( c, alloc )
+    {
+      base::insert( first, last );
+    }
+
+    flat_set( std::initializer_list<Key> init, const Compare& c = Compare(),
+      const Allocator& alloc = Allocator() )
+    : base( c, alloc )
+    {
+      base::insert( init.begin(), init.end() );
+    }
+
+    using base::insert;
+
+    std::pair<iterator, bool> insert( const Key& key ) {
+      const std::pair<typename base::mutable_iterator, bool> found =
+        base::locate( key );
+      if ( found.second ) { return std::make_pair( found.first, false ); }
+      return std::make_pair( base::elements.emplace( found.first, key ), true );
+    }
+
+    template< typename... Args >
+    inline std::pair<iterator, bool> emplace( Args&&... args ) {
+      return insert( Key( std::forward<Args>(args)... ) );
+    }
+};
+
+template< class Key, class Compare, class Allocator >
+bool operator== ( const flat_set<Key, Compare, Allocator>& a,
+  const flat_set<Key, Compare, Allocator>& b )
+{
+  return a.size() == b.size() && std::equal( a.cbegin(), a.cend(), b.cbegin() );
+}
+
+template< class Key, class Compare, class Allocator >
+bool operator!= ( const flat_set<Key, Compare, Allocator>& a,
+  const flat_set<Key, Compare, Allocator>& b )
+{
+  return !(a == b);
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <functional>
+#include <cstdint>
+
+#include "linarray.hpp"
+
+/*
+  Open-addressing hash set with linear probing over flat linarray storage.
+  The table size is a power of two and grows at 50% load; the slot index is
+  taken from the top bits of the hash multiplied by 2^64/phi (Fibonacci
+  hashing), so weak hashes like std::hash<int> still spread well. Stored
+  hashes live in a separate array, where 0 marks an empty slot, and probing
+  compares them before calling KeyEqual.
+  Key must be default constructible and copy assignable, as empty slots
+  hold Key(). There is no erase: the set is meant for deduplication and
+  grouping, see complex_grid_hash in complex_t.hpp for complex keys.
+*/
+template< class Key, class Hash = std::hash<Key>,
+  class KeyEqual = std::equal_to<Key>, class Allocator = std::allocator<Key> >
+class hash_set {
+  public:
+    typedef Key               value_type;
+    typedef Hash              hasher;
+    typedef KeyEqual          key_equal;
+    typedef Allocator         allocator_type;
+    typedef std::size_t       size_type;
+    typedef const value_type& const_reference;
+
+  private:
+    typedef typename std::allocator_traits<Allocator>::template
+      rebind_alloc<size_type>                   hash_allocator;
+    typedef linarray<Key, Allocator>            key_table;
+    typedef linarray<size_type, hash_allocator> hash_table;
+
+    key_table keys;
+    hash_table hashes;
+    size_type s_count;
+    unsigned index_shift;  // 64 - log2(bucket_count)
+    Hash hash;
+    KeyEqual equal;
+
+  public:
+    class const_iterator {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef const Key                 value_type;
+        typedef std::ptrdiff_t            difference_type;
+        typedef const Key*                pointer;
+        typedef const Key&                reference;
+
+      private:
+        const hash_set* set;
+        size_type index;
+
+      public:
+        const_iterator( const hash_set* s = nullptr, size_type i = 0 )
+        : set(s), index(i) { skip_empty(); }
+
+        inline const_reference operator* () const { return set->keys[index]; }
+        inline const Key* operator-> () const { return &set->keys[index]; }
+
+        inline const_iterator& operator++ () {
+          ++index;
+          skip_empty();
+          return (*this);
+        }
+        inline const_iterator operator++ (int) {
+          const_iterator old(*this);
+          ++(*this);
+          return old;
+        }
+
+        inline bool operator== ( const const_iterator& other ) const {
+          return index == other.index;
+        }
+        inline bool operator!= ( const const_iterator& other ) const {
+          return index != other.index;
+        }
+
+      private:
+        inline void skip_empty() {
+          if (set == nullptr) { return; }
+          while ( index < set->bucket_count() && set->hashes[index] == 0 )
+            ++index;
+        }
+    };
+    typedef const_iterator iterator;
+
+    explicit hash_set( size_type count = 0, const Hash& h = Hash(),
+      const KeyEqual& eq = KeyEqual(), const Allocator& alloc = Allocator() )
+    : keys(0, alloc), hashes(0, hash_allocator(alloc)),
+      s_count(0), index_shift(64), hash(h), equal(eq)
+    {
+      rehash( table_size_for( count ) );
+    }
+
+    template< typename InputIt >
+    hash_set( InputIt first, InputIt last, size_type count = 0,
+      const Hash& h = Hash(), const KeyEqual& eq = KeyEqual(),
+      const Allocator& alloc = Allocator() )
+    : hash_set( count, h, eq, alloc )
+    {
+      insert( first, last );
+    }
+
+    /* iterators */
+    inline const_iterator cbegin() const { return const_iterator( this, 0 ); }
+    inline const_iterator begin() const { return cbegin(); }
+    inline const_iterator cend() const {
+      return const_iterator( this, bucket_count() );
+    }
+    inline const_iterator end() const { return cend(); }
+
+    /* capacity */
+    inline bool empty() const { return s_count == 0; }
+    inline size_type size() const { return s_count; }
+    inline size_type bucket_count() const { return hashes.size(); }
+
+    void reserve( size_type count ) {
+      const size_type table_size = table_size_for( count );
+      if ( table_size > bucket_count() ) { rehash( table_size ); }
+    }
+
+    /* lookup */
+    const_iterator find( const Key& key ) const {
+      const size_type index = find_slot( key, stored_hash(key) );
+      return (hashes[index] != 0) ? const_iterator( this, index ) : cend();
+    }
+
+    inline size_type count( const Key& key ) const {
+      return hashes[ find_slot( key, stored_hash(key) ) ] != 0;
+    }
+
+    /* management */
+    std::pair<const_iterator, bool> insert( const Key& key ) {
+      if ( 2 * (s_count + 1) > bucket_count() ) {
+        rehash( 2 * bucket_count() );
+      }
+      const size_type h = stored_hash(key);
+      const size_type index = find_slot( key, h );
+      if ( hashes[index] != 0 ) {
+        return std::make_pair( const_iterator( this, index ), false );
+      }
+      keys[index] = key;
+      hashes[index] = h;
+      ++s_count;
+      return std::make_pair( const_iterator( this, index ), true );
+    }
+
+    template< typename InputIt >
+    void insert( InputIt first, InputIt last ) {
+      while (first != last) { insert( *first++ ); }
+    }
+
+    void clear() {
+      std::fill( hashes.begin(), hashes.end(), 0 );
+      s_count = 0;
+    }
+
+  private:
+    static size_type table_size_for( size_type count ) {
+      size_type table_size = 16;
+      while ( table_size < 2 * count ) { table_size *= 2; }
+      return table_size;
+    }
+
+    inline size_type stored_hash( const Key& key ) const {
+      const size_type h = hash(key);
+      return (h != 0) ? h : 1;
+    }
+
+    inline size_type index_of( size_type h ) const {
+      return index_of( h, index_shift );
+    }
+
+    inline static size_type index_of( size_type h, unsigned shift ) {
+      return static_cast<size_type>(
+        (static_cast<std::uint64_t>(h) * 0x9E3779B97F4A7C15ULL) >> shift
+      );
+    }
+
+    // slot holding the key, or the empty slot where it belongs
+    size_type find_slot( const Key& key, size_type h ) const {
+      const size_type mask = bucket_count() - 1;
+      size_type index = index_of(h);
+      while ( hashes[index] != 0 &&
+              !(hashes[index] == h && equal( keys[index], key )) )
+      {
+        index = (index + 1) & mask;
+      }
+      return index;
+    }
+
+    // stored hashes are reused, so Hash isn't called again; a Key copy
+    // that throws leaves the set as it was
+    void rehash( size_type table_size ) {
+      key_table new_keys( table_size, keys.get_allocator() );
+      hash_table new_hashes( table_size, 0, hashes.get_allocator() );
+      unsigned new_shift = 64;
+      for (size_type s = table_size; s > 1; s /= 2) { --new_shift; }
+
+      const size_type mask = table_size - 1;
+      for (size_type i = 0; i < bucket_count(); ++i) {
+        if ( hashes[i] == 0 ) { continue; }
+        size_type index = index_of( hashes[i], new_shift );
+        while ( new_hashes[index] != 0 ) { index = (index + 1) & mask; }
+        new_keys[index] = keys[i];
+        new_hashes[index] = hashes[i];
+      }
+      keys.swap( new_keys );
+      hashes.swap( new_hashes );
+      index_shift = new_shift;
+    }
+};
@@ -1,10 +1,26 @@
 #pragma once
 
+#include <iterator>
+#include <functional>
+
+// scope tracing of the hot paths (shared/trace.hpp): compiled in only with
+// LINARRAY_TRACE and SHARED_TRACE defined, and shared/ on the include path
+#if !defined(LINARRAY_TRACE_SCOPE)
+  #if defined(LINARRAY_TRACE)
+    #include <trace.hpp>
+    #define LINARRAY_TRACE_SCOPE(name) TRACE_SCOPE(name)
+  #else
+    #define LINARRAY_TRACE_SCOPE(name) ((void)0)
+  #endif
+#endif
+
 namespace {
   typedef size_t size_type;
 
-  template< class RandomIt >
-  void sift_down( RandomIt heap_first, RandomIt heap_last, size_type index ) {
+  template< class RandomIt, class Compare >
+  void sift_down( RandomIt heap_first, RandomIt heap_last, size_type index,
+    Compare comp )
+  {
     RandomIt root( heap_first + index );
     while ( std::distance(root, heap_last) > 0 ) {
       const size_type left_index = 2 * index + 1;
@@ -13,9 +29,9 @@ namespace {
       const RandomIt right_child( heap_first + right_index );
 
       RandomIt max_child = root;
-      if (left_child < heap_last) if (*left_child > *max_child)
+      if (left_child < heap_last) if (comp( *max_child, *left_child ))
         max_child = left_child;
-      if (right_child < heap_last) if (*right_child > *max_child)
+      if (right_child < heap_last) if (comp( *max_child, *right_child ))
         max_child = right_child;
 
       if (max_child == root)
@@ -30,22 +46,32 @@ namespace {
 
 namespace custom {
 
-  template< class RandomIt >
-  void heap_sort( RandomIt first, RandomIt last ) {
+  template< class RandomIt, class Compare >
+  void heap_sort( RandomIt first, RandomIt last, Compare comp ) {
     // TODO: Exception if first > last ?
     size_type s_sort = std::distance( first, last );
 
     //building heap
-    for( size_type i = s_sort/2; i > 0; --i ) {
-      sift_down( first, last, i-1 );
+    {
+      LINARRAY_TRACE_SCOPE( "heap_sort::build" );
+      for( size_type i = s_sort/2; i > 0; --i ) {
+        sift_down( first, last, i-1, comp );
+      }
     }
 
     //sorting
+    LINARRAY_TRACE_SCOPE( "heap_sort::extract" );
     while ( s_sort > 1 ) {
       std::swap( *first, *--last );
-      sift_down( first, last, 0 );
+      sift_down( first, last, 0, comp );
       --s_sort;
     }
   }
 
+  template< class RandomIt >
+  void heap_sort( RandomIt first, RandomIt last ) {
+    heap_sort( first, last,
+      std::less< typename std::iterator_traits<RandomIt>::value_type >() );
+  }
+
 } //end of namespace "custom"
@@ -4,6 +4,23 @@
 #include <iterator>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <initializer_list>
+#include <functional>
+#include <vector>
+#include <new>
+
+// scope tracing of the hot paths (shared/trace.hpp): compiled in only with
+// LINARRAY_TRACE and SHARED_TRACE defined, and shared/ on the include path
+#if !defined(LINARRAY_TRACE_SCOPE)
+  #if defined(LINARRAY_TRACE)
+    #include <trace.hpp>
+    #define LINARRAY_TRACE_SCOPE(name) TRACE_SCOPE(name)
+  #else
+    #define LINARRAY_TRACE_SCOPE(name) ((void)0)
+  #endif
+#endif
 
 // TODO: Specify noexcept where needed.
 
@@ -25,20 +42,35 @@
     typedef std::reverse_iterator<const_iterator>   const_reverse_iterator
 
 namespace {
+  // Allocator::alignment in bytes, for allocators that declare one, else 0
+  template< class A, class = void >
+  struct allocation_alignment : std::integral_constant< std::size_t, 0 > {};
+
+  template< class A >
+  struct allocation_alignment< A,
+    typename std::enable_if< (A::alignment > 0) >::type >
+  : std::integral_constant< std::size_t, A::alignment > {};
+
   template< class Allocator >
   class storage_t { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
     private:
       struct { pointer start, end; } data;
-      allocator_type& allocator;
+      allocator_type allocator;
 
     public:
+      // powers of two, padded to whole alignment units for over-aligned
+      // allocators (which pad their blocks the same way)
       inline static size_type calc_capacity( size_type count ) {
-        return static_cast<size_type>(
+        const size_type capacity = static_cast<size_type>(
             std::pow( 2.0, std::ceil( std::log2( (count>0) ?count :1 ) ) )
         );
+        const size_type unit = allocation_alignment<Allocator>::value;
+        if ( unit == 0 ) { return capacity; }
+        const size_type bytes = capacity * sizeof(value_type);
+        return (bytes + unit - 1) / unit * unit / sizeof(value_type);
       }
 
-      explicit storage_t( size_type count, allocator_type& alloc )
+      explicit storage_t( size_type count, const allocator_type& alloc )
       : allocator(alloc)
       {
         const size_type mem_capacity = calc_capacity( count );
@@ -59,6 +91,10 @@ namespace {
 
 /* ========================================================================== */
 
+// constructor tag: elements are default-initialized instead of T()
+struct default_init_t {};
+const default_init_t default_init = default_init_t();
+
 template< class T, class Allocator = std::allocator<T> >
 class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
   private:
@@ -73,8 +109,11 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
     : allocator(alloc)
     {
       set_storage( count );
-      if (count > 0)
-        construct_in_range( s_data->begin(), s_data->end(), T() );
+      if (count > 0) {
+        fill_or_release( [&]() {
+          construct_in_range( cbegin(), cend(), T() );
+        } );
+      }
     }
 
     linarray( size_type count, const_reference value,
@@ -82,7 +121,20 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
     : allocator(alloc)
     {
       set_storage( count );
-      construct_in_range( s_data->begin(), s_data->end(), value );
+      fill_or_release( [&]() {
+        construct_in_range( cbegin(), cend(), value );
+      } );
+    }
+
+    // elements are default-initialized: left as they are for trivial T
+    linarray( size_type count, default_init_t,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc)
+    {
+      set_storage( count );
+      fill_or_release( [&]() {
+        default_construct_in_range( cbegin(), cend() );
+      } );
     }
 
     //note: next magic fixes conflict with fill constructor
@@ -116,18 +168,19 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
     }
 
     /* assignment operators */
+    // a copy that throws leaves the array as it was
     linarray& operator= ( const linarray& other ) {
-      free_storage();
-      set_storage_from( other.cbegin(), other.cend() );
+      if ( this != &other ) { linarray( other, allocator ).swap( *this ); }
       return (*this);
     }
 
     linarray& operator= ( std::initializer_list<value_type> init ) {
-      free_storage();
-      set_storage_from( init.begin(), init.end() );
+      linarray( init, allocator ).swap( *this );
       return (*this);
     }
 
+    inline allocator_type get_allocator() const { return allocator; }
+
     /* iterators */
     inline const_iterator cbegin() const { return s_data->begin(); }
     inline iterator begin() { return const_cast<iterator>( cbegin() ); }
@@ -147,14 +200,14 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
 
     /* data access */
     inline const_reference
-      operator[] ( size_type pos ) const { return *(begin() + pos); }
+      operator[] ( size_type pos ) const { return *(cbegin() + pos); }
     inline reference
       operator[] ( size_type pos ) { return *(begin() + pos); }
 
-    inline const_reference front() const { return *begin(); }
+    inline const_reference front() const { return *cbegin(); }
     inline reference front() { return *begin(); }
 
-    inline const_reference back() const { return *(end() - 1); }
+    inline const_reference back() const { return *(cend() - 1); }
     inline reference back() { return *(end() - 1); }
 
     inline const_pointer data() const { return s_data->buffer(); }
@@ -165,6 +218,15 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
     inline size_type size() const { return s_count; }
     inline size_type capacity() const { return s_data->capacity(); }
 
+    // room for count elements, so that growing up to it never reallocates
+    void reserve( size_type count ) {
+      if ( count <= capacity() ) { return; }
+      storage* new_storage = new storage( count, allocator );
+      copy_from_range( cbegin(), cend(), new_storage->begin() );
+      free_storage();
+      s_data = new_storage;
+    }
+
     void shrink_to_fit() {
       if ( capacity() < storage::calc_capacity( size() ) ) { return; }
       storage* new_storage = new storage( size(), allocator );
@@ -174,6 +236,13 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
     }
 
     /* management */
+    // storages keep their own copy of the allocator, so no element moves
+    void swap( linarray& other ) {
+      std::swap( allocator, other.allocator );
+      std::swap( s_data, other.s_data );
+      std::swap( s_count, other.s_count );
+    }
+
     void clear() {
       /* this changes capacity, don't use */
       // free_storage();
@@ -205,6 +274,30 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
       }
     }
 
+    // new elements are default-initialized: left as they are for trivial T
+    void resize_default_init( size_type count ) {
+      if ( count > size() ) {
+        const size_type add_count = count - size();
+        const_iterator first_new = insert_empty_space( cend(), add_count );
+        default_construct_in_range( first_new, cend() );
+      }
+      else if ( count < size() ) {
+        resize( count );
+      }
+    }
+
+    /*
+      Grows to count elements without initializing them (as
+      resize_default_init), then lets op write them in place:
+        size_type op( pointer data, size_type count )
+      returns the number of elements to keep, at most count.
+    */
+    template< class Operation >
+    void resize_and_overwrite( size_type count, Operation op ) {
+      resize_default_init( count );
+      resize( op( data(), count ) );
+    }
+
     iterator insert( size_type count, const_reference value,
       const_iterator pos )
     {
@@ -214,13 +307,42 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
       return new_pos;
     }
 
-    template< typename InputIt >
+    //note: same magic as in the range constructor, for integral value_type
+    template< typename InputIt,
+      typename std::enable_if<
+        !std::is_integral<InputIt>::value
+      >::type* = nullptr >
     iterator insert( InputIt first, InputIt last, const_iterator pos ) {
       if ( first == last ) { return const_cast<iterator>(pos); }
-      const size_type insert_count = std::distance( first, last );
-      iterator new_pos = insert_empty_space( pos, insert_count );
-      copy_from_range( first, last, new_pos );
-      return new_pos;
+      return insert_range( first, last, pos,
+        typename std::iterator_traits<InputIt>::iterator_category() );
+    }
+
+    template< typename InputIt,
+      typename std::enable_if<
+        !std::is_integral<InputIt>::value
+      >::type* = nullptr >
+    inline void append( InputIt first, InputIt last ) {
+      insert( first, last, cend() );
+    }
+
+    /* replace the contents, keeping the capacity */
+    template< typename InputIt,
+      typename std::enable_if<
+        !std::is_integral<InputIt>::value
+      >::type* = nullptr >
+    void assign( InputIt first, InputIt last ) {
+      clear();
+      append( first, last );
+    }
+
+    void assign( size_type count, const_reference value ) {
+      clear();
+      resize( count, value );
+    }
+
+    inline void assign( std::initializer_list<value_type> init ) {
+      assign( init.begin(), init.end() );
     }
 
     template< typename... Args >
@@ -245,6 +367,40 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
       return vfirst;
     }
 
+    /* compaction: one pass, the removed suffix is destroyed once */
+
+    // removes the elements for which pred is true, returns how many
+    template< class Predicate >
+    size_type erase_if( Predicate pred ) {
+      return truncate( compact_if( pred,
+        std::is_trivially_copyable<value_type>() ) );
+    }
+
+    // removes the elements at the given positions, sorted ascending
+    template< typename InputIt >
+    size_type erase_indices( InputIt first, InputIt last ) {
+      if ( first == last ) { return 0; }
+      size_type read = *first;
+      iterator dest = begin() + read;
+      for (; first != last; ++first) {
+        const size_type index = *first;
+        if ( index < read ) { continue; } // repeated position
+        dest = std::move( begin() + read, begin() + index, dest );
+        read = index + 1;
+      }
+      return truncate( std::move( begin() + read, end(), dest ) );
+    }
+
+    // removes all but the first of consecutive equal elements
+    template< class BinaryPredicate >
+    size_type unique( BinaryPredicate equal ) {
+      if ( empty() ) { return 0; }
+      return truncate( compact_unique( equal,
+        std::is_trivially_copyable<value_type>() ) );
+    }
+
+    inline size_type unique() { return unique( std::equal_to<value_type>() ); }
+
     /* common management */
     inline void push_back( const_reference value ) {
       insert( 1, value, cend() );
@@ -274,23 +430,109 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
     template< typename InputIt >
     void set_storage_from( InputIt first, InputIt last ) {
       set_storage( std::distance( first, last ) );
-      copy_from_range( first, last, s_data->begin() );
+      fill_or_release( [&]() {
+        copy_from_range( first, last, s_data->begin() );
+      } );
+    }
+
+    // for constructors: the range helpers destroy the elements they built
+    // when one throws, the storage is released here, since no destructor
+    // will run
+    template< class Fill >
+    void fill_or_release( Fill fill ) {
+      try {
+        fill();
+      } catch (...) {
+        delete s_data;
+        throw;
+      }
+    }
+
+    // the count is known up front: one capacity check, one bulk copy
+    template< typename ForwardIt >
+    iterator insert_range( ForwardIt first, ForwardIt last,
+      const_iterator pos, std::forward_iterator_tag )
+    {
+      const size_type insert_count = std::distance( first, last );
+      iterator new_pos = insert_empty_space( pos, insert_count );
+      copy_from_range( first, last, new_pos );
+      return new_pos;
+    }
+
+    // single pass input: appended with geometric growth, then rotated
+    template< typename InputIt >
+    iterator insert_range( InputIt first, InputIt last,
+      const_iterator pos, std::input_iterator_tag )
+    {
+      const size_type offset = pos - cbegin();
+      const size_type old_size = size();
+      for (; first != last; ++first) { emplace_back( *first ); }
+      std::rotate( begin() + offset, begin() + old_size, end() );
+      return begin() + offset;
+    }
+
+    // the elements from new_end on are destroyed, returns how many
+    size_type truncate( iterator new_end ) {
+      const size_type erase_count = end() - new_end;
+      destroy_in_range( new_end, cend() );
+      s_count -= erase_count;
+      return erase_count;
+    }
+
+    template< class Predicate >
+    iterator compact_if( Predicate pred, std::false_type ) {
+      return std::remove_if( begin(), end(), pred );
+    }
+
+    // branchless for trivially copyable elements: every element is written,
+    // the output only advances past the kept ones
+    template< class Predicate >
+    iterator compact_if( Predicate pred, std::true_type ) {
+      iterator dest = begin();
+      for (const_iterator it = cbegin(); it != cend(); ++it) {
+        const value_type value = *it;
+        *dest = value;
+        dest += !pred( value );
+      }
+      return dest;
+    }
+
+    template< class BinaryPredicate >
+    iterator compact_unique( BinaryPredicate equal, std::false_type ) {
+      return std::unique( begin(), end(), equal );
+    }
+
+    template< class BinaryPredicate >
+    iterator compact_unique( BinaryPredicate equal, std::true_type ) {
+      iterator dest = begin() + 1;
+      for (const_iterator it = cbegin() + 1; it != cend(); ++it) {
+        const value_type value = *it;
+        *dest = value;
+        dest += !equal( *(dest - 1), value );
+      }
+      return dest;
     }
 
     iterator insert_empty_space( const_iterator pos, size_type count )
     {
+      LINARRAY_TRACE_SCOPE( "linarray::insert_empty_space" );
       iterator new_pos;
 
       if ( size() + count <= capacity() ) {
-        //const size_type ucopy_count = std::min( count, std::distance(pos, end()) );
         new_pos = const_cast<iterator>(pos);
-        iterator ucopy_from = std::max( new_pos, end()-count );
-        iterator ucopy_dest = std::max( new_pos+count, end() );
-        copy_from_range( ucopy_from, end(), ucopy_dest );
-        std::move_backward( new_pos, ucopy_from, ucopy_dest );
-        destroy_in_range( pos, pos+count );
+        // the last ucopy_count elements move to uninitialized memory
+        const size_type tail_count = cend() - pos;
+        const size_type ucopy_count = std::min( count, tail_count );
+        iterator ucopy_from = end() - ucopy_count;
+        copy_from_range( ucopy_from, end(), end() + (count - ucopy_count) );
+        if ( tail_count > count ) {
+          std::move_backward( new_pos, ucopy_from, end() );
+        }
+        // only old elements are destroyed, the rest was never constructed
+        destroy_in_range( pos, pos + ucopy_count );
       }
       else { //if we have no enough space at the end of the storage
+        LINARRAY_TRACE_SCOPE( "linarray::reallocate" );
         storage* new_storage = new storage( size() + count, allocator );
         new_pos = copy_from_range( cbegin(), pos, new_storage->begin() );
         copy_from_range( pos, cend(), new_pos + count );
@@ -312,7 +554,71 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
       try {
         while (current_pos != last) {
           alloc_traits::construct( allocator,
-            std::addressof(*current_pos++), value );
+            std::addressof(*current_pos), value );
+          ++current_pos;
+        }
+      } catch (...) {
+        destroy_in_range( first, current_pos );
+        throw;
+      }
+    }
+
+    // contiguous sources of trivially copyable elements, copied by memcpy:
+    // pointers (linarray iterators with any allocator of plain pointers)
+    // and std::vector<T> iterators, also as move iterators. Other
+    // contiguous iterators, e.g. of a vector with another allocator, are
+    // copied element by element.
+    template< typename It >
+    struct is_contiguous : std::integral_constant< bool,
+      std::is_same< It, pointer >::value ||
+      std::is_same< It, const_pointer >::value ||
+      std::is_same< It, value_type* >::value ||
+      std::is_same< It, const value_type* >::value || (
+        !std::is_same< value_type, bool >::value && (
+          std::is_same< It,
+            typename std::vector<value_type>::iterator >::value ||
+          std::is_same< It,
+            typename std::vector<value_type>::const_iterator >::value ) )
+    > {};
+
+    template< typename It >
+    struct is_contiguous< std::move_iterator<It> > : is_contiguous<It> {};
+
+    template< typename It >
+    struct is_bitwise_source : std::integral_constant< bool,
+      std::is_trivially_copyable<value_type>::value && is_contiguous<It>::value
+    > {};
+
+    // of a dereferenceable iterator
+    template< typename It >
+    inline static const value_type* raw_pointer( It it ) {
+      return std::addressof( *it );
+    }
+    template< typename It >
+    inline static const value_type* raw_pointer( std::move_iterator<It> it ) {
+      return raw_pointer( it.base() );
+    }
+
+    // similar to std::uninitialized_default_construct(): the allocator can
+    // only value-initialize, so placement new is used, a no-op for trivial T
+    void default_construct_in_range( const_iterator first, const_iterator last )
+    {
+      default_construct_in_range( first, last,
+        std::is_trivially_default_constructible<value_type>() );
+    }
+
+    void default_construct_in_range( const_iterator, const_iterator,
+      std::true_type ) {}
+
+    void default_construct_in_range(
+      const_iterator first, const_iterator last, std::false_type )
+    {
+      const_iterator current_pos = first;
+      try {
+        while (current_pos != last) {
+          ::new ( static_cast<void*>(
+            const_cast<iterator>(current_pos) ) ) value_type;
+          ++current_pos;
         }
       } catch (...) {
         destroy_in_range( first, current_pos );
@@ -322,14 +628,37 @@ class linarray { __LINARRAY_HPP_TYPEDEF_MIXIN( Allocator );
 
     // similar to std::uninitialized_copy(), but uses Allocator
     template< typename InputIt >
-    iterator copy_from_range(
+    inline iterator copy_from_range(
       InputIt first, InputIt last, const_iterator d_first )
+    {
+      LINARRAY_TRACE_SCOPE( "linarray::copy_from_range" );
+      return copy_from_range( first, last, d_first,
+        is_bitwise_source<InputIt>() );
+    }
+
+    template< typename InputIt >
+    iterator copy_from_range( InputIt first, InputIt last,
+      const_iterator d_first, std::true_type )
+    {
+      const size_type count = std::distance( first, last );
+      if ( count > 0 ) {
+        std::memcpy( static_cast<void*>( const_cast<iterator>(d_first) ),
+          raw_pointer(first), count * sizeof(value_type) );
+      }
+      return const_cast<iterator>(d_first) + count;
+    }
+
+    template< typename InputIt >
+    iterator copy_from_range( InputIt first, InputIt last,
+      const_iterator d_first, std::false_type )
     {
       const_iterator current_dest = d_first;
       try {
         while (first != last) {
           alloc_traits::construct( allocator,
-            std::addressof(*current_dest++), *first++ );
+            std::addressof(*current_dest), *first );
+          ++current_dest;
+          ++first;
         }
         return const_cast<iterator>(current_dest);
       } catch (...) {
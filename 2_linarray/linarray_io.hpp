@@ -0,0 +1,422 @@
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+#include <system_error>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <memory>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "linarray.hpp"
+
+/*
+  Binary files and streams of linarray<T> for trivially copyable T
+  (POSIX file descriptors, or std streams). A 64-byte header with the
+  format version, sizeof(T), the writer's byte order, the element count
+  and a checksum of the element bytes is followed by the raw elements, so
+  saving and loading move the whole array with one writev()/read()
+  (looped only when the kernel returns short counts). chunk_reader streams
+  arrays larger than memory in pieces, and the file functions can bypass
+  the page cache with O_DIRECT through an aligned bounce buffer, where the
+  system has it. Errors of the system calls are thrown as
+  std::system_error, bad files as std::runtime_error.
+*/
+namespace linarray_io {
+
+  typedef std::size_t size_type;
+
+  static const std::uint32_t format_version = 1;
+  static const std::uint32_t byte_order_mark = 0x01020304;
+  static const size_type direct_block = 4096;       // O_DIRECT alignment
+  static const size_type direct_buffer = 1 << 20;   // bytes per O_DIRECT call
+
+  struct file_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t element_size;
+    std::uint32_t byte_order;
+    std::uint32_t reserved;
+    std::uint64_t count;
+    std::uint64_t checksum;
+    unsigned char padding[24];
+
+    file_header() { std::memset( this, 0, sizeof(*this) ); }
+
+    template< class T >
+    static file_header describe( size_type count, std::uint64_t checksum ) {
+      file_header h;
+      std::memcpy( h.magic, "LINARBIN", sizeof(h.magic) );
+      h.version = format_version;
+      h.element_size = sizeof(T);
+      h.byte_order = byte_order_mark;
+      h.count = count;
+      h.checksum = checksum;
+      return h;
+    }
+
+    template< class T >
+    void check() const {
+      if ( std::memcmp( magic, "LINARBIN", sizeof(magic) ) != 0 ||
+           version != format_version )
+        throw std::runtime_error( "linarray_io: unknown file format" );
+      if ( byte_order != byte_order_mark )
+        throw std::runtime_error( "linarray_io: byte order mismatch" );
+      if ( element_size != sizeof(T) )
+        throw std::runtime_error( "linarray_io: element size mismatch" );
+    }
+  };
+  static_assert( sizeof(file_header) == 64, "header must stay 64 bytes" );
+
+  /* ======================================================================== */
+
+  // FNV-1a over 8-byte words in four interleaved lanes, fed incrementally
+  class checksum {
+    private:
+      static const std::uint64_t prime = 0x100000001B3ULL;
+      std::uint64_t lane[4];
+      unsigned char pending[32];
+      size_type pending_bytes;
+
+    public:
+      checksum() : pending_bytes(0) {
+        for (std::uint64_t& h : lane) { h = 0xCBF29CE484222325ULL; }
+      }
+
+      void update( const void* data, size_type bytes ) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        if ( pending_bytes > 0 ) {
+          const size_type take = std::min( bytes, 32 - pending_bytes );
+          std::memcpy( pending + pending_bytes, p, take );
+          pending_bytes += take;
+          p += take;
+          bytes -= take;
+          if ( pending_bytes < 32 ) { return; }
+          mix( pending );
+          pending_bytes = 0;
+        }
+        for (; bytes >= 32; p += 32, bytes -= 32) { mix( p ); }
+        std::memcpy( pending, p, bytes );
+        pending_bytes = bytes;
+      }
+
+      std::uint64_t value() const {
+        std::uint64_t h = lane[0];
+        for (unsigned i = 1; i < 4; ++i) { h = (h ^ lane[i]) * prime; }
+        for (size_type i = 0; i < pending_bytes; ++i) {
+          h = (h ^ pending[i]) * prime;
+        }
+        return h;
+      }
+
+    private:
+      inline void mix( const unsigned char* block ) {
+        for (unsigned i = 0; i < 4; ++i) {
+          std::uint64_t word;
+          std::memcpy( &word, block + 8 * i, sizeof(word) );
+          lane[i] = (lane[i] ^ word) * prime;
+        }
+      }
+  };
+
+  /* ======================================================================== */
+
+  inline void throw_error( const char* what ) {
+    throw std::system_error( errno, std::generic_category(),
+      std::string("linarray_io: ") + what );
+  }
+
+  inline void write_all( int fd, const void* data, size_type bytes ) {
+    const char* p = static_cast<const char*>(data);
+    while ( bytes > 0 ) {
+      const ssize_t done = ::write( fd, p, bytes );
+      if ( done < 0 && errno == EINTR ) { continue; }
+      if ( done <= 0 ) { throw_error( "write" ); }
+      p += done;
+      bytes -= done;
+    }
+  }
+
+  // fewer bytes than asked only at the end of the file
+  inline size_type read_all( int fd, void* data, size_type bytes ) {
+    char* p = static_cast<char*>(data);
+    size_type total = 0;
+    while ( total < bytes ) {
+      const ssize_t done = ::read( fd, p + total, bytes - total );
+      if ( done < 0 && errno == EINTR ) { continue; }
+      if ( done < 0 ) { throw_error( "read" ); }
+      if ( done == 0 ) { break; }
+      total += done;
+    }
+    return total;
+  }
+
+  // owns a file descriptor, optionally opened with O_DIRECT
+  class file {
+    public:
+      int fd;
+      bool direct;
+
+      file( const std::string& path, int flags, bool use_direct )
+      : fd(-1), direct(false)
+      {
+        #if defined(O_DIRECT)
+          if ( use_direct ) {
+            fd = ::open( path.c_str(), flags | O_DIRECT, 0644 );
+            direct = (fd >= 0);
+          }
+        #else
+          (void)use_direct;
+        #endif
+        // file systems without O_DIRECT support (tmpfs) get buffered I/O
+        if ( fd < 0 ) { fd = ::open( path.c_str(), flags, 0644 ); }
+        if ( fd < 0 ) { throw_error( "open" ); }
+      }
+      ~file() { ::close( fd ); }
+
+    private:
+      file( const file& );
+      file& operator= ( const file& );
+  };
+
+  // aligned memory for O_DIRECT transfers
+  class aligned_buffer {
+    public:
+      unsigned char* data;
+
+      explicit aligned_buffer( size_type bytes ) : data(nullptr) {
+        void* p = nullptr;
+        if ( ::posix_memalign( &p, direct_block, bytes ) != 0 ) {
+          throw std::bad_alloc();
+        }
+        data = static_cast<unsigned char*>(p);
+      }
+      ~aligned_buffer() { std::free( data ); }
+
+    private:
+      aligned_buffer( const aligned_buffer& );
+      aligned_buffer& operator= ( const aligned_buffer& );
+  };
+
+  /* ======================================================================== */
+
+  /*
+    Sequential reader of a saved array: the header is read and checked on
+    construction, read() then returns the elements in pieces of any size,
+    and the checksum is verified after the last one.
+  */
+  template< class T >
+  class chunk_reader {
+    static_assert( std::is_trivially_copyable<T>::value,
+      "linarray_io needs trivially copyable elements" );
+
+    private:
+      std::unique_ptr<file> owned;
+      std::unique_ptr<aligned_buffer> bounce;
+      int fd;
+      file_header h;
+      size_type left;
+      checksum sum;
+      size_type buffer_pos, buffer_end;
+
+    public:
+      // reads from the current position of fd, which stays open
+      explicit chunk_reader( int source )
+      : fd(source), left(0), buffer_pos(0), buffer_end(0)
+      {
+        start();
+      }
+
+      explicit chunk_reader( const std::string& path, bool direct = false )
+      : owned( new file( path, O_RDONLY, direct ) ), fd( owned->fd ), left(0),
+        buffer_pos(0), buffer_end(0)
+      {
+        if ( owned->direct ) { bounce.reset( new aligned_buffer( direct_buffer ) ); }
+        start();
+      }
+
+      inline const file_header& header() const { return h; }
+      inline size_type remaining() const { return left; }
+
+      // up to count elements into dest, 0 after the last one
+      size_type read( T* dest, size_type count ) {
+        count = std::min( count, left );
+        if ( count == 0 ) { return 0; }
+        read_bytes( dest, count * sizeof(T) );
+        sum.update( dest, count * sizeof(T) );
+        left -= count;
+        if ( left == 0 && sum.value() != h.checksum ) {
+          throw std::runtime_error( "linarray_io: checksum mismatch" );
+        }
+        return count;
+      }
+
+      // the next chunk of up to max_count elements, empty after the last one
+      template< class Allocator >
+      size_type next( linarray<T, Allocator>& chunk, size_type max_count ) {
+        chunk.resize_default_init( std::min( max_count, left ) );
+        return read( chunk.data(), chunk.size() );
+      }
+
+    private:
+      void start() {
+        read_bytes( &h, sizeof(h) );
+        h.check<T>();
+        left = h.count;
+        if ( left == 0 && h.checksum != checksum().value() ) {
+          throw std::runtime_error( "linarray_io: checksum mismatch" );
+        }
+      }
+
+      void read_bytes( void* dest, size_type bytes ) {
+        unsigned char* p = static_cast<unsigned char*>(dest);
+        if ( !bounce ) {
+          if ( read_all( fd, p, bytes ) != bytes ) { truncated(); }
+          return;
+        }
+        while ( bytes > 0 ) {
+          if ( buffer_pos == buffer_end ) {
+            buffer_pos = 0;
+            buffer_end = read_all( fd, bounce->data, direct_buffer );
+            if ( buffer_end == 0 ) { truncated(); }
+          }
+          const size_type take = std::min( bytes, buffer_end - buffer_pos );
+          std::memcpy( p, bounce->data + buffer_pos, take );
+          buffer_pos += take;
+          p += take;
+          bytes -= take;
+        }
+      }
+
+      static void truncated() {
+        throw std::runtime_error( "linarray_io: file is truncated" );
+      }
+  };
+
+  /* ======================================================================== */
+
+  template< class T, class Allocator >
+  file_header header_of( const linarray<T, Allocator>& arr ) {
+    static_assert( std::is_trivially_copyable<T>::value,
+      "linarray_io needs trivially copyable elements" );
+    checksum sum;
+    sum.update( arr.data(), arr.size() * sizeof(T) );
+    return file_header::describe<T>( arr.size(), sum.value() );
+  }
+
+  // at the current position of fd: a file, a pipe or a socket
+  template< class T, class Allocator >
+  void save( const linarray<T, Allocator>& arr, int fd ) {
+    const file_header h = header_of( arr );
+    const size_type data_bytes = arr.size() * sizeof(T);
+    iovec parts[2];
+    parts[0].iov_base = const_cast<file_header*>(&h);
+    parts[0].iov_len = sizeof(h);
+    parts[1].iov_base = const_cast<T*>( arr.data() );
+    parts[1].iov_len = data_bytes;
+
+    ssize_t done;
+    do { done = ::writev( fd, parts, 2 ); } while ( done < 0 && errno == EINTR );
+    if ( done < 0 ) { throw_error( "writev" ); }
+    // the rest, if the kernel took less than everything
+    const size_type written = done;
+    if ( written < sizeof(h) ) {
+      write_all( fd, reinterpret_cast<const char*>(&h) + written,
+        sizeof(h) - written );
+      write_all( fd, arr.data(), data_bytes );
+    }
+    else {
+      write_all( fd, reinterpret_cast<const char*>( arr.data() )
+        + (written - sizeof(h)), data_bytes - (written - sizeof(h)) );
+    }
+  }
+
+  template< class T, class Allocator >
+  void load( linarray<T, Allocator>& arr, int fd ) {
+    chunk_reader<T> reader( fd );
+    arr.resize_default_init( reader.remaining() );
+    reader.read( arr.data(), arr.size() );
+  }
+
+  template< class T, class Allocator >
+  void save( const linarray<T, Allocator>& arr, std::ostream& os ) {
+    const file_header h = header_of( arr );
+    os.write( reinterpret_cast<const char*>(&h), sizeof(h) );
+    os.write( reinterpret_cast<const char*>( arr.data() ),
+      arr.size() * sizeof(T) );
+  }
+
+  template< class T, class Allocator >
+  void load( linarray<T, Allocator>& arr, std::istream& is ) {
+    file_header h;
+    if ( !is.read( reinterpret_cast<char*>(&h), sizeof(h) ) ) {
+      throw std::runtime_error( "linarray_io: file is truncated" );
+    }
+    h.check<T>();
+    arr.resize_default_init( h.count );
+    const size_type data_bytes = arr.size() * sizeof(T);
+    if ( !is.read( reinterpret_cast<char*>( arr.data() ), data_bytes ) ) {
+      throw std::runtime_error( "linarray_io: file is truncated" );
+    }
+    checksum sum;
+    sum.update( arr.data(), data_bytes );
+    if ( sum.value() != h.checksum ) {
+      throw std::runtime_error( "linarray_io: checksum mismatch" );
+    }
+  }
+
+  template< class T, class Allocator >
+  void save_file( const linarray<T, Allocator>& arr, const std::string& path,
+    bool direct = false )
+  {
+    file out( path, O_WRONLY | O_CREAT | O_TRUNC, direct );
+    if ( !out.direct ) {
+      save( arr, out.fd );
+      return;
+    }
+
+    // whole aligned blocks, the padding of the last one is cut off after
+    const file_header h = header_of( arr );
+    aligned_buffer bounce( direct_buffer );
+    std::memcpy( bounce.data, &h, sizeof(h) );
+    size_type filled = sizeof(h);
+    const unsigned char* p = reinterpret_cast<const unsigned char*>( arr.data() );
+    size_type bytes = arr.size() * sizeof(T);
+    for (;;) {
+      const size_type take = std::min( bytes, direct_buffer - filled );
+      std::memcpy( bounce.data + filled, p, take );
+      filled += take;
+      p += take;
+      bytes -= take;
+      if ( bytes == 0 ) { break; }
+      write_all( out.fd, bounce.data, filled );
+      filled = 0;
+    }
+    const size_type padded = (filled + direct_block - 1) / direct_block
+                             * direct_block;
+    std::memset( bounce.data + filled, 0, padded - filled );
+    write_all( out.fd, bounce.data, padded );
+    if ( ::ftruncate( out.fd, sizeof(h) + arr.size() * sizeof(T) ) != 0 ) {
+      throw_error( "ftruncate" );
+    }
+  }
+
+  template< class T, class Allocator >
+  void load_file( linarray<T, Allocator>& arr, const std::string& path,
+    bool direct = false )
+  {
+    chunk_reader<T> reader( path, direct );
+    arr.resize_default_init( reader.remaining() );
+    reader.read( arr.data(), arr.size() );
+  }
+
+} //end of namespace "linarray_io"
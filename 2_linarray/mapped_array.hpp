@@ -0,0 +1,284 @@
+#pragma once
+
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+#include <system_error>
+#include <string>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+  Persistent array of trivially copyable T, stored in a memory-mapped file
+  (POSIX only). Opening an existing file maps it as it is, so the elements
+  are usable right away without parsing or copying; pages are read in by
+  the kernel on first access. The file starts with a small header (format
+  version, sizeof(T), size and capacity), the elements follow at a 64-byte
+  offset. Capacity grows in powers of two like in linarray, by ftruncate()
+  and remapping, which invalidates pointers and iterators as reallocation
+  does. Changes reach the file in the background, flush() waits for them.
+  Errors of the system calls are thrown as std::system_error, files of
+  another format or element type as std::runtime_error. An array opened
+  with open_read is mapped read-only: read it through a const reference,
+  every non-const member throws std::logic_error instead of faulting.
+*/
+template< class T >
+class mapped_array {
+  static_assert( std::is_trivially_copyable<T>::value,
+    "mapped_array needs trivially copyable elements" );
+
+  public:
+    typedef T                                     value_type;
+    typedef T&                                    reference;
+    typedef const T&                              const_reference;
+    typedef std::size_t                           size_type;
+    typedef std::ptrdiff_t                        difference_type;
+    typedef T*                                    pointer;
+    typedef const T*                              const_pointer;
+    typedef pointer                               iterator;
+    typedef const_pointer                         const_iterator;
+    typedef std::reverse_iterator<iterator>       reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    enum open_mode {
+      create,      // new empty array, an existing file is truncated
+      open_write,  // existing array, can be modified and grown
+      open_read    // existing array, read-only mapping
+    };
+
+  private:
+    struct file_header {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t element_size;
+      std::uint64_t count;
+      std::uint64_t capacity;
+    };
+
+    static const std::uint32_t format_version = 1;
+    static const size_type data_offset = 64;
+
+    int fd;
+    bool writable;
+    unsigned char* base;
+    size_type mapped_bytes;
+
+  public:
+    explicit mapped_array( const std::string& path, open_mode mode = open_write )
+    : fd(-1), writable( mode != open_read ), base(nullptr), mapped_bytes(0)
+    {
+      const int flags = (mode == create) ? O_RDWR | O_CREAT | O_TRUNC
+                      : (mode == open_write) ? O_RDWR : O_RDONLY;
+      fd = ::open( path.c_str(), flags, 0644 );
+      if ( fd < 0 ) { throw_error( "open" ); }
+      try {
+        if ( mode == create ) { init_file(); } else { map_file(); }
+      } catch (...) {
+        unmap();
+        ::close( fd );
+        throw;
+      }
+    }
+
+    mapped_array( mapped_array&& other )
+    : fd(other.fd), writable(other.writable), base(other.base),
+      mapped_bytes(other.mapped_bytes)
+    {
+      other.fd = -1;
+      other.base = nullptr;
+      other.mapped_bytes = 0;
+    }
+
+    ~mapped_array() {
+      unmap();
+      if ( fd >= 0 ) { ::close( fd ); }
+    }
+
+    /* iterators */
+    inline const_iterator cbegin() const {
+      return reinterpret_cast<const_pointer>( base + data_offset );
+    }
+    inline iterator begin() {
+      require_writable();
+      return const_cast<iterator>( cbegin() );
+    }
+
+    inline const_iterator cend() const { return cbegin() + size(); }
+    inline iterator end() {
+      require_writable();
+      return const_cast<iterator>( cend() );
+    }
+
+    inline const_reverse_iterator
+      crbegin() const { return const_reverse_iterator( cend() ); }
+    inline reverse_iterator
+      rbegin() { return reverse_iterator( end() ); }
+
+    inline const_reverse_iterator
+      crend() const { return const_reverse_iterator( cbegin() ); }
+    inline reverse_iterator
+      rend() { return reverse_iterator( begin() ); }
+
+    /* data access */
+    inline const_reference
+      operator[] ( size_type pos ) const { return *(cbegin() + pos); }
+    inline reference
+      operator[] ( size_type pos ) { return *(begin() + pos); }
+
+    inline const_reference front() const { return *cbegin(); }
+    inline reference front() { return *begin(); }
+
+    inline const_reference back() const { return *(cend() - 1); }
+    inline reference back() { return *(end() - 1); }
+
+    inline const_pointer data() const { return cbegin(); }
+    inline pointer data() { return begin(); }
+
+    /* capacity */
+    inline bool empty() const { return size() == 0; }
+    inline size_type size() const { return header().count; }
+    inline size_type capacity() const { return header().capacity; }
+
+    void reserve( size_type count ) {
+      require_writable();
+      if ( count > capacity() ) { grow( calc_capacity( count ) ); }
+    }
+
+    /* management */
+    void resize( size_type count, const_reference value = T() ) {
+      reserve( count );  // checks writable
+      if ( count > size() ) { std::fill( end(), begin() + count, value ); }
+      header().count = count;
+    }
+
+    inline void clear() { resize(0); }
+
+    inline void push_back( const_reference value ) {
+      require_writable();
+      if ( size() == capacity() ) { grow( calc_capacity( size() + 1 ) ); }
+      *end() = value;
+      ++header().count;
+    }
+
+    inline void pop_back() {
+      require_writable();
+      --header().count;
+    }
+
+    template< typename InputIt >
+    void append( InputIt first, InputIt last ) {
+      const size_type count = std::distance( first, last );
+      reserve( size() + count );  // checks writable
+      std::copy( first, last, end() );
+      header().count += count;
+    }
+
+    // blocks until all changes are written to the file
+    void flush() {
+      if ( writable && ::msync( base, mapped_bytes, MS_SYNC ) != 0 ) {
+        throw_error( "msync" );
+      }
+    }
+
+  private:
+    mapped_array( const mapped_array& );
+    mapped_array& operator= ( const mapped_array& );
+
+    static void throw_error( const char* what ) {
+      throw std::system_error( errno, std::generic_category(),
+        std::string("mapped_array: ") + what );
+    }
+
+    // the mapping of an open_read array is PROT_READ, writes would fault
+    inline void require_writable() const {
+      if ( !writable ) {
+        throw std::logic_error( "mapped_array: array is read-only" );
+      }
+    }
+
+    static size_type calc_capacity( size_type count ) {
+      return static_cast<size_type>(
+        std::pow( 2.0, std::ceil( std::log2( (count>0) ?count :1 ) ) )
+      );
+    }
+
+    static size_type bytes_for( size_type capacity ) {
+      return data_offset + capacity * sizeof(T);
+    }
+
+    inline file_header& header() {
+      return *reinterpret_cast<file_header*>( base );
+    }
+    inline const file_header& header() const {
+      return *reinterpret_cast<const file_header*>( base );
+    }
+
+    void map( size_type bytes ) {
+      void* addr = ::mmap( nullptr, bytes,
+        writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 );
+      if ( addr == MAP_FAILED ) { throw_error( "mmap" ); }
+      base = static_cast<unsigned char*>(addr);
+      mapped_bytes = bytes;
+    }
+
+    void unmap() {
+      if ( base != nullptr ) { ::munmap( base, mapped_bytes ); }
+      base = nullptr;
+    }
+
+    void init_file() {
+      const size_type capacity = calc_capacity(0);
+      if ( ::ftruncate( fd, bytes_for( capacity ) ) != 0 ) {
+        throw_error( "ftruncate" );
+      }
+      map( bytes_for( capacity ) );
+      file_header& h = header();
+      std::memcpy( h.magic, "LINARRAY", sizeof(h.magic) );
+      h.version = format_version;
+      h.element_size = sizeof(T);
+      h.count = 0;
+      h.capacity = capacity;
+    }
+
+    void map_file() {
+      struct stat st;
+      if ( ::fstat( fd, &st ) != 0 ) { throw_error( "fstat" ); }
+      const size_type file_bytes = static_cast<size_type>( st.st_size );
+      if ( file_bytes < data_offset ) {
+        throw std::runtime_error( "mapped_array: file is too short" );
+      }
+      map( file_bytes );
+      const file_header& h = header();
+      if ( std::memcmp( h.magic, "LINARRAY", sizeof(h.magic) ) != 0 ||
+           h.version != format_version )
+        throw std::runtime_error( "mapped_array: unknown file format" );
+      if ( h.element_size != sizeof(T) )
+        throw std::runtime_error( "mapped_array: element size mismatch" );
+      if ( h.count > h.capacity || bytes_for( h.capacity ) > file_bytes )
+        throw std::runtime_error( "mapped_array: file is truncated" );
+    }
+
+    void grow( size_type new_capacity ) {
+      require_writable();
+      const size_type bytes = bytes_for( new_capacity );
+      if ( ::ftruncate( fd, bytes ) != 0 ) { throw_error( "ftruncate" ); }
+      #if defined(__linux__)
+        void* addr = ::mremap( base, mapped_bytes, bytes, MREMAP_MAYMOVE );
+        if ( addr == MAP_FAILED ) { throw_error( "mremap" ); }
+        base = static_cast<unsigned char*>(addr);
+        mapped_bytes = bytes;
+      #else
+        unmap();
+        map( bytes );
+      #endif
+      header().capacity = new_capacity;
+    }
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__linux__)
+  #include <unistd.h>
+  #include <sched.h>
+  #include <pthread.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <linux/mempolicy.h>
+#endif
+
+/*
+  NUMA placement of large arrays (Linux). numa_allocator maps blocks of
+  64 KB and more directly and places their pages with mbind(). The
+  placements are: interleaved over all nodes; on one node; or left to the
+  kernel, which puts every page on the node of the thread that first
+  touches it. parallel_fill() is the matching first touch. Each of its
+  pinned workers writes the slice it will process later, so the pages of
+  that slice land on the worker's node. The nodes are counted at run time.
+  On a single-node machine, or without NUMA support, mbind() is not called
+  and everything still works with plain first-touch placement.
+*/
+namespace numa {
+
+  enum placement {
+    first_touch,   // the kernel default
+    interleaved,   // pages spread round-robin over all nodes
+    on_node        // pages on one given node
+  };
+
+  // the highest online node + 1, from sysfs ("0", "0-1", "0,2-3")
+  inline unsigned node_count() {
+    static const unsigned count = []() {
+      std::ifstream online( "/sys/devices/system/node/online" );
+      std::string list;
+      if ( !(online >> list) ) { return 1u; }
+      const std::string::size_type last = list.find_last_of( ",-" );
+      const std::string highest =
+        (last == std::string::npos) ? list : list.substr( last + 1 );
+      return static_cast<unsigned>( std::stoul( highest ) + 1 );
+    }();
+    return count;
+  }
+
+  // moves the calling thread to the given CPU, false if not possible
+  inline bool pin_thread( unsigned cpu ) {
+    #if defined(__linux__)
+      cpu_set_t set;
+      CPU_ZERO( &set );
+      CPU_SET( cpu % std::max( 1u, std::thread::hardware_concurrency() ), &set );
+      return pthread_setaffinity_np( pthread_self(), sizeof(set), &set ) == 0;
+    #else
+      (void)cpu;
+      return false;
+    #endif
+  }
+
+  // applies the placement to pages not touched yet, false if not possible
+  inline bool place( void* addr, std::size_t bytes, placement where,
+    unsigned node = 0 )
+  {
+    const unsigned nodes = node_count();
+    if ( where == first_touch || nodes < 2 ) { return false; }
+    #if defined(__linux__)
+      unsigned long mask[4] = { 0, 0, 0, 0 };
+      const unsigned bits = 8 * sizeof(unsigned long);
+      const unsigned max_node = std::min( nodes, 4 * bits );
+      if ( where == interleaved ) {
+        for (unsigned n = 0; n < max_node; ++n) {
+          mask[n / bits] |= 1UL << (n % bits);
+        }
+      }
+      else {
+        node %= max_node;
+        mask[node / bits] |= 1UL << (node % bits);
+      }
+      const int mode = (where == interleaved) ? MPOL_INTERLEAVE : MPOL_PREFERRED;
+      return syscall( __NR_mbind, addr, bytes, mode, mask, max_node + 1, 0 ) == 0;
+    #else
+      (void)addr; (void)bytes; (void)node;
+      return false;
+    #endif
+  }
+
+  /*
+    Fills [first, last) from the given number of threads, each pinned to
+    its own CPU and writing one contiguous slice. Used on freshly allocated
+    memory (e.g. linarray(count, default_init) of trivial T), this is the
+    first touch that places every slice on the node of its worker. Later
+    parallel passes should split the range the same way.
+  */
+  template< class RandomIt, class T >
+  void parallel_fill( RandomIt first, RandomIt last, const T& value,
+    unsigned threads = std::thread::hardware_concurrency() )
+  {
+    threads = std::max( 1u, threads );
+    const std::size_t count = std::distance( first, last );
+    std::vector<std::thread> workers;
+    workers.reserve( threads );
+    try {
+      for (unsigned t = 0; t < threads; ++t) {
+        const RandomIt slice_first = first + count * t / threads;
+        const RandomIt slice_last = first + count * (t + 1) / threads;
+        workers.emplace_back( [=, &value]() {
+          pin_thread( t );
+          std::fill( slice_first, slice_last, value );
+        } );
+      }
+    } catch (...) {
+      // a joinable std::thread must not be destroyed
+      for (std::thread& worker : workers) { worker.join(); }
+      throw;
+    }
+    for (std::thread& worker : workers) { worker.join(); }
+  }
+
+} //end of namespace "numa"
+
+/* ========================================================================== */
+
+template<typename T>
+class numa_allocator {
+  public:
+    typedef T                 value_type;
+    typedef       value_type* pointer;
+    typedef const value_type* const_pointer;
+    typedef       value_type& reference;
+    typedef const value_type& const_reference;
+    typedef std::size_t       size_type;
+    typedef std::ptrdiff_t    difference_type;
+
+    static const size_type large_block = 64 * 1024;  // bytes, mapped directly
+
+  public:
+    template<typename U>
+    struct rebind {
+      typedef numa_allocator<U> other;
+    };
+
+    numa::placement where;
+    unsigned node;
+
+  public:
+    explicit numa_allocator( numa::placement p = numa::first_touch,
+      unsigned n = 0 )
+    : where(p), node(n) {}
+
+    template< typename U >
+    numa_allocator( const numa_allocator<U>& other )
+    : where(other.where), node(other.node) {}
+
+    pointer allocate( size_type cnt ) {
+      const size_type bytes = cnt * sizeof(T);
+      if ( bytes < large_block ) {
+        return reinterpret_cast<pointer>( ::operator new( bytes ) );
+      }
+      #if defined(__linux__)
+        void* p = ::mmap( nullptr, bytes, PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( p == MAP_FAILED ) { throw std::bad_alloc(); }
+        numa::place( p, bytes, where, node );
+        return reinterpret_cast<pointer>(p);
+      #else
+        return reinterpret_cast<pointer>( ::operator new( bytes ) );
+      #endif
+    }
+
+    void deallocate( pointer p, size_type cnt ) {
+      const size_type bytes = cnt * sizeof(T);
+      #if defined(__linux__)
+        if ( bytes >= large_block ) {
+          ::munmap( p, bytes );
+          return;
+        }
+      #endif
+      ::operator delete(p);
+    }
+};
+
+template< typename T >
+const typename numa_allocator<T>::size_type numa_allocator<T>::large_block;
+
+template< typename T, typename U >
+bool operator== ( const numa_allocator<T>& a, const numa_allocator<U>& b ) {
+  return a.where == b.where && a.node == b.node;
+}
+
+template< typename T, typename U >
+bool operator!= ( const numa_allocator<T>& a, const numa_allocator<U>& b ) {
+  return !(a == b);
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <iterator>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+#include <thread_pool.hpp>
+
+#include "heapsort.hpp"
+
+/*
+  Parallel versions of for_each, transform, reduce, inclusive_scan and sort
+  over random access ranges (linarray iterators or plain pointers). The range is
+  cut into grains of consecutive elements that the threads of a
+  shared::thread_pool take one after another, by default the shared pool
+  with one thread per core. A grain is at most 16 KB of elements, so input
+  and output of a grain stay in L1, and at least one cache line, so two
+  threads never write the same line; within that, ranges get about 4 grains
+  per thread to balance uneven work. An explicit grain (in elements)
+  overrides this. The operations of reduce and scan must be associative,
+  not commutative: partial results are combined in the order of the range.
+*/
+namespace {
+  const std::size_t GRAIN_BYTES = 16 * 1024;
+  const std::size_t LINE_BYTES = 64;
+  const std::size_t GRAINS_PER_THREAD = 4;
+
+  template< class T >
+  std::size_t grain_size( std::size_t count, unsigned threads,
+    std::size_t grain )
+  {
+    if ( grain != 0 ) { return grain; }
+    const std::size_t largest = std::max<std::size_t>( 1, GRAIN_BYTES / sizeof(T) );
+    const std::size_t smallest = std::max<std::size_t>( 1, LINE_BYTES / sizeof(T) );
+    const std::size_t balanced = count / (threads * GRAINS_PER_THREAD) + 1;
+    return std::max( smallest, std::min( largest, balanced ) );
+  }
+
+  // body( grain index, first index, last index ) for every grain
+  template< class T, class Body >
+  std::size_t for_each_grain( std::size_t count, shared::thread_pool& pool,
+    std::size_t grain, Body body )
+  {
+    grain = grain_size<T>( count, pool.size(), grain );
+    const std::size_t grains = (count + grain - 1) / grain;
+    pool.parallel_for( grains, [&]( std::size_t g ) {
+      body( g, g * grain, std::min( count, (g + 1) * grain ) );
+    } );
+    return grains;
+  }
+
+  template< class RandomIt, class Compare >
+  void sort_runs( shared::thread_pool& pool, RandomIt first, RandomIt last,
+    Compare comp, std::size_t run )
+  {
+    const std::size_t count = std::distance( first, last );
+    if ( count <= run ) {
+      custom::heap_sort( first, last, comp );
+      return;
+    }
+    const RandomIt middle = first + count / 2;
+    shared::task_group halves( pool );
+    halves.spawn( [&]() { sort_runs( pool, first, middle, comp, run ); } );
+    sort_runs( pool, middle, last, comp, run );
+    halves.sync();
+    std::inplace_merge( first, middle, last, comp );
+  }
+} //end of namespace
+
+namespace custom {
+
+  template< class RandomIt, class UnaryFunc >
+  void parallel_for_each( RandomIt first, RandomIt last, UnaryFunc f,
+    shared::thread_pool& pool = shared::thread_pool::instance(),
+    std::size_t grain = 0 )
+  {
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+    for_each_grain<value_type>( std::distance( first, last ), pool, grain,
+      [&]( std::size_t, std::size_t from, std::size_t to ) {
+        std::for_each( first + from, first + to, f );
+      } );
+  }
+
+  // d_first may be first; returns the end of the output
+  template< class RandomIt, class OutputIt, class UnaryOp >
+  OutputIt parallel_transform( RandomIt first, RandomIt last, OutputIt d_first,
+    UnaryOp op, shared::thread_pool& pool = shared::thread_pool::instance(),
+    std::size_t grain = 0 )
+  {
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+    const std::size_t count = std::distance( first, last );
+    for_each_grain<value_type>( count, pool, grain,
+      [&]( std::size_t, std::size_t from, std::size_t to ) {
+        std::transform( first + from, first + to, d_first + from, op );
+      } );
+    return d_first + count;
+  }
+
+  // init op e[0] op e[1] ... op e[n-1], grouped by grains
+  template< class RandomIt, class T, class BinaryOp >
+  T parallel_reduce( RandomIt first, RandomIt last, T init, BinaryOp op,
+    shared::thread_pool& pool = shared::thread_pool::instance(),
+    std::size_t grain = 0 )
+  {
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+    const std::size_t count = std::distance( first, last );
+    if ( count == 0 ) { return init; }
+    grain = grain_size<value_type>( count, pool.size(), grain );
+    std::vector<T> partial( (count + grain - 1) / grain );
+    for_each_grain<value_type>( count, pool, grain,
+      [&]( std::size_t g, std::size_t from, std::size_t to ) {
+        T sum = first[from];
+        for (std::size_t i = from + 1; i < to; ++i) { sum = op( sum, first[i] ); }
+        partial[g] = sum;
+      } );
+    for (const T& sum : partial) { init = op( init, sum ); }
+    return init;
+  }
+
+  template< class RandomIt, class T >
+  T parallel_reduce( RandomIt first, RandomIt last, T init,
+    shared::thread_pool& pool = shared::thread_pool::instance(),
+    std::size_t grain = 0 )
+  {
+    return parallel_reduce( first, last, init, std::plus<T>(), pool, grain );
+  }
+
+  /*
+    d[i] = e[0] op ... op e[i]; d_first may be first. Two passes: the grains
+    are reduced, their totals are combined into the offset of every grain,
+    then each grain is scanned from its offset.
+  */
+  template< class RandomIt, class OutputIt, class BinaryOp >
+  OutputIt parallel_inclusive_scan( RandomIt first, RandomIt last,
+    OutputIt d_first, BinaryOp op,
+    shared::thread_pool& pool = shared::thread_pool::instance(),
+    std::size_t grain = 0 )
+  {
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+    const std::size_t count = std::distance( first, last );
+    if ( count == 0 ) { return d_first; }
+    grain = grain_size<value_type>( count, pool.size(), grain );
+    const std::size_t grains = (count + grain - 1) / grain;
+
+    // grain g starts from offset[g - 1], the last grain is not reduced
+    std::vector<value_type> offset( grains - 1 );
+    pool.parallel_for( grains - 1, [&]( std::size_t g ) {
+      const std::size_t from = g * grain;
+      value_type sum = first[from];
+      for (std::size_t i = from + 1; i < from + grain; ++i) {
+        sum = op( sum, first[i] );
+      }
+      offset[g] = sum;
+    } );
+    for (std::size_t g = 1; g < offset.size(); ++g) {
+      offset[g] = op( offset[g - 1], offset[g] );
+    }
+
+    for_each_grain<value_type>( count, pool, grain,
+      [&]( std::size_t g, std::size_t from, std::size_t to ) {
+        value_type sum = (g == 0) ? first[from] : op( offset[g - 1], first[from] );
+        d_first[from] = sum;
+        for (std::size_t i = from + 1; i < to; ++i) {
+          sum = op( sum, first[i] );
+          d_first[i] = sum;
+        }
+      } );
+    return d_first + count;
+  }
+
+  template< class RandomIt, class OutputIt >
+  OutputIt parallel_inclusive_scan( RandomIt first, RandomIt last,
+    OutputIt d_first,
+    shared::thread_pool& pool = shared::thread_pool::instance(),
+    std::size_t grain = 0 )
+  {
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+    return parallel_inclusive_scan( first, last, d_first,
+      std::plus<value_type>(), pool, grain );
+  }
+
+  /*
+    Not stable. Runs of one grain are sorted with custom::heap_sort, which
+    stays in cache at that size, and merged pairwise as the fork/join
+    recursion returns; only the last merge is serial over the whole range.
+  */
+  template< class RandomIt, class Compare >
+  void parallel_sort( RandomIt first, RandomIt last, Compare comp,
+    shared::thread_pool& pool = shared::thread_pool::instance(),
+    std::size_t grain = 0 )
+  {
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+    const std::size_t count = std::distance( first, last );
+    sort_runs( pool, first, last, comp,
+      grain_size<value_type>( count, pool.size(), grain ) );
+  }
+
+  template< class RandomIt >
+  void parallel_sort( RandomIt first, RandomIt last,
+    shared::thread_pool& pool = shared::thread_pool::instance(),
+    std::size_t grain = 0 )
+  {
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+    parallel_sort( first, last, std::less<value_type>(), pool, grain );
+  }
+
+} //end of namespace "custom"
@@ -0,0 +1,421 @@
+#pragma once
+
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <initializer_list>
+
+/*
+  Double-ended queue in one circular buffer: push and pop are O(1) at both
+  ends, where a linarray used as a FIFO moves every element on
+  erase(cbegin()). The capacity is a power of two as in linarray, so the
+  physical slot of element i is (head + i) & (capacity - 1), without a
+  division. Growing moves the elements into a buffer twice as large, in
+  order from slot 0. Iterators are random access (usable with
+  custom::heap_sort), but slower than linarray's pointers; linearize()
+  moves the elements to slot 0 when a pointer range is needed (in place
+  when the buffer is full, else into a new buffer of the same capacity).
+  With set_limit(n) the buffer keeps at most n elements: push_back() on a
+  full buffer drops the oldest element (the front), push_front() drops the
+  newest (the back), e.g. for the last n samples of a stream.
+*/
+template< class T, class Allocator = std::allocator<T> >
+class ring_buffer {
+  private:
+    typedef std::allocator_traits<Allocator>        alloc_traits;
+
+  public:
+    typedef Allocator                               allocator_type;
+    typedef typename alloc_traits::value_type       value_type;
+    typedef value_type&                             reference;
+    typedef const value_type&                       const_reference;
+    typedef typename alloc_traits::size_type        size_type;
+    typedef typename alloc_traits::difference_type  difference_type;
+    typedef typename alloc_traits::pointer          pointer;
+    typedef typename alloc_traits::const_pointer    const_pointer;
+
+  private:
+    template< bool Const >
+    class iterator_t {
+      friend class ring_buffer;
+      friend class iterator_t<!Const>;
+      typedef typename std::conditional< Const,
+        const ring_buffer*, ring_buffer* >::type container_ptr;
+
+      container_ptr con;
+      size_type pos;
+
+      iterator_t( container_ptr c, size_type p ) : con(c), pos(p) {}
+
+    public:
+      typedef std::random_access_iterator_tag iterator_category;
+      typedef typename ring_buffer::value_type value_type;
+      typedef typename ring_buffer::difference_type difference_type;
+      typedef typename std::conditional< Const,
+        ring_buffer::const_pointer, ring_buffer::pointer >::type pointer;
+      typedef typename std::conditional< Const,
+        const_reference, ring_buffer::reference >::type reference;
+
+      iterator_t() : con(nullptr), pos(0) {}
+      // iterator to const_iterator; a template, so the implicit copy
+      // constructor and assignment stay
+      template< bool C = Const, typename std::enable_if< C, int >::type = 0 >
+      iterator_t( const iterator_t<false>& other )
+      : con(other.con), pos(other.pos) {}
+
+      inline reference operator* () const { return (*con)[pos]; }
+      inline pointer operator-> () const { return std::addressof( **this ); }
+      inline reference operator[] ( difference_type n ) const {
+        return (*con)[pos + n];
+      }
+
+      inline iterator_t& operator++ () { ++pos; return *this; }
+      inline iterator_t operator++ (int) { iterator_t it(*this); ++pos; return it; }
+      inline iterator_t& operator-- () { --pos; return *this; }
+      inline iterator_t operator-- (int) { iterator_t it(*this); --pos; return it; }
+
+      inline iterator_t& operator+= ( difference_type n ) { pos += n; return *this; }
+      inline iterator_t& operator-= ( difference_type n ) { pos -= n; return *this; }
+      inline iterator_t operator+ ( difference_type n ) const {
+        return iterator_t( con, pos + n );
+      }
+      inline iterator_t operator- ( difference_type n ) const {
+        return iterator_t( con, pos - n );
+      }
+      friend inline iterator_t operator+ ( difference_type n, const iterator_t& it ) {
+        return it + n;
+      }
+      inline difference_type operator- ( const iterator_t& other ) const {
+        return static_cast<difference_type>(pos)
+          - static_cast<difference_type>(other.pos);
+      }
+
+      inline bool operator== ( const iterator_t& other ) const { return pos == other.pos; }
+      inline bool operator!= ( const iterator_t& other ) const { return pos != other.pos; }
+      inline bool operator< ( const iterator_t& other ) const { return pos < other.pos; }
+      inline bool operator> ( const iterator_t& other ) const { return pos > other.pos; }
+      inline bool operator<= ( const iterator_t& other ) const { return pos <= other.pos; }
+      inline bool operator>= ( const iterator_t& other ) const { return pos >= other.pos; }
+    };
+
+  public:
+    typedef iterator_t<false>                       iterator;
+    typedef iterator_t<true>                        const_iterator;
+    typedef std::reverse_iterator<iterator>         reverse_iterator;
+    typedef std::reverse_iterator<const_iterator>   const_reverse_iterator;
+
+  private:
+    allocator_type allocator;
+    pointer buffer;
+    size_type s_capacity;   // 0 or a power of two
+    size_type s_head;       // slot of the front element
+    size_type s_count;
+    size_type s_limit;      // 0 when unbounded
+
+  public:
+    explicit ring_buffer( size_type count = 0,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), buffer(nullptr), s_capacity(0), s_head(0), s_count(0),
+      s_limit(0)
+    {
+      fill_or_release( [&]() { resize( count ); } );
+    }
+
+    ring_buffer( size_type count, const_reference value,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), buffer(nullptr), s_capacity(0), s_head(0), s_count(0),
+      s_limit(0)
+    {
+      fill_or_release( [&]() { resize( count, value ); } );
+    }
+
+    //note: same magic as in linarray, against conflict with fill constructor
+    template< typename InputIt,
+      typename std::enable_if<
+        !std::is_integral<InputIt>::value
+      >::type* = nullptr >
+    ring_buffer( InputIt first, InputIt last,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), buffer(nullptr), s_capacity(0), s_head(0), s_count(0),
+      s_limit(0)
+    {
+      fill_or_release( [&]() { append( first, last ); } );
+    }
+
+    ring_buffer( const ring_buffer& other,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), buffer(nullptr), s_capacity(0), s_head(0), s_count(0),
+      s_limit(other.s_limit)
+    {
+      fill_or_release( [&]() {
+        reserve( other.size() );
+        append( other.cbegin(), other.cend() );
+      } );
+    }
+
+    ring_buffer( std::initializer_list<value_type> init,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), buffer(nullptr), s_capacity(0), s_head(0), s_count(0),
+      s_limit(0)
+    {
+      fill_or_release( [&]() { append( init.begin(), init.end() ); } );
+    }
+
+    ~ring_buffer() { release(); }
+
+    /* assignment operators */
+    ring_buffer& operator= ( const ring_buffer& other ) {
+      if ( this != &other ) {
+        clear();
+        s_limit = other.s_limit;
+        reserve( other.size() );
+        append( other.cbegin(), other.cend() );
+      }
+      return (*this);
+    }
+
+    ring_buffer& operator= ( std::initializer_list<value_type> init ) {
+      clear();
+      append( init.begin(), init.end() );
+      return (*this);
+    }
+
+    inline allocator_type get_allocator() const { return allocator; }
+
+    /* iterators */
+    inline const_iterator cbegin() const { return const_iterator( this, 0 ); }
+    inline iterator begin() { return iterator( this, 0 ); }
+
+    inline const_iterator cend() const { return const_iterator( this, s_count ); }
+    inline iterator end() { return iterator( this, s_count ); }
+
+    inline const_reverse_iterator
+      crbegin() const { return const_reverse_iterator( cend() ); }
+    inline reverse_iterator
+      rbegin() { return reverse_iterator( end() ); }
+
+    inline const_reverse_iterator
+      crend() const { return const_reverse_iterator( cbegin() ); }
+    inline reverse_iterator
+      rend() { return reverse_iterator( begin() ); }
+
+    /* data access */
+    inline const_reference operator[] ( size_type pos ) const {
+      return buffer[ slot(pos) ];
+    }
+    inline reference operator[] ( size_type pos ) {
+      return buffer[ slot(pos) ];
+    }
+
+    inline const_reference front() const { return buffer[s_head]; }
+    inline reference front() { return buffer[s_head]; }
+
+    inline const_reference back() const { return (*this)[s_count - 1]; }
+    inline reference back() { return (*this)[s_count - 1]; }
+
+    // moves the elements to slot 0, returns them as one contiguous block
+    pointer linearize() {
+      if ( s_head != 0 ) {
+        if ( s_count == s_capacity ) {
+          std::rotate( buffer, buffer + s_head, buffer + s_capacity );
+          s_head = 0;
+        }
+        else {
+          grow( s_capacity );
+        }
+      }
+      return buffer;
+    }
+
+    /* capacity */
+    inline bool empty() const { return s_count == 0; }
+    inline size_type size() const { return s_count; }
+    inline size_type capacity() const { return s_capacity; }
+
+    // at most limit elements from now on, 0 for no limit
+    inline size_type limit() const { return s_limit; }
+    inline bool full() const { return s_limit != 0 && s_count == s_limit; }
+
+    void set_limit( size_type limit ) {
+      s_limit = limit;
+      if ( limit == 0 ) { return; }
+      while ( s_count > limit ) { pop_front(); }
+      reserve( limit );
+    }
+
+    void reserve( size_type count ) {
+      if ( count > s_capacity ) { grow( calc_capacity( count ) ); }
+    }
+
+    void shrink_to_fit() {
+      const size_type needed = (s_count == 0) ? 0 : calc_capacity( s_count );
+      if ( needed < s_capacity ) { grow( needed ); }
+    }
+
+    /* management */
+    void swap( ring_buffer& other ) {
+      std::swap( allocator, other.allocator );
+      std::swap( buffer, other.buffer );
+      std::swap( s_capacity, other.s_capacity );
+      std::swap( s_head, other.s_head );
+      std::swap( s_count, other.s_count );
+      std::swap( s_limit, other.s_limit );
+    }
+
+    void clear() {
+      while ( s_count > 0 ) { pop_back(); }
+      s_head = 0;
+    }
+
+    void resize( size_type count ) {
+      if ( count > size() ) {
+        resize( count, T() );
+      }
+      else {
+        while ( s_count > count ) { pop_back(); }
+      }
+    }
+
+    void resize( size_type count, const_reference value ) {
+      if ( count > size() ) {
+        reserve( count );
+        while ( s_count < count ) { emplace_back( value ); }
+      }
+      else {
+        resize( count );
+      }
+    }
+
+    template< typename InputIt >
+    void append( InputIt first, InputIt last ) {
+      for (; first != last; ++first) { emplace_back( *first ); }
+    }
+
+    /* common management */
+    inline void push_back( const_reference value ) { emplace_back( value ); }
+    inline void push_back( value_type&& value ) { emplace_back( std::move(value) ); }
+    inline void push_front( const_reference value ) { emplace_front( value ); }
+    inline void push_front( value_type&& value ) { emplace_front( std::move(value) ); }
+
+    template< typename... Args >
+    void emplace_back( Args&&... args ) {
+      if ( full() ) {
+        value_type value( std::forward<Args>(args)... );
+        pop_front();
+        construct( slot(s_count), std::move(value) );
+      }
+      else {
+        if ( s_count == s_capacity ) { grow( next_capacity() ); }
+        construct( slot(s_count), std::forward<Args>(args)... );
+      }
+      ++s_count;
+    }
+
+    template< typename... Args >
+    void emplace_front( Args&&... args ) {
+      if ( full() ) {
+        value_type value( std::forward<Args>(args)... );
+        pop_back();
+        construct( (s_head - 1) & mask(), std::move(value) );
+      }
+      else {
+        if ( s_count == s_capacity ) { grow( next_capacity() ); }
+        construct( (s_head - 1) & mask(), std::forward<Args>(args)... );
+      }
+      s_head = (s_head - 1) & mask();
+      ++s_count;
+    }
+
+    inline void pop_back() {
+      --s_count;
+      alloc_traits::destroy( allocator, std::addressof( buffer[ slot(s_count) ] ) );
+    }
+
+    inline void pop_front() {
+      alloc_traits::destroy( allocator, std::addressof( buffer[s_head] ) );
+      s_head = (s_head + 1) & mask();
+      --s_count;
+    }
+
+  private:
+    inline size_type mask() const { return s_capacity - 1; }
+    inline size_type slot( size_type pos ) const { return (s_head + pos) & mask(); }
+
+    inline size_type next_capacity() const {
+      return (s_capacity == 0) ? 1 : 2 * s_capacity;
+    }
+
+    // the power of two not below count, as in linarray
+    inline static size_type calc_capacity( size_type count ) {
+      size_type capacity = 1;
+      while ( capacity < count ) { capacity *= 2; }
+      return capacity;
+    }
+
+    template< typename... Args >
+    inline void construct( size_type at, Args&&... args ) {
+      alloc_traits::construct( allocator, std::addressof( buffer[at] ),
+        std::forward<Args>(args)... );
+    }
+
+    // moves the elements in order to slot 0 of a new buffer
+    void release() {
+      clear();
+      if ( buffer != nullptr ) {
+        alloc_traits::deallocate( allocator, buffer, s_capacity );
+      }
+    }
+
+    // for constructors: if the fill throws, the elements built so far and
+    // the buffer are released, since no destructor will run
+    template< class Fill >
+    void fill_or_release( Fill fill ) {
+      try {
+        fill();
+      } catch (...) {
+        release();
+        throw;
+      }
+    }
+
+    void grow( size_type new_capacity ) {
+      pointer new_buffer = (new_capacity == 0) ? nullptr
+        : alloc_traits::allocate( allocator, new_capacity );
+      try {
+        relocate( new_buffer );
+      } catch (...) {
+        if ( new_buffer != nullptr ) {
+          alloc_traits::deallocate( allocator, new_buffer, new_capacity );
+        }
+        throw;
+      }
+      if ( buffer != nullptr ) {
+        alloc_traits::deallocate( allocator, buffer, s_capacity );
+      }
+      buffer = new_buffer;
+      s_capacity = new_capacity;
+      s_head = 0;
+    }
+
+    // moves the elements in order into the new buffer, then destroys the
+    // old ones; a throwing copy leaves the old buffer untouched
+    void relocate( pointer dest ) {
+      size_type moved = 0;
+      try {
+        for (; moved < s_count; ++moved) {
+          alloc_traits::construct( allocator, std::addressof( dest[moved] ),
+            std::move_if_noexcept( (*this)[moved] ) );
+        }
+      } catch (...) {
+        for (size_type i = 0; i < moved; ++i) {
+          alloc_traits::destroy( allocator, std::addressof( dest[i] ) );
+        }
+        throw;
+      }
+      for (size_type i = 0; i < s_count; ++i) {
+        alloc_traits::destroy( allocator, std::addressof( (*this)[i] ) );
+      }
+    }
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#endif
+
+#include "linarray.hpp"
+#include "abc_allocator.hpp"
+
+/*
+  Read-only search index over sorted keys, laid out as an implicit static
+  B+ tree with 64-byte nodes. The leaves are the keys themselves, copied
+  into 64-byte aligned blocks; every inner node holds the smallest key of
+  its children 1..B, and node k of a level has children k*(B+1) ... on the
+  level below, so no pointers are stored. A lookup reads one cache line
+  per level, log_17(n) lines for int keys instead of about log_2(n) for a
+  binary search, and compares a whole node at once (AVX2 for 32-bit
+  integers, a loop the compiler vectorizes otherwise). The batched
+  lower_bound walks a group of queries down the tree together and
+  prefetches the next node of each, so their cache misses overlap.
+  Results are ranks in the sorted input: lower_bound(x) is the number of
+  keys less than x, 0 for a NaN. The inner levels add about 1/16 to the
+  keys.
+*/
+template< class T >
+class static_search_index {
+  static_assert( std::is_arithmetic<T>::value,
+    "keys are padded with the largest value of T" );
+
+  // greater than or equal to every query, +infinity included
+  inline static T padding() {
+    return std::numeric_limits<T>::has_infinity
+      ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+  }
+
+  public:
+    typedef T                 value_type;
+    typedef std::size_t       size_type;
+
+    static const size_type node_bytes = 64;
+    static const size_type node_keys = node_bytes / sizeof(T);  // B
+    static const size_type batch = 16;    // queries walked together
+
+  private:
+    typedef linarray< T, abc_allocator<T, node_bytes> > node_array;
+
+    node_array leaves;      // the keys, padded to whole nodes
+    node_array inner;       // the inner levels, the root first
+    std::vector<size_type> level_start;   // node offset in inner, from the root
+    size_type s_count;
+
+  public:
+    static_search_index() : s_count(0) {}
+
+    // from sorted keys, e.g. a sorted linarray or flat_set::sequence()
+    template< typename InputIt >
+    static_search_index( InputIt first, InputIt last ) : s_count(0) {
+      build( first, last );
+    }
+
+    template< typename InputIt >
+    void build( InputIt first, InputIt last ) {
+      leaves.assign( first, last );
+      s_count = leaves.size();
+      const size_type leaf_nodes = nodes_for( s_count );
+      leaves.resize( leaf_nodes * node_keys, padding() );
+
+      // node counts from the leaves up, the root level has one node
+      std::vector<size_type> nodes;
+      for (size_type n = leaf_nodes; n > 1; ) {
+        n = (n + node_keys) / (node_keys + 1);
+        nodes.push_back( n );
+      }
+      level_start.assign( 1, 0 );
+      for (size_type h = nodes.size(); h > 0; --h) {
+        level_start.push_back( level_start.back() + nodes[h - 1] );
+      }
+      inner.assign( level_start.back() * node_keys, padding() );
+
+      // node m of level h (h = 1 above the leaves) covers leaf nodes
+      // from m * (B+1)^(h-1); its slot i holds the first key of child i
+      size_type span = 1;   // leaf nodes under one child
+      for (size_type h = 1; h <= nodes.size(); ++h) {
+        T* level = inner.data() + level_start[nodes.size() - h] * node_keys;
+        for (size_type m = 0; m < nodes[h - 1]; ++m) {
+          for (size_type i = 1; i <= node_keys; ++i) {
+            const size_type leaf = (m * (node_keys + 1) + i) * span;
+            if ( leaf < leaf_nodes ) {
+              level[m * node_keys + i - 1] = leaves[leaf * node_keys];
+            }
+          }
+        }
+        span *= node_keys + 1;
+      }
+    }
+
+    inline size_type size() const { return s_count; }
+    inline bool empty() const { return s_count == 0; }
+    inline size_type height() const { return level_start.size() - 1; }
+    // the sorted keys
+    inline const T& operator[] ( size_type rank ) const { return leaves[rank]; }
+
+    // the number of keys less than key
+    size_type lower_bound( T key ) const {
+      if ( empty() ) { return 0; }
+      size_type k = 0;
+      for (size_type h = 0; h < height(); ++h) {
+        k = k * (node_keys + 1) + count_less( inner_node( h, k ), key );
+      }
+      return std::min( s_count,
+        k * node_keys + count_less( leaves.data() + k * node_keys, key ) );
+    }
+
+    inline bool contains( T key ) const {
+      const size_type rank = lower_bound( key );
+      return rank < s_count && leaves[rank] == key;
+    }
+
+    // lower_bound() of every query into out
+    template< typename InputIt, typename OutputIt >
+    OutputIt lower_bound( InputIt first, InputIt last, OutputIt out ) const {
+      T keys[batch];
+      size_type k[batch];
+      while ( first != last ) {
+        size_type count = 0;
+        for (; count < batch && first != last; ++count, ++first) {
+          keys[count] = *first;
+          k[count] = 0;
+        }
+        if ( empty() ) {
+          out = std::fill_n( out, count, 0 );
+          continue;
+        }
+        for (size_type h = 0; h < height(); ++h) {
+          for (size_type q = 0; q < count; ++q) {
+            k[q] = k[q] * (node_keys + 1) + count_less( inner_node( h, k[q] ), keys[q] );
+            prefetch( (h + 1 < height()) ? inner_node( h + 1, k[q] )
+                                         : leaves.data() + k[q] * node_keys );
+          }
+        }
+        for (size_type q = 0; q < count; ++q, ++out) {
+          *out = std::min( s_count, k[q] * node_keys
+            + count_less( leaves.data() + k[q] * node_keys, keys[q] ) );
+        }
+      }
+      return out;
+    }
+
+  private:
+    inline static size_type nodes_for( size_type count ) {
+      return std::max<size_type>( 1, (count + node_keys - 1) / node_keys );
+    }
+
+    inline const T* inner_node( size_type h, size_type k ) const {
+      return inner.data() + (level_start[h] + k) * node_keys;
+    }
+
+    inline static void prefetch( const T* node ) {
+      #if defined(__GNUC__)
+        __builtin_prefetch( node );
+      #else
+        (void)node;
+      #endif
+    }
+
+    template< typename U >
+    inline static unsigned count_less( const U* node, U key ) {
+      unsigned count = 0;
+      for (size_type i = 0; i < node_keys; ++i) { count += node[i] < key; }
+      return count;
+    }
+
+    #if defined(__AVX2__)
+      inline static unsigned count_less( const std::int32_t* node,
+        std::int32_t key )
+      {
+        const __m256i x = _mm256_set1_epi32( key );
+        const __m256i lo = _mm256_cmpgt_epi32( x,
+          _mm256_load_si256( reinterpret_cast<const __m256i*>( node ) ) );
+        const __m256i hi = _mm256_cmpgt_epi32( x,
+          _mm256_load_si256( reinterpret_cast<const __m256i*>( node + 8 ) ) );
+        const unsigned mask =
+          static_cast<unsigned>( _mm256_movemask_ps( _mm256_castsi256_ps(lo) ) )
+          | static_cast<unsigned>( _mm256_movemask_ps( _mm256_castsi256_ps(hi) ) ) << 8;
+        return __builtin_popcount( mask );
+      }
+    #endif
+};
+
+template< class T >
+const typename static_search_index<T>::size_type
+  static_search_index<T>::node_bytes;
+template< class T >
+const typename static_search_index<T>::size_type
+  static_search_index<T>::node_keys;
+template< class T >
+const typename static_search_index<T>::size_type
+  static_search_index<T>::batch;
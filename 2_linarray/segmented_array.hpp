@@ -0,0 +1,352 @@
+#pragma once
+
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <initializer_list>
+
+/*
+  Array stored in segments that are never moved: growing past the capacity
+  allocates one more segment instead of copying everything into a larger
+  buffer, so appends have no reallocation spikes, the memory peak is the
+  size of the data, and references to elements stay valid until they are
+  erased. Segment sizes double (16, 16, 32, 64, ... elements), the capacity
+  is a power of two as in linarray, and an element is found through a
+  directory of at most 64 segment pointers with one bit scan of its index.
+  Iterators are random access (usable with custom::heap_sort), but slower
+  than linarray's pointers.
+*/
+template< class T, class Allocator = std::allocator<T> >
+class segmented_array {
+  private:
+    typedef std::allocator_traits<Allocator>        alloc_traits;
+
+  public:
+    typedef Allocator                               allocator_type;
+    typedef typename alloc_traits::value_type       value_type;
+    typedef value_type&                             reference;
+    typedef const value_type&                       const_reference;
+    typedef typename alloc_traits::size_type        size_type;
+    typedef typename alloc_traits::difference_type  difference_type;
+    typedef typename alloc_traits::pointer          pointer;
+    typedef typename alloc_traits::const_pointer    const_pointer;
+
+  private:
+    template< bool Const >
+    class iterator_t {
+      friend class segmented_array;
+      friend class iterator_t<!Const>;
+      typedef typename std::conditional< Const,
+        const segmented_array*, segmented_array* >::type container_ptr;
+
+      container_ptr con;
+      size_type pos;
+
+      iterator_t( container_ptr c, size_type p ) : con(c), pos(p) {}
+
+    public:
+      typedef std::random_access_iterator_tag iterator_category;
+      typedef typename segmented_array::value_type value_type;
+      typedef typename segmented_array::difference_type difference_type;
+      typedef typename std::conditional< Const,
+        segmented_array::const_pointer, segmented_array::pointer >::type pointer;
+      typedef typename std::conditional< Const,
+        const_reference, segmented_array::reference >::type reference;
+
+      iterator_t() : con(nullptr), pos(0) {}
+      // iterator to const_iterator; a template, so the implicit copy
+      // constructor and assignment stay
+      template< bool C = Const, typename std::enable_if< C, int >::type = 0 >
+      iterator_t( const iterator_t<false>& other )
+      : con(other.con), pos(other.pos) {}
+
+      inline reference operator* () const { return (*con)[pos]; }
+      inline pointer operator-> () const { return std::addressof( **this ); }
+      inline reference operator[] ( difference_type n ) const {
+        return (*con)[pos + n];
+      }
+
+      inline iterator_t& operator++ () { ++pos; return *this; }
+      inline iterator_t operator++ (int) { iterator_t it(*this); ++pos; return it; }
+      inline iterator_t& operator-- () { --pos; return *this; }
+      inline iterator_t operator-- (int) { iterator_t it(*this); --pos; return it; }
+
+      inline iterator_t& operator+= ( difference_type n ) { pos += n; return *this; }
+      inline iterator_t& operator-= ( difference_type n ) { pos -= n; return *this; }
+      inline iterator_t operator+ ( difference_type n ) const {
+        return iterator_t( con, pos + n );
+      }
+      inline iterator_t operator- ( difference_type n ) const {
+        return iterator_t( con, pos - n );
+      }
+      friend inline iterator_t operator+ ( difference_type n, const iterator_t& it ) {
+        return it + n;
+      }
+      inline difference_type operator- ( const iterator_t& other ) const {
+        return static_cast<difference_type>(pos)
+          - static_cast<difference_type>(other.pos);
+      }
+
+      inline bool operator== ( const iterator_t& other ) const { return pos == other.pos; }
+      inline bool operator!= ( const iterator_t& other ) const { return pos != other.pos; }
+      inline bool operator< ( const iterator_t& other ) const { return pos < other.pos; }
+      inline bool operator> ( const iterator_t& other ) const { return pos > other.pos; }
+      inline bool operator<= ( const iterator_t& other ) const { return pos <= other.pos; }
+      inline bool operator>= ( const iterator_t& other ) const { return pos >= other.pos; }
+    };
+
+  public:
+    typedef iterator_t<false>                       iterator;
+    typedef iterator_t<true>                        const_iterator;
+    typedef std::reverse_iterator<iterator>         reverse_iterator;
+    typedef std::reverse_iterator<const_iterator>   const_reverse_iterator;
+
+    static const size_type first_segment = 16;      // elements, power of two
+
+  private:
+    static const unsigned first_bits = 4;           // log2( first_segment )
+
+  public:
+    static const unsigned max_segments =
+      std::numeric_limits<size_type>::digits - first_bits + 1;
+
+  private:
+
+    allocator_type allocator;
+    pointer directory[max_segments];
+    unsigned s_segments;
+    size_type s_count;
+
+  public:
+    explicit segmented_array( size_type count = 0,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), s_segments(0), s_count(0)
+    {
+      fill_or_release( [&]() { resize( count ); } );
+    }
+
+    segmented_array( size_type count, const_reference value,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), s_segments(0), s_count(0)
+    {
+      fill_or_release( [&]() { resize( count, value ); } );
+    }
+
+    //note: same magic as in linarray, against conflict with fill constructor
+    template< typename InputIt,
+      typename std::enable_if<
+        !std::is_integral<InputIt>::value
+      >::type* = nullptr >
+    segmented_array( InputIt first, InputIt last,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), s_segments(0), s_count(0)
+    {
+      fill_or_release( [&]() { append( first, last ); } );
+    }
+
+    segmented_array( const segmented_array& other,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), s_segments(0), s_count(0)
+    {
+      fill_or_release( [&]() { append( other.cbegin(), other.cend() ); } );
+    }
+
+    segmented_array( std::initializer_list<value_type> init,
+      const allocator_type& alloc = Allocator() )
+    : allocator(alloc), s_segments(0), s_count(0)
+    {
+      fill_or_release( [&]() { append( init.begin(), init.end() ); } );
+    }
+
+    ~segmented_array() {
+      clear();
+      free_segments(0);
+    }
+
+    /* assignment operators */
+    segmented_array& operator= ( const segmented_array& other ) {
+      if ( this != &other ) {
+        clear();
+        append( other.cbegin(), other.cend() );
+      }
+      return (*this);
+    }
+
+    segmented_array& operator= ( std::initializer_list<value_type> init ) {
+      clear();
+      append( init.begin(), init.end() );
+      return (*this);
+    }
+
+    inline allocator_type get_allocator() const { return allocator; }
+
+    /* iterators */
+    inline const_iterator cbegin() const { return const_iterator( this, 0 ); }
+    inline iterator begin() { return iterator( this, 0 ); }
+
+    inline const_iterator cend() const { return const_iterator( this, s_count ); }
+    inline iterator end() { return iterator( this, s_count ); }
+
+    inline const_reverse_iterator
+      crbegin() const { return const_reverse_iterator( cend() ); }
+    inline reverse_iterator
+      rbegin() { return reverse_iterator( end() ); }
+
+    inline const_reverse_iterator
+      crend() const { return const_reverse_iterator( cbegin() ); }
+    inline reverse_iterator
+      rend() { return reverse_iterator( begin() ); }
+
+    /* data access */
+    inline const_reference operator[] ( size_type pos ) const {
+      const unsigned seg = segment_of( pos );
+      return directory[seg][ pos - segment_start(seg) ];
+    }
+    inline reference operator[] ( size_type pos ) {
+      const unsigned seg = segment_of( pos );
+      return directory[seg][ pos - segment_start(seg) ];
+    }
+
+    inline const_reference front() const { return directory[0][0]; }
+    inline reference front() { return directory[0][0]; }
+
+    inline const_reference back() const { return (*this)[s_count - 1]; }
+    inline reference back() { return (*this)[s_count - 1]; }
+
+    /* segments, for contiguous access to the elements */
+    inline unsigned segments() const { return s_segments; }
+    inline const_pointer segment_data( unsigned seg ) const { return directory[seg]; }
+    inline pointer segment_data( unsigned seg ) { return directory[seg]; }
+    // number of elements in use in the segment
+    inline size_type segment_size( unsigned seg ) const {
+      const size_type start = segment_start(seg);
+      return (s_count <= start) ? 0
+        : std::min( s_count - start, segment_capacity(seg) );
+    }
+
+    // segment 0 holds [0, 16), segment k > 0 holds [16 << (k-1), 16 << k)
+    inline static unsigned segment_of( size_type pos ) {
+      return bit_width( pos >> first_bits );
+    }
+
+    inline static size_type segment_start( unsigned seg ) {
+      return (seg == 0) ? 0 : first_segment << (seg - 1);
+    }
+
+    inline static size_type segment_capacity( unsigned seg ) {
+      return (seg == 0) ? first_segment : first_segment << (seg - 1);
+    }
+
+    /* capacity */
+    inline bool empty() const { return s_count == 0; }
+    inline size_type size() const { return s_count; }
+    inline size_type capacity() const { return segment_start( s_segments ); }
+
+    void reserve( size_type count ) {
+      while ( capacity() < count ) { add_segment(); }
+    }
+
+    void shrink_to_fit() {
+      const unsigned used = (s_count == 0) ? 0 : segment_of( s_count - 1 ) + 1;
+      free_segments( used );
+    }
+
+    /* management */
+    void swap( segmented_array& other ) {
+      std::swap( allocator, other.allocator );
+      std::swap( directory, other.directory );
+      std::swap( s_segments, other.s_segments );
+      std::swap( s_count, other.s_count );
+    }
+
+    inline void clear() { resize(0); }
+
+    void resize( size_type count ) {
+      if ( count > size() ) {
+        resize( count, T() );
+      }
+      else {
+        while ( s_count > count ) { pop_back(); }
+      }
+    }
+
+    void resize( size_type count, const_reference value ) {
+      if ( count > size() ) {
+        reserve( count );
+        while ( s_count < count ) { emplace_back( value ); }
+      }
+      else {
+        resize( count );
+      }
+    }
+
+    template< typename InputIt >
+    void append( InputIt first, InputIt last ) {
+      for (; first != last; ++first) { emplace_back( *first ); }
+    }
+
+    /* common management */
+    inline void push_back( const_reference value ) {
+      emplace_back( value );
+    }
+
+    template< typename... Args >
+    inline void emplace_back( Args&&... args ) {
+      if ( s_count == capacity() ) { add_segment(); }
+      alloc_traits::construct( allocator, std::addressof( (*this)[s_count] ),
+        std::forward<Args>(args)... );
+      ++s_count;
+    }
+
+    inline void pop_back() {
+      --s_count;
+      alloc_traits::destroy( allocator, std::addressof( (*this)[s_count] ) );
+    }
+
+  private:
+    inline static unsigned bit_width( size_type x ) {
+      #if defined(__GNUC__)
+        return (x == 0) ? 0
+          : std::numeric_limits<unsigned long long>::digits
+            - __builtin_clzll( x );
+      #else
+        unsigned width = 0;
+        for (; x != 0; x >>= 1) { ++width; }
+        return width;
+      #endif
+    }
+
+    // for constructors: if the fill throws, the elements built so far and
+    // the segments are released, since no destructor will run
+    template< class Fill >
+    void fill_or_release( Fill fill ) {
+      try {
+        fill();
+      } catch (...) {
+        clear();
+        free_segments(0);
+        throw;
+      }
+    }
+
+    void add_segment() {
+      directory[s_segments] =
+        alloc_traits::allocate( allocator, segment_capacity( s_segments ) );
+      ++s_segments;
+    }
+
+    // the segments from the given one on, which must hold no elements
+    void free_segments( unsigned from ) {
+      while ( s_segments > from ) {
+        --s_segments;
+        alloc_traits::deallocate( allocator, directory[s_segments],
+          segment_capacity( s_segments ) );
+      }
+    }
+};
+
+template< class T, class Allocator >
+const typename segmented_array<T, Allocator>::size_type
+  segmented_array<T, Allocator>::first_segment;
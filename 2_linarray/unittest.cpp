@@ -1,13 +1,40 @@
 #include <iostream>
+#include <sstream>
+#include <fstream>
 #include <random>
 #include <cmath>
-
-#include <measure_exec.hpp>
+#include <cstdio>
+#include <numeric>
+#include <thread>
+#include <iterator>
+#include <string>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <new>
+
+#include <benchmark.hpp>
+#include <bench_report.hpp>
+#include <bench_suite.hpp>
+#include <trace.hpp>
+#include <complex_t.hpp>
 
 #include <vector>
 #include "linarray.hpp"
 #include "abc_allocator.hpp"
 #include "heapsort.hpp"
+#include "hash_set.hpp"
+#include "mapped_array.hpp"
+#include "linarray_io.hpp"
+#include "segmented_array.hpp"
+#include "concurrent_array.hpp"
+#include "numa_allocator.hpp"
+#include "parallel_algorithms.hpp"
+#include "flat_set.hpp"
+#include "flat_map.hpp"
+#include "search_index.hpp"
+#include "ring_buffer.hpp"
+#include "cow_array.hpp"
 
 #include "catch/catch_with_main.hpp"
 
@@ -20,6 +47,10 @@ class IntElement {
     IntElement(const int& val = 0): value(val) { ++IntElement::RefCount; }
     IntElement(const IntElement& val): value(val.get_value()) { ++IntElement::RefCount; }
     ~IntElement() { --IntElement::RefCount; }
+    IntElement& operator= ( const IntElement& other ) {
+      value = other.get_value();
+      return *this;
+    }
     int get_value() const { return value; }
 
     #define COMPARE_OPERATOR(op) \
@@ -52,8 +83,6 @@ typedef linarray<IntElement, abc_allocator<IntElement>> t_linarray_abc;
 typedef t_vector::size_type size_type;
 //typedef t_vector::difference_type difference_type;
 
-typedef shared::measure<> time_measure;
-
 /* ========================================================================== */
 
 template< class T1, class T2 >
@@ -143,6 +172,11 @@ TEST_CASE( "linarray constructors and destructor", "[life]" ) {
     REQUIRE( IntElement::RefCount == ELEMENTS_COUNT );
     delete larr_abc;
     REQUIRE( IntElement::RefCount == 0 );
+    {
+      t_linarray_std larr_fill( 3 ), larr_value( 5, IntElement(CUSTOM_VALUE) );
+      REQUIRE( IntElement::RefCount == 8 );
+    }
+    REQUIRE( IntElement::RefCount == 0 );
   }
 }
 
@@ -227,6 +261,18 @@ TEST_CASE( "linarray capacity methods", "[size]" ) {
     REQUIRE( larr_std.capacity() == 1 );
     REQUIRE( larr_abc.capacity() == 1 );
   }
+  SECTION( "reserve" ) {
+    t_vector test_vec{ELEMENTS_SET_FORWARD};
+    t_linarray_std larr_std{ELEMENTS_SET_FORWARD};
+    larr_std.reserve( ELEMENTS_CAPACITY * 4 );
+    REQUIRE( larr_std.capacity() == ELEMENTS_CAPACITY * 4 );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_std, test_vec ) );
+    const auto data = larr_std.data();
+    larr_std.resize( ELEMENTS_CAPACITY * 4 );
+    REQUIRE( larr_std.data() == data );
+    larr_std.reserve( 1 );
+    REQUIRE( larr_std.capacity() == ELEMENTS_CAPACITY * 4 );
+  }
   SECTION( "size increasing, default value" ) {
     t_vector test_vec{ELEMENTS_SET_FORWARD};
     t_linarray_std larr_std{ELEMENTS_SET_FORWARD};
@@ -374,6 +420,326 @@ TEST_CASE( "elements management", "[manage]" ) {
   }
 }
 
+TEST_CASE( "linarray swap", "[manage]" ) {
+  t_vector test_fw{ELEMENTS_SET_FORWARD};
+  t_vector test_bk{ELEMENTS_SET_BACKWARD};
+  t_linarray_abc larr_abc1{ELEMENTS_SET_FORWARD};
+  t_linarray_abc larr_abc2{ELEMENTS_SET_BACKWARD};
+  larr_abc2.pop_back();
+  test_bk.pop_back();
+  larr_abc1.swap( larr_abc2 );
+  REQUIRE( IS_EQUAL_CONTAINERS( larr_abc1, test_bk ) );
+  REQUIRE( IS_EQUAL_CONTAINERS( larr_abc2, test_fw ) );
+}
+
+TEST_CASE( "linarray of integral values", "[manage]" ) {
+  linarray<int> larr_int;
+  for (int i = 0; i < 3; ++i) { larr_int.push_back( 7 ); }
+  larr_int.insert( 2, 5, larr_int.cbegin() );
+  REQUIRE( IS_EQUAL_CONTAINERS( larr_int, t_vector{ 5, 5, 7, 7, 7 } ) );
+}
+
+TEST_CASE( "linarray bulk append and assign", "[manage]" ) {
+  const t_vector range_vec{ELEMENTS_SET_BACKWARD};
+  SECTION( "append and assign keep capacity" ) {
+    t_vector test_vec{ELEMENTS_SET_FORWARD};
+    t_linarray_abc larr_abc{ELEMENTS_SET_FORWARD};
+    const int ref_count = IntElement::RefCount;
+    larr_abc.append( range_vec.cbegin(), range_vec.cend() );
+    test_vec.insert( test_vec.cend(), range_vec.cbegin(), range_vec.cend() );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_abc, test_vec ) );
+    REQUIRE( IntElement::RefCount - ref_count
+      == static_cast<int>( range_vec.size() ) );
+
+    const size_type capacity = larr_abc.capacity();
+    larr_abc.assign( 3, IntElement(CUSTOM_VALUE) );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_abc,
+      t_vector{ CUSTOM_VALUE, CUSTOM_VALUE, CUSTOM_VALUE } ) );
+    larr_abc.assign( {1, 2} );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_abc, t_vector{ 1, 2 } ) );
+    REQUIRE( larr_abc.capacity() == capacity );
+    REQUIRE( IntElement::RefCount - ref_count
+      == 2 - static_cast<int>( ELEMENTS_COUNT ) );
+  }
+  SECTION( "contiguous and move sources" ) {
+    linarray<int> larr_int{ 1, 2 };
+    larr_int.append( range_vec.data(), range_vec.data() + range_vec.size() );
+    larr_int.insert( std::make_move_iterator( range_vec.begin() ),
+      std::make_move_iterator( range_vec.begin() + 2 ), larr_int.cbegin() );
+    t_vector test_vec{ 115, 114, 1, 2 };
+    test_vec.insert( test_vec.cend(), range_vec.cbegin(), range_vec.cend() );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_int, test_vec ) );
+
+    linarray<std::string> larr_str{ "a", "b" };
+    std::vector<std::string> strings{ "c", "d" };
+    larr_str.append( std::make_move_iterator( strings.begin() ),
+      std::make_move_iterator( strings.end() ) );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_str,
+      std::vector<std::string>{ "a", "b", "c", "d" } ) );
+  }
+  SECTION( "single pass input" ) {
+    std::istringstream input( "7 8 9" );
+    linarray<int> larr_int{ 1, 2 };
+    larr_int.insert( std::istream_iterator<int>( input ),
+      std::istream_iterator<int>(), larr_int.cbegin() + 1 );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_int, t_vector{ 1, 7, 8, 9, 2 } ) );
+  }
+}
+
+TEST_CASE( "linarray compaction", "[manage]" ) {
+  const t_vector shuffled_vec{ELEMENTS_SET_SHUFFLED};
+  const auto is_odd = []( int x ) { return x % 2 != 0; };
+  SECTION( "erase_if" ) {
+    t_vector test_vec( shuffled_vec );
+    test_vec.erase( std::remove_if( test_vec.begin(), test_vec.end(), is_odd ),
+      test_vec.end() );
+    t_linarray_abc larr_abc( shuffled_vec.cbegin(), shuffled_vec.cend() );
+    linarray<int> larr_int( shuffled_vec.cbegin(), shuffled_vec.cend() );
+    const int ref_count = IntElement::RefCount;
+    REQUIRE( larr_abc.erase_if( [&]( const IntElement& x ) {
+      return is_odd( x.get_value() ); } ) == ELEMENTS_COUNT / 2 );
+    REQUIRE( larr_int.erase_if( is_odd ) == ELEMENTS_COUNT / 2 );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_abc, test_vec ) );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_int, test_vec ) );
+    REQUIRE( ref_count - IntElement::RefCount
+      == static_cast<int>( ELEMENTS_COUNT / 2 ) );
+  }
+  SECTION( "erase_indices" ) {
+    const t_vector indices{ 0, 3, 3, 4, 50, ELEMENTS_COUNT - 1 };
+    t_vector test_vec{ELEMENTS_SET_FORWARD};
+    for (auto it = indices.crbegin(); it != indices.crend(); ++it) {
+      if ( it != indices.crbegin() && *it == *(it - 1) ) { continue; }
+      test_vec.erase( test_vec.begin() + *it );
+    }
+    t_linarray_std larr_std{ELEMENTS_SET_FORWARD};
+    REQUIRE( larr_std.erase_indices( indices.cbegin(), indices.cend() ) == 5 );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_std, test_vec ) );
+    REQUIRE( larr_std.erase_indices( indices.cend(), indices.cend() ) == 0 );
+  }
+  SECTION( "unique" ) {
+    const t_vector runs_vec{ 1, 1, 2, 3, 3, 3, 1, 4, 4 };
+    linarray<int> larr_int( runs_vec.cbegin(), runs_vec.cend() );
+    t_linarray_std larr_std( runs_vec.cbegin(), runs_vec.cend() );
+    REQUIRE( larr_int.unique() == 4 );
+    REQUIRE( larr_std.unique() == 4 );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_int, t_vector{ 1, 2, 3, 1, 4 } ) );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_std, t_vector{ 1, 2, 3, 1, 4 } ) );
+    REQUIRE( larr_int.unique( []( int a, int b ) { return a / 2 == b / 2; } )
+      == 1 );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_int, t_vector{ 1, 2, 1, 4 } ) );
+    REQUIRE( linarray<int>().unique() == 0 );
+  }
+}
+
+TEST_CASE( "over-aligned allocation", "[size]" ) {
+  typedef abc_allocator<int, 64> t_line_alloc;
+  linarray<int, t_line_alloc> larr_line{ 1, 2, 3 };
+  REQUIRE( reinterpret_cast<std::uintptr_t>( larr_line.data() ) % 64 == 0 );
+  REQUIRE( larr_line.capacity() == 64 / sizeof(int) );
+  larr_line.resize( 3 + ELEMENTS_COUNT );
+  REQUIRE( reinterpret_cast<std::uintptr_t>( larr_line.data() ) % 64 == 0 );
+  REQUIRE( larr_line.capacity() == EXACT_CAPACITY( 3 + ELEMENTS_COUNT ) );
+
+  // 5 elements of 12 bytes: 8 fit in 96 bytes, 10 in the padded 128
+  linarray<std::array<int, 3>, abc_allocator<std::array<int, 3>, 64>>
+    larr_odd( 5 );
+  REQUIRE( larr_odd.capacity() == 10 );
+
+  linarray<double, abc_allocator<double, 4096>> larr_page( 1, 0.5 );
+  REQUIRE( reinterpret_cast<std::uintptr_t>( larr_page.data() ) % 4096 == 0 );
+  REQUIRE( larr_page.capacity() == 4096 / sizeof(double) );
+
+  hash_set<int, std::hash<int>, std::equal_to<int>, t_line_alloc> set;
+  for (int i = 0; i < 100; ++i) { set.insert( i % 10 ); }
+  REQUIRE( set.size() == 10 );
+}
+
+TEST_CASE( "linarray without value initialization", "[size]" ) {
+  SECTION( "default-initialized elements" ) {
+    const int ref_count = IntElement::RefCount;
+    t_linarray_abc larr_abc( 3, default_init );
+    REQUIRE( IntElement::RefCount - ref_count == 3 );
+    larr_abc.resize_default_init( ELEMENTS_COUNT );
+    REQUIRE( larr_abc.size() == ELEMENTS_COUNT );
+    REQUIRE( IntElement::RefCount - ref_count
+      == static_cast<int>( ELEMENTS_COUNT ) );
+    REQUIRE( larr_abc.back() == 0 );
+    larr_abc.resize_default_init( 2 );
+    REQUIRE( IntElement::RefCount - ref_count == 2 );
+
+    linarray<int> larr_int( ELEMENTS_COUNT, default_init );
+    REQUIRE( larr_int.size() == ELEMENTS_COUNT );
+    REQUIRE( larr_int.capacity() == ELEMENTS_CAPACITY );
+  }
+  SECTION( "resize_and_overwrite" ) {
+    linarray<int> larr_int{ CUSTOM_VALUE };
+    larr_int.resize_and_overwrite( ELEMENTS_COUNT,
+      []( int* data, size_type count ) {
+        std::iota( data + 1, data + count, 1 );
+        return count - 1;
+      } );
+    t_vector test_vec{ELEMENTS_SET_FORWARD};
+    test_vec.pop_back();
+    test_vec.front() = CUSTOM_VALUE;
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_int, test_vec ) );
+  }
+}
+
+TEST_CASE( "benchmark statistics", "[measure]" ) {
+  std::vector<double> ns{ 5.0, 1.0, 4.0, 2.0, 3.0, 100.0 };
+  const shared::bench_stats s = shared::bench_stats::from_samples( ns, 7 );
+  REQUIRE( s.samples == 6 );
+  REQUIRE( s.iterations == 7 );
+  REQUIRE( s.min == 1.0 );
+  REQUIRE( s.median == 3.5 );
+  REQUIRE( s.mean == Approx( 115.0 / 6.0 ) );
+  REQUIRE( s.stddev == Approx( 39.6253 ).epsilon( 1e-4 ) );
+  REQUIRE( s.p99 == 100.0 );
+
+  size_type calls = 0;
+  const shared::bench_stats run = shared::benchmark( 3, 0, 0.01 ).run(
+    [&]() { shared::do_not_optimize( ++calls ); } );
+  REQUIRE( run.samples == 3 );
+  REQUIRE( calls >= 3 * run.iterations );
+}
+
+TEST_CASE( "benchmark report", "[measure]" ) {
+  std::vector<double> ns{ 10.0, 11.0, 10.5, 9.5, 10.0 };
+  shared::bench_stats s = shared::bench_stats::from_samples( ns, 3 );
+  s.counters.valid[shared::perf_cycles] = true;
+  s.counters.value[shared::perf_cycles] = 42.5;
+
+  shared::bench_report report;
+  report.add( shared::bench_record( "sort, \"quoted\"", "int",
+    "abc_allocator", 1000, s ) );
+
+  SECTION( "round trip" ) {
+    std::stringstream json, csv;
+    report.write_json( json );
+    report.write_csv( csv );
+    for (std::stringstream* stream : { &json, &csv }) {
+      shared::bench_report loaded;
+      REQUIRE( loaded.read( *stream ) );
+      REQUIRE( loaded.records().size() == 1 );
+      const shared::bench_record& r = loaded.records().front();
+      REQUIRE( r.key() == report.records().front().key() );
+      REQUIRE( r.revision == shared::bench_record::current_revision() );
+      REQUIRE( r.stats.samples == 5 );
+      REQUIRE( r.stats.median == s.median );
+      REQUIRE( r.stats.stddev == s.stddev );
+      REQUIRE( r.stats.counters.valid[shared::perf_cycles] );
+      REQUIRE( r.stats.counters.value[shared::perf_cycles] == 42.5 );
+      REQUIRE_FALSE( r.stats.counters.valid[shared::perf_instructions] );
+    }
+  }
+
+  SECTION( "comparison" ) {
+    REQUIRE( shared::bench_change::t_critical( 9.0 ) ==
+             Approx( 2.262 ).epsilon( 1e-3 ) );
+    std::vector<double> slow{ 12.0, 13.0, 12.5, 11.5, 12.0 };
+    std::vector<double> noisy{ 5.0, 18.0, 10.0, 14.0, 11.0 };
+    const shared::bench_change worse = shared::bench_change::compare(
+      s, shared::bench_stats::from_samples( slow, 3 ) );
+    const shared::bench_change better = shared::bench_change::compare(
+      shared::bench_stats::from_samples( slow, 3 ), s );
+    const shared::bench_change noise = shared::bench_change::compare(
+      s, shared::bench_stats::from_samples( noisy, 3 ) );
+    REQUIRE( worse.regression );
+    REQUIRE( better.improvement );
+    REQUIRE_FALSE( noise.significant );
+    REQUIRE_FALSE( noise.regression );
+  }
+}
+
+TEST_CASE( "benchmark data and options", "[measure]" ) {
+  t_vector data(8);
+  shared::fill_data( data, shared::dist_reversed );
+  REQUIRE( IS_EQUAL_CONTAINERS( data, t_vector{ 7, 6, 5, 4, 3, 2, 1, 0 } ) );
+  shared::fill_data( data, shared::dist_organ_pipe );
+  REQUIRE( IS_EQUAL_CONTAINERS( data, t_vector{ 0, 1, 2, 3, 3, 2, 1, 0 } ) );
+  shared::fill_data( data, shared::dist_shuffled );
+  std::sort( data.begin(), data.end() );
+  REQUIRE( IS_EQUAL_CONTAINERS( data, t_vector{ 0, 1, 2, 3, 4, 5, 6, 7 } ) );
+
+  REQUIRE( shared::bench_options::parse_size( "1K" ) == 1000 );
+  REQUIRE( shared::bench_options::parse_size( "2.5M" ) == 2500000 );
+  REQUIRE( shared::bench_options::parse_size( "1B" ) == 1000000000 );
+  REQUIRE( shared::bench_options::parse_size( "1X" ) == 0 );
+
+  const char* argv[] = { "bench", "--size", "1K,10K", "--dist",
+    "few-unique,sorted", "--counters" };
+  shared::bench_options opts;
+  REQUIRE( opts.parse( 6, const_cast<char**>(argv) ) );
+  REQUIRE( opts.sizes.size() == 2 );
+  REQUIRE( opts.sizes[1] == 10000 );
+  REQUIRE( opts.distributions.size() == 2 );
+  REQUIRE( opts.distributions[0] == shared::dist_few_unique );
+  REQUIRE( opts.counters );
+  argv[4] = "unknown";
+  REQUIRE_FALSE( opts.parse( 6, const_cast<char**>(argv) ) );
+}
+
+TEST_CASE( "scope tracing", "[measure]" ) {
+  {
+    TRACE_SCOPE( "unittest scope" );
+    linarray<int> larr_int( 4, 1 );
+    larr_int.push_back( 2 );
+  }
+  #if defined(SHARED_TRACE)
+    REQUIRE( TRACE_FLUSH( "unittest_trace.json" ) );
+    std::ifstream file( "unittest_trace.json" );
+    std::stringstream trace;
+    trace << file.rdbuf();
+    REQUIRE( trace.str().find( "\"unittest scope\"" ) != std::string::npos );
+    #if defined(LINARRAY_TRACE)
+      REQUIRE( trace.str().find( "\"linarray::reallocate\"" ) != std::string::npos );
+    #endif
+  #else
+    REQUIRE_FALSE( TRACE_FLUSH( "unittest_trace.json" ) );
+  #endif
+}
+
+/* sorting algorithms for SORT_CONTAINERS, descending ones use reverse iterators */
+struct STD_SORT_ASC {
+  template< class C > void operator() ( C& con ) const
+    { std::sort( con.begin(), con.end() ); }
+};
+struct STD_SORT_DESC {
+  template< class C > void operator() ( C& con ) const
+    { std::sort( con.rbegin(), con.rend() ); }
+};
+struct HEAP_SORT_ASC {
+  template< class C > void operator() ( C& con ) const
+    { custom::heap_sort( con.begin(), con.end() ); }
+};
+struct HEAP_SORT_DESC {
+  template< class C > void operator() ( C& con ) const
+    { custom::heap_sort( con.rbegin(), con.rend() ); }
+};
+
+// every algorithm has to give the same order in every container
+template< class StdSort, class HeapSort >
+static void SORT_CONTAINERS( const t_vector& vec,
+  const t_linarray_std& larrstd, const t_linarray_abc& larrabc )
+{
+  t_vector test_vec( vec ), my_vec( vec );
+  t_linarray_std larr_std_std( larrstd ), larr_std_my( larrstd );
+  t_linarray_abc larr_abc_std( larrabc ), larr_abc_my( larrabc );
+
+  StdSort()( test_vec );
+  HeapSort()( my_vec );
+  StdSort()( larr_std_std );
+  HeapSort()( larr_std_my );
+  StdSort()( larr_abc_std );
+  HeapSort()( larr_abc_my );
+
+  REQUIRE( my_vec == test_vec );
+  REQUIRE( IS_EQUAL_CONTAINERS( larr_std_std, test_vec ) );
+  REQUIRE( IS_EQUAL_CONTAINERS( larr_std_my, test_vec ) );
+  REQUIRE( IS_EQUAL_CONTAINERS( larr_abc_std, test_vec ) );
+  REQUIRE( IS_EQUAL_CONTAINERS( larr_abc_my, test_vec ) );
+}
+
 TEST_CASE( "sorting", "[sort]" ) {
   const size_type sort_count = 100000;
   std::random_device rd;
@@ -398,329 +764,934 @@ TEST_CASE( "sorting", "[sort]" ) {
   /* ====================================================================== */
 
   SECTION( "forward order, ascending" ) {
-    t_vector test_vec(vec_forward);
-    t_linarray_std larr_std(larrstd_forward);
-    t_linarray_abc larr_abc(larrabc_forward);
-
-    // test_vec
-    const auto test_vec_std_time = time_measure::execution(
-      std::sort<t_vector::iterator>,
-      test_vec.begin(), test_vec.end()
-    );
-    test_vec = vec_forward;
-    const auto test_vec_my_time = time_measure::execution(
-      custom::heap_sort<t_vector::iterator>,
-      test_vec.begin(), test_vec.end()
-    );
-
-    // larr_std
-    const auto larr_std_std_time = time_measure::execution(
-      std::sort<t_linarray_std::iterator>,
-      larr_std.begin(), larr_std.end()
-    );
-    larr_std = larrstd_forward;
-    const auto larr_std_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_std::iterator>,
-      larr_std.begin(), larr_std.end()
-    );
-
-    // larr_abc
-    const auto larr_abc_std_time = time_measure::execution(
-      std::sort<t_linarray_abc::iterator>,
-      larr_abc.begin(), larr_abc.end()
-    );
-    larr_abc = larrabc_forward;
-    const auto larr_abc_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_abc::iterator>,
-      larr_abc.begin(), larr_abc.end()
-    );
-
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_std, test_vec ) );
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_abc, test_vec ) );
-
-    std::cout << "forward order, ascending:"
-      << "\n  std::vector"
-      << "\n    std::sort: " << test_vec_std_time
-      << "\n    custom::heap_sort: " << test_vec_my_time
-      << "\n  linarray (std::allocator)"
-      << "\n    std::sort: " << larr_std_std_time
-      << "\n    custom::heap_sort: " << larr_std_my_time
-      << "\n  linarray (abc_allocator)"
-      << "\n    std::sort: " << larr_abc_std_time
-      << "\n    custom::heap_sort: " << larr_abc_my_time
-      << "\n" << std::endl;
+    SORT_CONTAINERS<STD_SORT_ASC, HEAP_SORT_ASC>(
+      vec_forward, larrstd_forward, larrabc_forward );
   }
   SECTION( "forward order, descending" ) {
-    t_vector test_vec(vec_forward);
-    t_linarray_std larr_std(larrstd_forward);
-    t_linarray_abc larr_abc(larrabc_forward);
-
-    // test_vec
-    const auto test_vec_std_time = time_measure::execution(
-      std::sort<t_vector::reverse_iterator>,
-      test_vec.rbegin(), test_vec.rend()
-    );
-    test_vec = vec_forward;
-    const auto test_vec_my_time = time_measure::execution(
-      custom::heap_sort<t_vector::reverse_iterator>,
-      test_vec.rbegin(), test_vec.rend()
-    );
-
-    // larr_std
-    const auto larr_std_std_time = time_measure::execution(
-      std::sort<t_linarray_std::reverse_iterator>,
-      larr_std.rbegin(), larr_std.rend()
-    );
-    larr_std = larrstd_forward;
-    const auto larr_std_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_std::reverse_iterator>,
-      larr_std.rbegin(), larr_std.rend()
-    );
-
-    // larr_abc
-    const auto larr_abc_std_time = time_measure::execution(
-      std::sort<t_linarray_abc::reverse_iterator>,
-      larr_abc.rbegin(), larr_abc.rend()
-    );
-    larr_abc = larrabc_forward;
-    const auto larr_abc_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_abc::reverse_iterator>,
-      larr_abc.rbegin(), larr_abc.rend()
-    );
+    SORT_CONTAINERS<STD_SORT_DESC, HEAP_SORT_DESC>(
+      vec_forward, larrstd_forward, larrabc_forward );
+  }
 
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_std, test_vec ) );
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_abc, test_vec ) );
+  /* ====================================================================== */
 
-    std::cout << "forward order, descending:"
-      << "\n  std::vector"
-      << "\n    std::sort: " << test_vec_std_time
-      << "\n    custom::heap_sort: " << test_vec_my_time
-      << "\n  linarray (std::allocator)"
-      << "\n    std::sort: " << larr_std_std_time
-      << "\n    custom::heap_sort: " << larr_std_my_time
-      << "\n  linarray (abc_allocator)"
-      << "\n    std::sort: " << larr_abc_std_time
-      << "\n    custom::heap_sort: " << larr_abc_my_time
-      << "\n" << std::endl;
+  SECTION( "backward order, ascending" ) {
+    SORT_CONTAINERS<STD_SORT_ASC, HEAP_SORT_ASC>(
+      vec_backward, larrstd_backward, larrabc_backward );
+  }
+  SECTION( "backward order, descending" ) {
+    SORT_CONTAINERS<STD_SORT_DESC, HEAP_SORT_DESC>(
+      vec_backward, larrstd_backward, larrabc_backward );
   }
 
   /* ====================================================================== */
 
-  SECTION( "backward order, ascending" ) {
-    t_vector test_vec(vec_backward);
-    t_linarray_std larr_std(larrstd_backward);
-    t_linarray_abc larr_abc(larrabc_backward);
-
-    // test_vec
-    const auto test_vec_std_time = time_measure::execution(
-      std::sort<t_vector::iterator>,
-      test_vec.begin(), test_vec.end()
-    );
-    test_vec = vec_backward;
-    const auto test_vec_my_time = time_measure::execution(
-      custom::heap_sort<t_vector::iterator>,
-      test_vec.begin(), test_vec.end()
-    );
-
-    // larr_std
-    const auto larr_std_std_time = time_measure::execution(
-      std::sort<t_linarray_std::iterator>,
-      larr_std.begin(), larr_std.end()
-    );
-    larr_std = larrstd_backward;
-    const auto larr_std_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_std::iterator>,
-      larr_std.begin(), larr_std.end()
-    );
-
-    // larr_abc
-    const auto larr_abc_std_time = time_measure::execution(
-      std::sort<t_linarray_abc::iterator>,
-      larr_abc.begin(), larr_abc.end()
-    );
-    larr_abc = larrabc_backward;
-    const auto larr_abc_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_abc::iterator>,
-      larr_abc.begin(), larr_abc.end()
-    );
+  SECTION( "random order, ascending" ) {
+    SORT_CONTAINERS<STD_SORT_ASC, HEAP_SORT_ASC>(
+      vec_shuffled, larrstd_shuffled, larrabc_shuffled );
+  }
+  SECTION( "random order, descending" ) {
+    SORT_CONTAINERS<STD_SORT_DESC, HEAP_SORT_DESC>(
+      vec_shuffled, larrstd_shuffled, larrabc_shuffled );
+  }
+}
 
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_std, test_vec ) );
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_abc, test_vec ) );
+/* ========================================================================== */
 
-    std::cout << "backward order, ascending:"
-      << "\n  std::vector"
-      << "\n    std::sort: " << test_vec_std_time
-      << "\n    custom::heap_sort: " << test_vec_my_time
-      << "\n  linarray (std::allocator)"
-      << "\n    std::sort: " << larr_std_std_time
-      << "\n    custom::heap_sort: " << larr_std_my_time
-      << "\n  linarray (abc_allocator)"
-      << "\n    std::sort: " << larr_abc_std_time
-      << "\n    custom::heap_sort: " << larr_abc_my_time
-      << "\n" << std::endl;
+typedef hash_set<int> t_hashset_std;
+typedef hash_set<int, std::hash<int>, std::equal_to<int>,
+  abc_allocator<int>> t_hashset_abc;
+typedef hash_set<complex_t, complex_grid_hash, complex_grid_equal> t_complex_set;
+
+// a key whose assignment throws once assignments_left reaches 0
+struct FragileKey {
+  static int assignments_left;  // negative for no limit
+  int value;
+
+  FragileKey( int val = 0 ) : value(val) {}
+  FragileKey( const FragileKey& other ) : value(other.value) {}
+  FragileKey& operator= ( const FragileKey& other ) {
+    if ( assignments_left == 0 ) { throw std::runtime_error( "FragileKey" ); }
+    if ( assignments_left > 0 ) { --assignments_left; }
+    value = other.value;
+    return *this;
   }
-  SECTION( "backward order, descending" ) {
-    t_vector test_vec(vec_backward);
-    t_linarray_std larr_std(larrstd_backward);
-    t_linarray_abc larr_abc(larrabc_backward);
-
-    // test_vec
-    const auto test_vec_std_time = time_measure::execution(
-      std::sort<t_vector::reverse_iterator>,
-      test_vec.rbegin(), test_vec.rend()
-    );
-    test_vec = vec_backward;
-    const auto test_vec_my_time = time_measure::execution(
-      custom::heap_sort<t_vector::reverse_iterator>,
-      test_vec.rbegin(), test_vec.rend()
-    );
-
-    // larr_std
-    const auto larr_std_std_time = time_measure::execution(
-      std::sort<t_linarray_std::reverse_iterator>,
-      larr_std.rbegin(), larr_std.rend()
-    );
-    larr_std = larrstd_backward;
-    const auto larr_std_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_std::reverse_iterator>,
-      larr_std.rbegin(), larr_std.rend()
-    );
-
-    // larr_abc
-    const auto larr_abc_std_time = time_measure::execution(
-      std::sort<t_linarray_abc::reverse_iterator>,
-      larr_abc.rbegin(), larr_abc.rend()
-    );
-    larr_abc = larrabc_backward;
-    const auto larr_abc_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_abc::reverse_iterator>,
-      larr_abc.rbegin(), larr_abc.rend()
-    );
+  bool operator== ( const FragileKey& other ) const { return value == other.value; }
+};
+int FragileKey::assignments_left = -1;
 
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_std, test_vec ) );
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_abc, test_vec ) );
+struct fragile_key_hash {
+  std::size_t operator() ( const FragileKey& key ) const {
+    return std::hash<int>()( key.value );
+  }
+};
 
-    std::cout << "backward order, descending:"
-      << "\n  std::vector"
-      << "\n    std::sort: " << test_vec_std_time
-      << "\n    custom::heap_sort: " << test_vec_my_time
-      << "\n  linarray (std::allocator)"
-      << "\n    std::sort: " << larr_std_std_time
-      << "\n    custom::heap_sort: " << larr_std_my_time
-      << "\n  linarray (abc_allocator)"
-      << "\n    std::sort: " << larr_abc_std_time
-      << "\n    custom::heap_sort: " << larr_abc_my_time
-      << "\n" << std::endl;
+TEST_CASE( "hash_set", "[hash]" ) {
+  SECTION( "insertion and lookup" ) {
+    t_vector test_vec{ELEMENTS_SET_FORWARD};
+    t_hashset_std set_std;
+    t_hashset_abc set_abc( 4 );
+    for (int i : test_vec) {
+      REQUIRE( set_std.insert( i ).second );
+      REQUIRE( set_abc.insert( i ).second );
+    }
+    for (int i : test_vec) {
+      REQUIRE( !set_std.insert( i ).second );
+      REQUIRE( !set_abc.insert( i ).second );
+    }
+    REQUIRE( set_std.size() == ELEMENTS_COUNT );
+    REQUIRE( set_abc.size() == ELEMENTS_COUNT );
+    REQUIRE( set_std.bucket_count() >= 2 * ELEMENTS_COUNT );
+    REQUIRE( set_std.count( 0 ) == 1 );
+    REQUIRE( set_std.count( ELEMENTS_COUNT ) == 0 );
+    REQUIRE( *set_abc.find( CUSTOM_VALUE % ELEMENTS_COUNT ) ==
+      CUSTOM_VALUE % ELEMENTS_COUNT );
+    REQUIRE( set_abc.find( -CUSTOM_VALUE ) == set_abc.cend() );
   }
+  SECTION( "iteration and clear" ) {
+    t_vector test_vec{ELEMENTS_SET_BACKWARD};
+    t_hashset_std set_std( test_vec.cbegin(), test_vec.cend() );
+    t_vector from_set( set_std.cbegin(), set_std.cend() );
+    std::sort( from_set.begin(), from_set.end() );
+    std::sort( test_vec.begin(), test_vec.end() );
+    REQUIRE( from_set == test_vec );
+    set_std.clear();
+    REQUIRE( set_std.empty() );
+    REQUIRE( set_std.cbegin() == set_std.cend() );
+    REQUIRE( set_std.count( 1 ) == 0 );
+  }
+  SECTION( "complex keys, tolerance buckets" ) {
+    t_complex_set set_cmpl( 0, complex_grid_hash(1e-3), complex_grid_equal(1e-3) );
+    REQUIRE( set_cmpl.insert( complex_t( 1.0, 2.0 ) ).second );
+    REQUIRE( !set_cmpl.insert( complex_t( 1.0002, 1.9997 ) ).second );
+    REQUIRE( set_cmpl.insert( complex_t( 1.002, 2.0 ) ).second );
+    REQUIRE( set_cmpl.insert( complex_t( 2.0, 1.0 ) ).second );
+    REQUIRE( set_cmpl.count( complex_t( 2.0001, 0.9999 ) ) == 1 );
+    REQUIRE( set_cmpl.size() == 3 );
+  }
+  SECTION( "key copy throwing in rehash" ) {
+    hash_set<FragileKey, fragile_key_hash> set;
+    for (int i = 0; i < 20; ++i) { set.insert( i ); }
+    const std::size_t buckets = set.bucket_count();
+    FragileKey::assignments_left = 5;
+    REQUIRE_THROWS_AS( set.reserve( 1000 ), std::runtime_error );
+    FragileKey::assignments_left = -1;
+    REQUIRE( set.bucket_count() == buckets );
+    REQUIRE( set.size() == 20 );
+    for (int i = 0; i < 20; ++i) { REQUIRE( set.count( i ) == 1 ); }
+  }
+}
 
-  /* ====================================================================== */
+TEST_CASE( "complex values sorting and deduplication", "[sort]" ) {
+  linarray<complex_t> larr_cmpl{
+    complex_t( 2.0, 1.0 ), complex_t( 1.0, 3.0 ), complex_t( 1.0, -1.0 ),
+    complex_t( 2.0, 1.0 + 1e-12 ), complex_t( -5.0, 0.0 ), complex_t( 1.0, 3.0 )
+  };
+  custom::heap_sort( larr_cmpl.begin(), larr_cmpl.end(), complex_less() );
+  REQUIRE( std::is_sorted( larr_cmpl.cbegin(), larr_cmpl.cend(), complex_less() ) );
+  linarray<complex_t>::iterator last = std::unique( larr_cmpl.begin(),
+    larr_cmpl.end(), complex_grid_equal(1e-9) );
+  larr_cmpl.erase( last, larr_cmpl.cend() );
+  REQUIRE( larr_cmpl.size() == 4 );
+  REQUIRE( larr_cmpl.front() == complex_t( -5.0, 0.0 ) );
+  REQUIRE( larr_cmpl.back() == complex_t( 2.0, 1.0 ) );
+}
 
-  SECTION( "random order, ascending" ) {
-    t_vector test_vec(vec_shuffled);
-    t_linarray_std larr_std(larrstd_shuffled);
-    t_linarray_abc larr_abc(larrabc_shuffled);
-
-    // test_vec
-    const auto test_vec_std_time = time_measure::execution(
-      std::sort<t_vector::iterator>,
-      test_vec.begin(), test_vec.end()
-    );
-    test_vec = vec_shuffled;
-    const auto test_vec_my_time = time_measure::execution(
-      custom::heap_sort<t_vector::iterator>,
-      test_vec.begin(), test_vec.end()
-    );
-
-    // larr_std
-    const auto larr_std_std_time = time_measure::execution(
-      std::sort<t_linarray_std::iterator>,
-      larr_std.begin(), larr_std.end()
-    );
-    larr_std = larrstd_shuffled;
-    const auto larr_std_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_std::iterator>,
-      larr_std.begin(), larr_std.end()
-    );
-
-    // larr_abc
-    const auto larr_abc_std_time = time_measure::execution(
-      std::sort<t_linarray_abc::iterator>,
-      larr_abc.begin(), larr_abc.end()
-    );
-    larr_abc = larrabc_shuffled;
-    const auto larr_abc_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_abc::iterator>,
-      larr_abc.begin(), larr_abc.end()
-    );
+/* ========================================================================== */
 
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_std, test_vec ) );
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_abc, test_vec ) );
+TEST_CASE( "mapped_array", "[mapped]" ) {
+  const char* path = "unittest_mapped.bin";
+  t_vector test_vec{ELEMENTS_SET_FORWARD};
+  {
+    mapped_array<int> marr( path, mapped_array<int>::create );
+    REQUIRE( marr.empty() );
+    for (int i : test_vec) { marr.push_back( i ); }
+    REQUIRE( marr.capacity() == ELEMENTS_CAPACITY );
+    marr.flush();
+  }
+  SECTION( "reopening" ) {
+    const mapped_array<int> marr( path, mapped_array<int>::open_read );
+    REQUIRE( t_vector( marr.cbegin(), marr.cend() ) == test_vec );
+  }
+  SECTION( "growing an existing file" ) {
+    {
+      mapped_array<int> marr( path );
+      marr.append( test_vec.cbegin(), test_vec.cend() );
+      marr.resize( marr.size() + 1, CUSTOM_VALUE );
+    }
+    test_vec.insert( test_vec.end(), test_vec.begin(), test_vec.end() );
+    test_vec.push_back( CUSTOM_VALUE );
+    const mapped_array<int> marr( path, mapped_array<int>::open_read );
+    REQUIRE( t_vector( marr.cbegin(), marr.cend() ) == test_vec );
+    REQUIRE( marr.capacity() == EXACT_CAPACITY( test_vec.size() ) );
+  }
+  SECTION( "read-only mapping" ) {
+    mapped_array<int> marr( path, mapped_array<int>::open_read );
+    REQUIRE_THROWS_AS( marr.pop_back(), std::logic_error );
+    REQUIRE_THROWS_AS( marr.clear(), std::logic_error );
+    REQUIRE_THROWS_AS( marr.push_back( CUSTOM_VALUE ), std::logic_error );
+    REQUIRE_THROWS_AS( marr[0] = CUSTOM_VALUE, std::logic_error );
+    REQUIRE_THROWS_AS( marr.data(), std::logic_error );
+    REQUIRE( t_vector( marr.cbegin(), marr.cend() ) == test_vec );
+  }
+  SECTION( "type mismatch" ) {
+    REQUIRE_THROWS_AS( mapped_array<double>( path ), std::runtime_error );
+    REQUIRE_THROWS_AS( mapped_array<int>( "no/such/file.bin" ), std::system_error );
+  }
+  std::remove( path );
+}
 
-    std::cout << "random order, ascending:"
-      << "\n  std::vector"
-      << "\n    std::sort: " << test_vec_std_time
-      << "\n    custom::heap_sort: " << test_vec_my_time
-      << "\n  linarray (std::allocator)"
-      << "\n    std::sort: " << larr_std_std_time
-      << "\n    custom::heap_sort: " << larr_std_my_time
-      << "\n  linarray (abc_allocator)"
-      << "\n    std::sort: " << larr_abc_std_time
-      << "\n    custom::heap_sort: " << larr_abc_my_time
-      << "\n" << std::endl;
+/* ========================================================================== */
+
+TEST_CASE( "binary serialization", "[io]" ) {
+  const char* path = "unittest_io.bin";
+  const t_vector test_vec{ELEMENTS_SET_FORWARD};
+  const linarray<int> larr( test_vec.cbegin(), test_vec.cend() );
+
+  SECTION( "file round trip" ) {
+    for (bool direct : {false, true}) {
+      linarray_io::save_file( larr, path, direct );
+      linarray<int> loaded( 3, CUSTOM_VALUE );
+      linarray_io::load_file( loaded, path, direct );
+      REQUIRE( t_vector( loaded.cbegin(), loaded.cend() ) == test_vec );
+    }
   }
-  SECTION( "random order, descending" ) {
-    t_vector test_vec(vec_shuffled);
-    t_linarray_std larr_std(larrstd_shuffled);
-    t_linarray_abc larr_abc(larrabc_shuffled);
-
-    // test_vec
-    const auto test_vec_std_time = time_measure::execution(
-      std::sort<t_vector::reverse_iterator>,
-      test_vec.rbegin(), test_vec.rend()
-    );
-    test_vec = vec_shuffled;
-    const auto test_vec_my_time = time_measure::execution(
-      custom::heap_sort<t_vector::reverse_iterator>,
-      test_vec.rbegin(), test_vec.rend()
-    );
-
-    // larr_std
-    const auto larr_std_std_time = time_measure::execution(
-      std::sort<t_linarray_std::reverse_iterator>,
-      larr_std.rbegin(), larr_std.rend()
-    );
-    larr_std = larrstd_shuffled;
-    const auto larr_std_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_std::reverse_iterator>,
-      larr_std.rbegin(), larr_std.rend()
-    );
-
-    // larr_abc
-    const auto larr_abc_std_time = time_measure::execution(
-      std::sort<t_linarray_abc::reverse_iterator>,
-      larr_abc.rbegin(), larr_abc.rend()
-    );
-    larr_abc = larrabc_shuffled;
-    const auto larr_abc_my_time = time_measure::execution(
-      custom::heap_sort<t_linarray_abc::reverse_iterator>,
-      larr_abc.rbegin(), larr_abc.rend()
-    );
+  SECTION( "stream round trip" ) {
+    std::stringstream stream;
+    linarray_io::save( larr, stream );
+    REQUIRE( stream.str().size() == 64 + test_vec.size() * sizeof(int) );
+    linarray<int> loaded;
+    linarray_io::load( loaded, stream );
+    REQUIRE( t_vector( loaded.cbegin(), loaded.cend() ) == test_vec );
+  }
+  SECTION( "empty array" ) {
+    linarray_io::save_file( linarray<int>(), path );
+    linarray<int> loaded( 3 );
+    linarray_io::load_file( loaded, path );
+    REQUIRE( loaded.empty() );
+  }
+  SECTION( "reading in chunks" ) {
+    linarray_io::save_file( larr, path );
+    for (bool direct : {false, true}) {
+      linarray_io::chunk_reader<int> reader( path, direct );
+      REQUIRE( reader.header().count == test_vec.size() );
+      t_vector read_vec;
+      linarray<int> chunk;
+      while ( reader.next( chunk, 3 ) > 0 ) {
+        REQUIRE( chunk.size() <= 3 );
+        read_vec.insert( read_vec.end(), chunk.cbegin(), chunk.cend() );
+      }
+      REQUIRE( read_vec == test_vec );
+    }
+  }
+  SECTION( "bad files" ) {
+    linarray_io::save_file( larr, path );
+    linarray<double> wrong_type;
+    REQUIRE_THROWS_AS( linarray_io::load_file( wrong_type, path ),
+      std::runtime_error );
+    {
+      std::fstream file( path, std::ios::in | std::ios::out | std::ios::binary );
+      file.seekp( 64 );
+      file.put( 0x55 );
+    }
+    linarray<int> loaded;
+    REQUIRE_THROWS_AS( linarray_io::load_file( loaded, path ),
+      std::runtime_error );
+    REQUIRE_THROWS_AS( linarray_io::load_file( loaded, "no/such/file.bin" ),
+      std::system_error );
+    std::stringstream truncated( std::string( 10, 'x' ) );
+    REQUIRE_THROWS_AS( linarray_io::load( loaded, truncated ),
+      std::runtime_error );
+  }
+  std::remove( path );
+}
 
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_std, test_vec ) );
-    REQUIRE( IS_EQUAL_CONTAINERS( larr_abc, test_vec ) );
+/* ========================================================================== */
+
+typedef segmented_array<IntElement> t_segarray_std;
+typedef segmented_array<IntElement, abc_allocator<IntElement>> t_segarray_abc;
+
+// an IntElement that cannot be built from a negative value
+class CheckedElement : public IntElement {
+  public:
+    CheckedElement( int val = 0 ) : IntElement( check( val ) ) {}
+
+  private:
+    static int check( int val ) {
+      if ( val < 0 ) { throw std::invalid_argument( "CheckedElement" ); }
+      return val;
+    }
+};
+
+TEST_CASE( "linarray exception safety", "[except]" ) {
+  const int ref_count = IntElement::RefCount;
+  t_vector values{ 1, 2, 3, -1, 5 };
+  REQUIRE_THROWS_AS( linarray<CheckedElement>( values.cbegin(),
+    values.cend() ), std::invalid_argument );
+  REQUIRE( IntElement::RefCount == ref_count );
+
+  values[3] = 4;
+  linarray<CheckedElement> larr( values.cbegin(), values.cend() );
+  larr = static_cast<const linarray<CheckedElement>&>( larr );
+  REQUIRE( IS_EQUAL_CONTAINERS( larr, values ) );
+  REQUIRE( IntElement::RefCount == ref_count + 5 );
+}
+
+TEST_CASE( "segmented_array", "[segmented]" ) {
+  const t_vector test_vec{ELEMENTS_SET_SHUFFLED};
+
+  SECTION( "construction and destruction" ) {
+    const int ref_count = IntElement::RefCount;
+    {
+      t_segarray_std sarr( test_vec.cbegin(), test_vec.cend() );
+      REQUIRE( IntElement::RefCount - ref_count
+        == static_cast<int>( test_vec.size() ) );
+      REQUIRE( IS_EQUAL_CONTAINERS( sarr, test_vec ) );
+      REQUIRE( sarr.capacity() == EXACT_CAPACITY( test_vec.size() ) );
+
+      t_segarray_abc sarr_fill( 40, IntElement(CUSTOM_VALUE) );
+      REQUIRE( sarr_fill.size() == 40 );
+      REQUIRE( sarr_fill.front() == CUSTOM_VALUE );
+      REQUIRE( sarr_fill.back() == CUSTOM_VALUE );
+
+      t_segarray_std sarr_copy( sarr );
+      sarr_copy = {1, 2, 3};
+      REQUIRE( sarr_copy.size() == 3 );
+      // segments are kept for reuse
+      REQUIRE( sarr_copy.capacity() == sarr.capacity() );
+    }
+    REQUIRE( IntElement::RefCount == ref_count );
+  }
+  SECTION( "stable references while growing" ) {
+    t_segarray_std sarr;
+    sarr.push_back( CUSTOM_VALUE );
+    const IntElement* first = &sarr.front();
+    for (int i : test_vec) { sarr.emplace_back( i ); }
+    sarr.resize( 1000, IntElement(1) );
+    REQUIRE( first == &sarr.front() );
+    REQUIRE( sarr.capacity() == 1024 );
+    REQUIRE( sarr.segments() == 7 );
+
+    size_type in_segments = 0;
+    for (unsigned seg = 0; seg < sarr.segments(); ++seg) {
+      in_segments += sarr.segment_size( seg );
+    }
+    REQUIRE( in_segments == sarr.size() );
 
-    std::cout << "random order, descending:"
-      << "\n  std::vector"
-      << "\n    std::sort: " << test_vec_std_time
-      << "\n    custom::heap_sort: " << test_vec_my_time
-      << "\n  linarray (std::allocator)"
-      << "\n    std::sort: " << larr_std_std_time
-      << "\n    custom::heap_sort: " << larr_std_my_time
-      << "\n  linarray (abc_allocator)"
-      << "\n    std::sort: " << larr_abc_std_time
-      << "\n    custom::heap_sort: " << larr_abc_my_time
-      << "\n" << std::endl;
+    sarr.resize( 10 );
+    sarr.shrink_to_fit();
+    REQUIRE( sarr.capacity() == t_segarray_std::first_segment );
+    REQUIRE( sarr.back() == test_vec[8] );
+  }
+  SECTION( "random access iterators" ) {
+    t_segarray_abc sarr( test_vec.cbegin(), test_vec.cend() );
+    t_vector sorted_vec( test_vec );
+    std::sort( sorted_vec.begin(), sorted_vec.end() );
+    custom::heap_sort( sarr.begin(), sarr.end() );
+    REQUIRE( IS_EQUAL_CONTAINERS( sarr, sorted_vec ) );
+    REQUIRE( std::equal( sarr.crbegin(), sarr.crend(), sorted_vec.crbegin() ) );
+    REQUIRE( std::distance( sarr.cbegin(), sarr.cend() )
+      == static_cast<std::ptrdiff_t>( sarr.size() ) );
+    REQUIRE( *(sarr.cbegin() + 100) == sorted_vec[100] );
+  }
+  SECTION( "throwing constructors" ) {
+    const int ref_count = IntElement::RefCount;
+    t_vector values( test_vec );
+    values[100] = -1;
+    REQUIRE_THROWS_AS( segmented_array<CheckedElement>( values.cbegin(),
+      values.cend() ), std::invalid_argument );
+    REQUIRE( IntElement::RefCount == ref_count );
   }
 }
 
+/* ========================================================================== */
+
+// fails the allocations of 64 elements or more while fail is set
+struct allocation_switch { static bool fail; };
+bool allocation_switch::fail = false;
 
+template< typename T >
+struct failing_allocator {
+  typedef T value_type;
+
+  failing_allocator() {}
+  template< typename U >
+  failing_allocator( const failing_allocator<U>& ) {}
+
+  T* allocate( std::size_t cnt ) {
+    if ( allocation_switch::fail && cnt >= 64 ) { throw std::bad_alloc(); }
+    return static_cast<T*>( ::operator new( cnt * sizeof(T) ) );
+  }
+  void deallocate( T* p, std::size_t ) { ::operator delete(p); }
+};
+
+template< typename T, typename U >
+bool operator== ( const failing_allocator<T>&, const failing_allocator<U>& ) {
+  return true;
+}
+
+template< typename T, typename U >
+bool operator!= ( const failing_allocator<T>&, const failing_allocator<U>& ) {
+  return false;
+}
+
+TEST_CASE( "concurrent_array", "[concurrent]" ) {
+  const int producers = 8, per_producer = 10000;
+  concurrent_array<int> carr;
+
+  SECTION( "appending from many threads" ) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < producers; ++t) {
+      threads.emplace_back( [&carr, t]() {
+        for (int i = 0; i < per_producer; ++i) {
+          const size_type pos = carr.push_back( t * per_producer + i );
+          if ( carr[pos] != t * per_producer + i ) { return; }
+        }
+      } );
+    }
+    for (std::thread& thread : threads) { thread.join(); }
+    REQUIRE( carr.size() == static_cast<size_type>( producers * per_producer ) );
+
+    linarray<int> sealed = carr.seal();
+    REQUIRE( carr.empty() );
+    custom::heap_sort( sealed.begin(), sealed.end() );
+    t_vector expected( producers * per_producer );
+    std::iota( expected.begin(), expected.end(), 0 );
+    REQUIRE( IS_EQUAL_CONTAINERS( sealed, expected ) );
+  }
+  SECTION( "stable references" ) {
+    carr.reserve( 100 );
+    const int* first = &carr[ carr.emplace_back( CUSTOM_VALUE ) ];
+    for (int i = 0; i < per_producer; ++i) { carr.push_back( i ); }
+    REQUIRE( first == &carr[0] );
+    REQUIRE( carr[0] == CUSTOM_VALUE );
+    REQUIRE( carr[per_producer] == per_producer - 1 );
+  }
+  SECTION( "throwing constructors" ) {
+    const int ref_count = IntElement::RefCount;
+    {
+      concurrent_array<CheckedElement> checked;
+      t_vector expected;
+      for (int i = 0; i < 40; ++i) {
+        try {
+          checked.emplace_back( (i % 5 == 0) ? -1 : i );
+          expected.push_back( i );
+        } catch (const std::invalid_argument&) {}
+      }
+      REQUIRE( checked.size() == 40 );
+      REQUIRE( IntElement::RefCount - ref_count == 32 );
+
+      // the failed slots are skipped
+      const linarray<CheckedElement> sealed = checked.seal();
+      REQUIRE( IS_EQUAL_CONTAINERS( sealed, expected ) );
+      REQUIRE( IntElement::RefCount - ref_count == 32 );
+
+      REQUIRE_THROWS_AS( checked.emplace_back( -1 ), std::invalid_argument );
+      checked.emplace_back( 1 );
+      checked.clear();
+      REQUIRE( checked.empty() );
+    }
+    REQUIRE( IntElement::RefCount == ref_count );
+  }
+  SECTION( "failed segment allocations" ) {
+    concurrent_array< int, failing_allocator<int> > failing;
+    allocation_switch::fail = true;
+    for (int i = 0; i < 64; ++i) { failing.push_back( i ); }
+    // the fourth segment holds 64 elements, its producers all throw
+    REQUIRE_THROWS_AS( failing.push_back( 64 ), std::bad_alloc );
+    REQUIRE_THROWS_AS( failing.push_back( 65 ), std::bad_alloc );
+    allocation_switch::fail = false;
+    REQUIRE( failing.size() == 66 );
+
+    linarray< int, failing_allocator<int> > sealed = failing.seal();
+    t_vector expected( 64 );
+    std::iota( expected.begin(), expected.end(), 0 );
+    REQUIRE( IS_EQUAL_CONTAINERS( sealed, expected ) );
+
+    // clear() forgets the failure
+    for (int i = 0; i < 100; ++i) { failing.push_back( i ); }
+    REQUIRE( failing[99] == 99 );
+  }
+}
+
+/* ========================================================================== */
+
+TEST_CASE( "numa_allocator", "[numa]" ) {
+  REQUIRE( numa::node_count() >= 1 );
+  const size_type large_count = 1 << 20;
+  for (numa::placement where : { numa::first_touch, numa::interleaved,
+                                 numa::on_node })
+  {
+    typedef linarray< double, numa_allocator<double> > t_numa_linarray;
+    t_numa_linarray larr( large_count, default_init,
+      numa_allocator<double>( where ) );
+    numa::parallel_fill( larr.begin(), larr.end(), 0.5, 3 );
+    REQUIRE( std::count( larr.cbegin(), larr.cend(), 0.5 )
+      == static_cast<std::ptrdiff_t>( large_count ) );
+
+    t_numa_linarray larr_small( 3, 1.0, larr.get_allocator() );
+    larr_small.append( larr.cbegin(), larr.cbegin() + 2 );
+    REQUIRE( IS_EQUAL_CONTAINERS( larr_small,
+      std::vector<double>{ 1.0, 1.0, 1.0, 0.5, 0.5 } ) );
+  }
+}
+
+static long FIB( shared::thread_pool& pool, int n ) {
+  if ( n < 2 ) { return n; }
+  long a = 0;
+  shared::task_group group( pool );
+  group.spawn( [&]() { a = FIB( pool, n - 1 ); } );
+  const long b = FIB( pool, n - 2 );
+  group.sync();
+  return a + b;
+}
+
+TEST_CASE( "work-stealing thread pool", "[parallel]" ) {
+  shared::thread_pool pool( 4, true );
+  REQUIRE( pool.size() == 4 );
+  REQUIRE( pool.is_pinned() );
+  REQUIRE( FIB( pool, 20 ) == 6765 );
+  shared::thread_pool serial( 1 );
+  REQUIRE( FIB( serial, 20 ) == 6765 );
+
+  // more tasks than a deque holds at first, from nested loops
+  std::atomic<int> calls( 0 );
+  pool.parallel_for( 1000, [&]( std::size_t ) {
+    pool.parallel_for( 10, [&]( std::size_t ) { ++calls; } );
+  } );
+  REQUIRE( calls.load() == 10000 );
+
+  // spawns from several threads outside the pool at once
+  std::vector<std::thread> producers;
+  std::atomic<int> sum( 0 );
+  for (int t = 0; t < 3; ++t) {
+    producers.emplace_back( [&]() {
+      shared::task_group group( pool );
+      for (int i = 1; i <= 100; ++i) { group.spawn( [&sum, i]() { sum += i; } ); }
+      group.sync();
+    } );
+  }
+  for (std::thread& producer : producers) { producer.join(); }
+  REQUIRE( sum.load() == 3 * 5050 );
+
+  // the first error is rethrown once, after all tasks are done
+  calls = 0;
+  shared::task_group group( pool );
+  for (int i = 0; i < 50; ++i) {
+    group.spawn( [&calls, i]() {
+      ++calls;
+      if ( i % 10 == 0 ) { throw std::runtime_error( "task" ); }
+    } );
+  }
+  REQUIRE_THROWS_AS( group.sync(), std::runtime_error );
+  REQUIRE( calls.load() == 50 );
+  REQUIRE_NOTHROW( group.sync() );
+
+  for (shared::thread_pool* p : { &pool, &serial }) {
+    std::vector<int> data( 20000 );
+    std::mt19937 gen( 7 );
+    for (int& value : data) { value = static_cast<int>( gen() % 1000 ); }
+    std::vector<int> expected( data );
+    std::sort( expected.begin(), expected.end() );
+    custom::parallel_sort( data.begin(), data.end(), *p, 100 );
+    REQUIRE( data == expected );
+    custom::parallel_sort( data.begin(), data.end(), std::greater<int>(), *p );
+    REQUIRE( std::is_sorted( data.crbegin(), data.crend() ) );
+  }
+}
+
+TEST_CASE( "parallel algorithms", "[parallel]" ) {
+  const size_type large_count = 100003;   // not a multiple of any grain
+  shared::thread_pool pool( 4 );
+  REQUIRE( pool.size() == 4 );
+
+  linarray<long> larr( large_count );
+  std::iota( larr.begin(), larr.end(), 1 );
+  std::vector<long> expected( larr.cbegin(), larr.cend() );
+
+  custom::parallel_for_each( larr.begin(), larr.end(),
+    []( long& value ) { value *= 2; }, pool );
+  for (long& value : expected) { value *= 2; }
+  REQUIRE( IS_EQUAL_CONTAINERS( larr, expected ) );
+
+  linarray<double> halves( large_count );
+  REQUIRE( custom::parallel_transform( larr.cbegin(), larr.cend(),
+    halves.begin(), []( long value ) { return value / 2.0; }, pool )
+    == halves.end() );
+  REQUIRE( halves.front() == 1.0 );
+  REQUIRE( halves.back() == static_cast<double>( large_count ) );
+
+  const long sum = static_cast<long>( large_count ) * (large_count + 1);
+  REQUIRE( custom::parallel_reduce( larr.cbegin(), larr.cend(), 0L, pool )
+    == sum );
+  REQUIRE( custom::parallel_reduce( larr.cbegin(), larr.cend(), 5L,
+    []( long a, long b ) { return std::max( a, b ); }, pool )
+    == static_cast<long>( 2 * large_count ) );
+
+  // not commutative: partial results must be combined in order
+  const std::vector<std::string> words{ "a", "b", "c", "d", "e", "f", "g" };
+  REQUIRE( custom::parallel_reduce( words.cbegin(), words.cend(),
+    std::string( ">" ), std::plus<std::string>(), pool, 2 ) == ">abcdefg" );
+
+  std::partial_sum( expected.cbegin(), expected.cend(), expected.begin() );
+  linarray<long> scanned( large_count );
+  custom::parallel_inclusive_scan( larr.cbegin(), larr.cend(),
+    scanned.begin(), pool );
+  REQUIRE( IS_EQUAL_CONTAINERS( scanned, expected ) );
+  // in place, with small grains and on the shared pool
+  custom::parallel_inclusive_scan( larr.begin(), larr.end(), larr.begin(),
+    std::plus<long>(), shared::thread_pool::instance(), 7 );
+  REQUIRE( IS_EQUAL_CONTAINERS( larr, expected ) );
+
+  // empty ranges, a serial pool, errors from the loop body
+  linarray<long> empty_larr;
+  REQUIRE( custom::parallel_reduce( empty_larr.cbegin(), empty_larr.cend(),
+    3L, pool ) == 3 );
+  REQUIRE( custom::parallel_inclusive_scan( empty_larr.cbegin(),
+    empty_larr.cend(), empty_larr.begin(), pool ) == empty_larr.begin() );
+  shared::thread_pool serial( 1 );
+  REQUIRE( serial.size() == 1 );
+  REQUIRE( custom::parallel_reduce( larr.cbegin(), larr.cend(), 0L, serial )
+    == custom::parallel_reduce( larr.cbegin(), larr.cend(), 0L, pool ) );
+  REQUIRE_THROWS_AS( custom::parallel_for_each( larr.begin(), larr.end(),
+    []( long& value ) {
+      if ( value == 42 ) { throw std::runtime_error( "42" ); }
+    }, pool, 16 ), std::runtime_error );
+}
+
+TEST_CASE( "flat_set and flat_map", "[flat]" ) {
+  flat_set<int> set{ 5, 3, 9, 3, 1, 5, 7 };
+  REQUIRE( IS_EQUAL_CONTAINERS( set.sequence(), t_vector{ 1, 3, 5, 7, 9 } ) );
+  REQUIRE( set.contains( 7 ) );
+  REQUIRE( !set.contains( 4 ) );
+  REQUIRE( set.count( 3 ) == 1 );
+  REQUIRE( *set.lower_bound( 4 ) == 5 );
+  REQUIRE( *set.upper_bound( 5 ) == 7 );
+  REQUIRE( set.find( 8 ) == set.cend() );
+  REQUIRE( std::distance( set.equal_range( 9 ).first,
+    set.equal_range( 9 ).second ) == 1 );
+
+  REQUIRE( set.insert( 4 ).second );
+  REQUIRE( !set.insert( 4 ).second );
+  REQUIRE( *set.insert( 4 ).first == 4 );
+  REQUIRE( set.emplace( 0 ).second );
+  // batch merged into the table, duplicates within and across dropped
+  const t_vector batch{ 10, 2, 9, 2, 8, 0 };
+  set.insert( batch.cbegin(), batch.cend() );
+  REQUIRE( IS_EQUAL_CONTAINERS( set.sequence(),
+    t_vector{ 0, 1, 2, 3, 4, 5, 7, 8, 9, 10 } ) );
+  REQUIRE( set.erase( 3 ) == 1 );
+  REQUIRE( set.erase( 3 ) == 0 );
+  REQUIRE( *set.erase( set.find( 8 ) ) == 9 );
+  REQUIRE( set.erase_if( []( int k ) { return k % 2 == 1; } ) == 4 );
+  REQUIRE( IS_EQUAL_CONTAINERS( set.sequence(), t_vector{ 0, 2, 4, 10 } ) );
+  REQUIRE( set == flat_set<int>( { 10, 4, 2, 0 } ) );
+
+  flat_set< int, std::greater<int> > descending{ 1, 3, 2 };
+  REQUIRE( IS_EQUAL_CONTAINERS( descending.sequence(), t_vector{ 3, 2, 1 } ) );
+  REQUIRE( *descending.lower_bound( 2 ) == 2 );
+
+  // heterogeneous lookup, without building std::string keys
+  flat_set< std::string, transparent_less > names{ "delta", "alpha", "charlie" };
+  REQUIRE( names.contains( "alpha" ) );
+  REQUIRE( names.count( "bravo" ) == 0 );
+  REQUIRE( *names.lower_bound( "b" ) == "charlie" );
+
+  // a large bulk build
+  std::vector<int> keys( 20000 );
+  std::mt19937 gen( 11 );
+  for (int& key : keys) { key = static_cast<int>( gen() % 5000 ); }
+  flat_set<int> large( keys.cbegin(), keys.cend() );
+  std::sort( keys.begin(), keys.end() );
+  keys.erase( std::unique( keys.begin(), keys.end() ), keys.end() );
+  REQUIRE( IS_EQUAL_CONTAINERS( large.sequence(), keys ) );
+
+  flat_map< std::string, int, transparent_less > map{
+    { "one", 1 }, { "three", 3 }, { "two", 2 } };
+  REQUIRE( map.size() == 3 );
+  REQUIRE( map.at( "two" ) == 2 );
+  REQUIRE_THROWS_AS( map.at( "four" ), std::out_of_range );
+  REQUIRE( map.find( "three" )->second == 3 );
+  map["four"] = 4;
+  ++map["one"];
+  REQUIRE( map.at( "one" ) == 2 );
+  REQUIRE( !map.try_emplace( "four", 40 ).second );
+  REQUIRE( map.at( "four" ) == 4 );
+  REQUIRE( !map.insert_or_assign( "four", 44 ).second );
+  REQUIRE( map.insert_or_assign( "five", 5 ).second );
+  REQUIRE( map.at( "four" ) == 44 );
+  map.find( "two" )->second = 22;
+  // the keys already in the map win over the batch
+  const std::vector< std::pair<std::string, int> > updates{
+    { "six", 6 }, { "two", -2 }, { "six", -6 } };
+  map.insert( updates.cbegin(), updates.cend() );
+  REQUIRE( map.size() == 6 );
+  REQUIRE( map.at( "two" ) == 22 );
+  REQUIRE( std::abs( map.at( "six" ) ) == 6 );
+  std::string order;
+  for (const auto& entry : map) { order += entry.first + " "; }
+  REQUIRE( order == "five four one six three two " );
+  REQUIRE( map.erase( "six" ) == 1 );
+  REQUIRE( !map.contains( "six" ) );
+}
+
+template< class T >
+static void CHECK_SEARCH_INDEX( size_type count, int spread ) {
+  std::mt19937 gen( static_cast<unsigned>( count ) );
+  std::uniform_int_distribution<int> value( -spread, spread );
+  linarray<T> keys( count );
+  for (T& key : keys) { key = static_cast<T>( value(gen) ); }
+  std::sort( keys.begin(), keys.end() );
+  if ( count > 2 ) { keys.back() = std::numeric_limits<T>::max(); }
+
+  const static_search_index<T> index( keys.cbegin(), keys.cend() );
+  REQUIRE( index.size() == count );
+  std::vector<T> queries{ std::numeric_limits<T>::lowest(),
+                          std::numeric_limits<T>::max() };
+  for (int q = -spread - 2; q <= spread + 2; ++q) {
+    queries.push_back( static_cast<T>( q ) );
+  }
+  if ( std::numeric_limits<T>::has_infinity ) {
+    queries.push_back( std::numeric_limits<T>::infinity() );
+    queries.push_back( -std::numeric_limits<T>::infinity() );
+    queries.push_back( std::numeric_limits<T>::quiet_NaN() );
+  }
+  std::vector<size_type> expected, batched( queries.size() + 1, 99 );
+  for (const T& q : queries) {
+    expected.push_back( std::lower_bound( keys.cbegin(), keys.cend(), q )
+      - keys.cbegin() );
+  }
+  bool single_ok = true;
+  for (size_type i = 0; i < queries.size(); ++i) {
+    single_ok = single_ok && index.lower_bound( queries[i] ) == expected[i];
+  }
+  REQUIRE( single_ok );
+  REQUIRE( index.lower_bound( queries.cbegin(), queries.cend(),
+    batched.begin() ) == batched.end() - 1 );
+  batched.pop_back();
+  REQUIRE( batched == expected );
+}
+
+TEST_CASE( "static search index", "[search]" ) {
+  for (size_type count : { 0, 1, 2, 15, 16, 17, 273, 290, 5000, 100000 }) {
+    CHECK_SEARCH_INDEX<int>( count, 3 * static_cast<int>( count ) / 2 + 1 );
+    CHECK_SEARCH_INDEX<long long>( count, static_cast<int>( count ) / 3 + 1 );
+    CHECK_SEARCH_INDEX<double>( count, static_cast<int>( count ) + 1 );
+  }
+
+  const linarray<int> keys{ 2, 3, 5, 7, 11, 13 };
+  static_search_index<int> index( keys.cbegin(), keys.cend() );
+  REQUIRE( index.height() == 0 );
+  REQUIRE( index.contains( 7 ) );
+  REQUIRE( !index.contains( 8 ) );
+  REQUIRE( index[ index.lower_bound( 8 ) ] == 11 );
+  linarray<int> many( 1000 );
+  std::iota( many.begin(), many.end(), 0 );
+  index.build( many.cbegin(), many.cend() );
+  REQUIRE( index.height() == 2 );
+  REQUIRE( index.lower_bound( 500 ) == 500 );
+  REQUIRE( !index.contains( 1000 ) );
+
+  // no query descends past the padding, +infinity and NaN included
+  linarray<double> reals( 40 );
+  std::iota( reals.begin(), reals.end(), 0.5 );
+  const double inf = std::numeric_limits<double>::infinity();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  static_search_index<double> real_index( reals.cbegin(), reals.cend() );
+  REQUIRE( real_index.lower_bound( inf ) == 40 );
+  REQUIRE( real_index.lower_bound( nan ) == 0 );
+  REQUIRE( !real_index.contains( nan ) );
+  reals.back() = inf;
+  real_index.build( reals.cbegin(), reals.cend() );
+  REQUIRE( real_index.lower_bound( inf ) == 39 );
+  REQUIRE( real_index.contains( inf ) );
+}
+
+TEST_CASE( "ring_buffer", "[ring]" ) {
+  const int ref_count = IntElement::RefCount;
+  {
+    ring_buffer<IntElement> ring;
+    REQUIRE( ring.empty() );
+    REQUIRE( ring.capacity() == 0 );
+    for (int i = 0; i < 5; ++i) { ring.push_back( i ); }
+    REQUIRE( ring.capacity() == 8 );
+    // FIFO through the wrap-around, without growing
+    for (int i = 5; i < 100; ++i) {
+      REQUIRE( ring.front() == i - 5 );
+      ring.pop_front();
+      ring.push_back( i );
+    }
+    REQUIRE( ring.capacity() == 8 );
+    REQUIRE( IS_EQUAL_CONTAINERS( ring,
+      std::vector<IntElement>{ 95, 96, 97, 98, 99 } ) );
+    ring.push_front( 94 );
+    ring.emplace_front( 93 );
+    ring.push_back( 100 );
+    ring.push_back( 101 );    // grows while wrapped
+    REQUIRE( ring.capacity() == 16 );
+    REQUIRE( ring.size() == 9 );
+    REQUIRE( ring.front() == 93 );
+    REQUIRE( ring.back() == 101 );
+    ring.pop_back();
+    REQUIRE( ring.back() == 100 );
+    REQUIRE( IntElement::RefCount == ref_count + 8 );
+
+    ring_buffer<IntElement> copy( ring );
+    REQUIRE( IS_EQUAL_CONTAINERS( copy, ring ) );
+    copy.clear();
+    REQUIRE( copy.empty() );
+    copy = ring;
+    REQUIRE( std::equal( copy.crbegin(), copy.crend(), ring.crbegin() ) );
+  }
+  REQUIRE( IntElement::RefCount == ref_count );
+
+  // a constructor that throws releases the elements built so far
+  const t_vector values{ 1, 2, 3, -1, 5 };
+  REQUIRE_THROWS_AS( ring_buffer<CheckedElement>( values.cbegin(),
+    values.cend() ), std::invalid_argument );
+  REQUIRE( IntElement::RefCount == ref_count );
+
+  // sorting through the random access iterators of a wrapped buffer
+  ring_buffer<int> ints{ 5, 1, 4 };
+  for (int value : { 9, 2, 8, 3 }) { ints.push_front( value ); }
+  custom::heap_sort( ints.begin(), ints.end() );
+  REQUIRE( IS_EQUAL_CONTAINERS( ints, t_vector{ 1, 2, 3, 4, 5, 8, 9 } ) );
+  REQUIRE( std::is_sorted( ints.cbegin(), ints.cend() ) );
+  REQUIRE( ints.cend() - ints.cbegin() == 7 );
+
+  const int* block = ints.linearize();
+  REQUIRE( std::equal( block, block + ints.size(), t_vector{ 1, 2, 3, 4, 5, 8, 9 }.begin() ) );
+  ints.push_back( 10 );           // full: rotated in place
+  ints.pop_front();
+  ints.push_back( 11 );
+  block = ints.linearize();
+  REQUIRE( ints.capacity() == 8 );
+  REQUIRE( std::equal( block, block + 8,
+    t_vector{ 2, 3, 4, 5, 8, 9, 10, 11 }.begin() ) );
+
+  // bounded: the oldest entries are overwritten
+  ring_buffer<IntElement> last;
+  last.set_limit( 3 );
+  REQUIRE( last.capacity() == 4 );
+  for (int i = 0; i < 10; ++i) { last.push_back( i ); }
+  REQUIRE( last.full() );
+  REQUIRE( IS_EQUAL_CONTAINERS( last, std::vector<IntElement>{ 7, 8, 9 } ) );
+  last.push_front( 6 );           // drops the newest
+  REQUIRE( IS_EQUAL_CONTAINERS( last, std::vector<IntElement>{ 6, 7, 8 } ) );
+  last.set_limit( 2 );
+  REQUIRE( IS_EQUAL_CONTAINERS( last, std::vector<IntElement>{ 7, 8 } ) );
+  last.set_limit( 0 );
+  for (int i = 9; i < 20; ++i) { last.push_back( i ); }
+  REQUIRE( last.size() == 13 );
+  last.resize( 2 );
+  last.shrink_to_fit();
+  REQUIRE( last.capacity() == 2 );
+  REQUIRE( IS_EQUAL_CONTAINERS( last, std::vector<IntElement>{ 7, 8 } ) );
+  last.clear();
+  REQUIRE( IntElement::RefCount == ref_count );
+}
+
+/* ========================================================================== */
+
+TEST_CASE( "cow_array", "[cow]" ) {
+  // 16 elements per chunk
+  typedef cow_array< IntElement, std::allocator<IntElement>,
+    16 * sizeof(IntElement) > t_cowarray;
+  const t_vector test_vec{ELEMENTS_SET_SHUFFLED};
+  const int ref_count = IntElement::RefCount;
+  {
+    t_cowarray arr( test_vec.cbegin(), test_vec.cend() );
+    REQUIRE( IS_EQUAL_CONTAINERS( arr, test_vec ) );
+    REQUIRE( arr.chunks() == (test_vec.size() + 15) / 16 );
+    REQUIRE( arr.shared_chunks() == 0 );
+    // chunks hold a power of two elements, as linarray allocates
+    REQUIRE( (cow_array< std::array<char, 12> >::chunk_capacity == 4096) );
+    REQUIRE( IntElement::RefCount - ref_count
+      == static_cast<int>( test_vec.size() ) );
+
+    // a snapshot shares every element
+    const t_cowarray snap = arr.snapshot();
+    REQUIRE( IntElement::RefCount - ref_count
+      == static_cast<int>( test_vec.size() ) );
+    REQUIRE( arr.shared_chunks() == arr.chunks() );
+    REQUIRE( &snap[20] == &static_cast<const t_cowarray&>(arr)[20] );
+
+    // one write copies the table and one chunk
+    arr[20] = CUSTOM_VALUE;
+    REQUIRE( IntElement::RefCount - ref_count
+      == static_cast<int>( test_vec.size() ) + 16 );
+    REQUIRE( !arr.is_shared( 1 ) );
+    REQUIRE( arr.is_shared( 0 ) );
+    REQUIRE( arr.shared_chunks() == arr.chunks() - 1 );
+    REQUIRE( snap[20] == test_vec[20] );
+    REQUIRE( IS_EQUAL_CONTAINERS( snap, test_vec ) );
+    arr[21] = CUSTOM_VALUE;
+    REQUIRE( IntElement::RefCount - ref_count
+      == static_cast<int>( test_vec.size() ) + 16 );
+
+    // size changes copy only the last chunk
+    arr.push_back( 1 );
+    arr.pop_back();
+    arr.pop_back();
+    REQUIRE( arr.size() == test_vec.size() - 1 );
+    REQUIRE( snap.size() == test_vec.size() );
+    REQUIRE( IS_EQUAL_CONTAINERS( snap, test_vec ) );
+    REQUIRE( arr.shared_chunks() == arr.chunks() - 2 );
+
+    // sorting writes through the iterators, the snapshot is untouched
+    t_vector sorted_vec( test_vec );
+    std::sort( sorted_vec.begin(), sorted_vec.end() );
+    t_cowarray sorted( snap );
+    custom::heap_sort( sorted.begin(), sorted.end() );
+    REQUIRE( IS_EQUAL_CONTAINERS( sorted, sorted_vec ) );
+    REQUIRE( IS_EQUAL_CONTAINERS( snap, test_vec ) );
+    REQUIRE( std::equal( sorted.crbegin(), sorted.crend(), sorted_vec.crbegin() ) );
+    REQUIRE( sorted.shared_chunks() == 0 );
+
+    arr = snap;
+    REQUIRE( IS_EQUAL_CONTAINERS( arr, test_vec ) );
+    arr.clear();
+    REQUIRE( arr.empty() );
+    REQUIRE( arr.chunks() == 0 );
+    REQUIRE( IS_EQUAL_CONTAINERS( snap, test_vec ) );
+  }
+  REQUIRE( IntElement::RefCount == ref_count );
+
+  // a constructor that throws releases the chunks filled so far
+  t_vector values( test_vec );
+  values[100] = -1;
+  REQUIRE_THROWS_AS( (cow_array< CheckedElement, std::allocator<CheckedElement>,
+    16 * sizeof(CheckedElement) >( values.cbegin(), values.cend() )),
+    std::invalid_argument );
+  REQUIRE( IntElement::RefCount == ref_count );
+
+  t_cowarray filled( 40, IntElement(CUSTOM_VALUE) );
+  REQUIRE( filled.chunks() == 3 );
+  REQUIRE( filled.chunk_size( 2 ) == 8 );
+  t_cowarray copy( filled );
+  filled.resize( 20 );
+  REQUIRE( filled.chunks() == 2 );
+  REQUIRE( copy.size() == 40 );
+  filled.resize( 50, IntElement(1) );
+  REQUIRE( filled.chunks() == 4 );
+  REQUIRE( filled[19] == CUSTOM_VALUE );
+  REQUIRE( filled[20] == 1 );
+  REQUIRE( filled.back() == 1 );
+  REQUIRE( copy.back() == CUSTOM_VALUE );
+  filled = { 1, 2, 3 };
+  REQUIRE( IS_EQUAL_CONTAINERS( filled, t_vector{ 1, 2, 3 } ) );
+  REQUIRE( filled.chunk_data( 0 )[2] == 3 );
+
+  // a reader thread keeps its snapshot while the writer goes on
+  cow_array<int> table( 100000, 1 );
+  const cow_array<int> before = table.snapshot();
+  bool consistent = true;
+  std::thread reader( [&before, &consistent]() {
+    for (int round = 0; round < 10; ++round) {
+      consistent &= std::accumulate( before.cbegin(), before.cend(), 0 ) == 100000;
+    }
+  } );
+  for (std::size_t i = 0; i < table.size(); i += 1000) { table[i] = 2; }
+  reader.join();
+  REQUIRE( consistent );
+  REQUIRE( std::accumulate( table.cbegin(), table.cend(), 0 ) == 100100 );
+}
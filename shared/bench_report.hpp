@@ -0,0 +1,400 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <istream>
+#include <iomanip>
+
+#include "benchmark.hpp"
+
+namespace shared {
+
+  /*
+    Machine-readable benchmark results: one record per measured
+    configuration, written as a JSON array of flat objects or as CSV with a
+    header line (picked by file extension). Both formats load back, which
+    is what shared/tools/bench_compare uses to diff two runs.
+    The revision is taken from the BENCH_REVISION environment variable, the
+    BENCH_REVISION macro or "git rev-parse", in this order.
+  */
+
+  struct bench_record {
+    std::string name;
+    std::string element_type;
+    std::string allocator;
+    std::size_t size;
+    bench_stats stats;
+    std::string revision;
+
+    bench_record() : size(0), stats() {}
+
+    bench_record( const std::string& bench_name, const std::string& type,
+      const std::string& alloc, std::size_t count, const bench_stats& s )
+    : name(bench_name), element_type(type), allocator(alloc), size(count),
+      stats(s), revision( current_revision() ) {}
+
+    // identifies the same configuration across result files
+    std::string key() const {
+      std::ostringstream os;
+      os << name << " | " << element_type << " | " << allocator
+         << " | " << size;
+      return os.str();
+    }
+
+    static const std::string& current_revision() {
+      static const std::string revision = find_revision();
+      return revision;
+    }
+
+  private:
+    static std::string find_revision() {
+      if ( const char* env = std::getenv( "BENCH_REVISION" ) ) { return env; }
+      #if defined(BENCH_REVISION)
+        return BENCH_REVISION;
+      #elif defined(__unix__) || defined(__APPLE__)
+        std::string revision;
+        if ( FILE* git = popen( "git rev-parse --short HEAD 2>/dev/null", "r" ) ) {
+          char buffer[64];
+          while ( std::fgets( buffer, sizeof(buffer), git ) ) { revision += buffer; }
+          pclose( git );
+        }
+        while ( !revision.empty() && std::isspace(
+                  static_cast<unsigned char>( revision[revision.size()-1] ) ) )
+          revision.erase( revision.size()-1 );
+        return revision.empty() ? "unknown" : revision;
+      #else
+        return "unknown";
+      #endif
+    }
+  };
+
+  /* ======================================================================== */
+
+  /*
+    One configuration in two runs, compared by median. A change counts only
+    beyond the relative threshold and when Welch's t-test on the sample
+    means rejects equality at the 95% level, so noisy runs don't raise
+    false regressions.
+  */
+  struct bench_change {
+    double ratio;  // after / before, by median
+    double t;      // Welch's t statistic, after - before
+    bool significant;
+    bool regression;
+    bool improvement;
+
+    static bench_change compare( const bench_stats& before,
+      const bench_stats& after, double threshold = 0.05 )
+    {
+      bench_change c = bench_change();
+      c.ratio = (before.median > 0.0) ? after.median / before.median : 1.0;
+
+      const double var_b = before.stddev * before.stddev / before.samples;
+      const double var_a = after.stddev * after.stddev / after.samples;
+      const double se = std::sqrt( var_b + var_a );
+      const double diff = after.mean - before.mean;
+      if ( before.samples < 2 || after.samples < 2 ) {
+        c.significant = false;
+      }
+      else if ( se > 0.0 ) {
+        c.t = diff / se;
+        // Welch-Satterthwaite degrees of freedom
+        const double df = (var_b + var_a) * (var_b + var_a) /
+          ( var_b * var_b / (before.samples - 1) +
+            var_a * var_a / (after.samples - 1) );
+        c.significant = std::fabs(c.t) > t_critical( df );
+      }
+      else {
+        c.significant = (diff != 0.0);
+      }
+      c.regression = c.significant && c.ratio > 1.0 + threshold;
+      c.improvement = c.significant && c.ratio < 1.0 - threshold;
+      return c;
+    }
+
+    // two-sided 95% quantile of Student's t, Cornish-Fisher expansion
+    static double t_critical( double df ) {
+      const double z = 1.959963984540054;
+      const double z2 = z * z;
+      const double z3 = z2 * z, z5 = z3 * z2, z7 = z5 * z2;
+      return z + (z3 + z) / (4 * df)
+        + (5*z5 + 16*z3 + 3*z) / (96 * df * df)
+        + (3*z7 + 19*z5 + 17*z3 - 15*z) / (384 * df * df * df);
+    }
+  };
+
+  /* ======================================================================== */
+
+  class bench_report {
+    private:
+      std::vector<bench_record> s_records;
+      std::string autosave_path;
+
+      typedef std::map<std::string, std::string> fields_t;
+
+    public:
+      // with a path, the report saves itself on destruction
+      explicit bench_report( const char* path = nullptr )
+      : autosave_path( path ? path : "" ) {}
+
+      ~bench_report() {
+        if ( !autosave_path.empty() && !s_records.empty() ) {
+          save( autosave_path );
+        }
+      }
+
+      inline void add( const bench_record& record ) {
+        s_records.push_back( record );
+      }
+
+      inline const std::vector<bench_record>& records() const {
+        return s_records;
+      }
+
+      static bool is_csv( const std::string& path ) {
+        return path.size() >= 4 && path.compare( path.size()-4, 4, ".csv" ) == 0;
+      }
+
+      bool save( const std::string& path ) const {
+        std::ofstream file( path.c_str() );
+        if (!file) { return false; }
+        if ( is_csv(path) ) { write_csv( file ); } else { write_json( file ); }
+        return static_cast<bool>(file);
+      }
+
+      bool load( const std::string& path ) {
+        std::ifstream file( path.c_str() );
+        return file && read( file );
+      }
+
+      // appends records, format detected by content
+      bool read( std::istream& is ) {
+        std::stringstream content;
+        content << is.rdbuf();
+        const std::string text = content.str();
+        const std::size_t first = text.find_first_not_of( " \t\r\n" );
+        if ( first != std::string::npos && text[first] == '[' ) {
+          return read_json( text );
+        }
+        return read_csv( text );
+      }
+
+      /* output */
+
+      void write_json( std::ostream& os ) const {
+        os << std::setprecision(17) << "[";
+        for (std::size_t i = 0; i < s_records.size(); ++i) {
+          const bench_record& r = s_records[i];
+          os << (i ? ",\n  " : "\n  ") << "{"
+             << "\"name\": " << quote_json(r.name)
+             << ", \"element_type\": " << quote_json(r.element_type)
+             << ", \"allocator\": " << quote_json(r.allocator)
+             << ", \"size\": " << r.size
+             << ", \"samples\": " << r.stats.samples
+             << ", \"iterations\": " << r.stats.iterations
+             << ", \"min_ns\": " << r.stats.min
+             << ", \"median_ns\": " << r.stats.median
+             << ", \"mean_ns\": " << r.stats.mean
+             << ", \"stddev_ns\": " << r.stats.stddev
+             << ", \"p99_ns\": " << r.stats.p99;
+          for (unsigned e = 0; e < perf_events_count; ++e) {
+            if ( !r.stats.counters.valid[e] ) { continue; }
+            os << ", \"" << perf_sample::name(e) << "\": "
+               << r.stats.counters.value[e];
+          }
+          os << ", \"revision\": " << quote_json(r.revision) << "}";
+        }
+        os << "\n]\n";
+      }
+
+      void write_csv( std::ostream& os ) const {
+        os << std::setprecision(17)
+           << "name,element_type,allocator,size,samples,iterations,"
+              "min_ns,median_ns,mean_ns,stddev_ns,p99_ns";
+        for (unsigned e = 0; e < perf_events_count; ++e) {
+          os << "," << perf_sample::name(e);
+        }
+        os << ",revision\n";
+        for (const bench_record& r : s_records) {
+          os << quote_csv(r.name) << "," << quote_csv(r.element_type) << ","
+             << quote_csv(r.allocator) << "," << r.size << ","
+             << r.stats.samples << "," << r.stats.iterations << ","
+             << r.stats.min << "," << r.stats.median << ","
+             << r.stats.mean << "," << r.stats.stddev << ","
+             << r.stats.p99;
+          for (unsigned e = 0; e < perf_events_count; ++e) {
+            os << ",";
+            if ( r.stats.counters.valid[e] ) { os << r.stats.counters.value[e]; }
+          }
+          os << "," << quote_csv(r.revision) << "\n";
+        }
+      }
+
+    private:
+      static std::string quote_json( const std::string& str ) {
+        std::ostringstream os;
+        os << '"';
+        for (char c : str) {
+          if ( c == '"' || c == '\\' ) { os << '\\' << c; }
+          else if ( static_cast<unsigned char>(c) < 0x20 ) {
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+               << static_cast<int>(c) << std::dec;
+          }
+          else { os << c; }
+        }
+        os << '"';
+        return os.str();
+      }
+
+      static std::string quote_csv( const std::string& str ) {
+        if ( str.find_first_of( ",\"\n" ) == std::string::npos ) { return str; }
+        std::string quoted = "\"";
+        for (char c : str) {
+          if ( c == '"' ) { quoted += '"'; }
+          quoted += c;
+        }
+        return quoted + "\"";
+      }
+
+      /* input, only what write_json() and write_csv() produce */
+
+      void add_fields( const fields_t& f ) {
+        bench_record r;
+        r.name = field( f, "name" );
+        r.element_type = field( f, "element_type" );
+        r.allocator = field( f, "allocator" );
+        r.revision = field( f, "revision" );
+        r.size = std::strtoull( field( f, "size" ).c_str(), nullptr, 10 );
+        r.stats.samples = std::strtoull( field( f, "samples" ).c_str(), nullptr, 10 );
+        r.stats.iterations = std::strtoull( field( f, "iterations" ).c_str(), nullptr, 10 );
+        r.stats.min = std::atof( field( f, "min_ns" ).c_str() );
+        r.stats.median = std::atof( field( f, "median_ns" ).c_str() );
+        r.stats.mean = std::atof( field( f, "mean_ns" ).c_str() );
+        r.stats.stddev = std::atof( field( f, "stddev_ns" ).c_str() );
+        r.stats.p99 = std::atof( field( f, "p99_ns" ).c_str() );
+        for (unsigned e = 0; e < perf_events_count; ++e) {
+          const std::string value = field( f, perf_sample::name(e) );
+          r.stats.counters.valid[e] = !value.empty();
+          r.stats.counters.value[e] = std::atof( value.c_str() );
+        }
+        s_records.push_back( r );
+      }
+
+      static std::string field( const fields_t& f, const std::string& name ) {
+        const fields_t::const_iterator it = f.find( name );
+        return (it != f.end()) ? it->second : std::string();
+      }
+
+      bool read_json( const std::string& text ) {
+        std::size_t pos = text.find( '[' ) + 1;
+        for (;;) {
+          skip_space( text, pos );
+          if ( pos >= text.size() ) { return false; }
+          if ( text[pos] == ']' ) { return true; }
+          if ( text[pos] == ',' ) { ++pos; continue; }
+          if ( text[pos] != '{' ) { return false; }
+          ++pos;
+
+          fields_t f;
+          for (;;) {
+            skip_space( text, pos );
+            if ( pos >= text.size() ) { return false; }
+            if ( text[pos] == '}' ) { ++pos; break; }
+            if ( text[pos] == ',' ) { ++pos; continue; }
+            std::string key, value;
+            if ( !read_json_string( text, pos, key ) ) { return false; }
+            skip_space( text, pos );
+            if ( pos >= text.size() || text[pos] != ':' ) { return false; }
+            ++pos;
+            skip_space( text, pos );
+            if ( pos < text.size() && text[pos] == '"' ) {
+              if ( !read_json_string( text, pos, value ) ) { return false; }
+            }
+            else {
+              const std::size_t end = text.find_first_of( ",}", pos );
+              if ( end == std::string::npos ) { return false; }
+              value = text.substr( pos, end - pos );
+              while ( !value.empty() && std::isspace(
+                        static_cast<unsigned char>( value[value.size()-1] ) ) )
+                value.erase( value.size()-1 );
+              pos = end;
+            }
+            f[key] = value;
+          }
+          add_fields( f );
+        }
+      }
+
+      static void skip_space( const std::string& text, std::size_t& pos ) {
+        while ( pos < text.size() &&
+                std::isspace( static_cast<unsigned char>( text[pos] ) ) ) ++pos;
+      }
+
+      static bool read_json_string( const std::string& text, std::size_t& pos,
+        std::string& str )
+      {
+        if ( text[pos] != '"' ) { return false; }
+        for (++pos; pos < text.size(); ++pos) {
+          if ( text[pos] == '"' ) { ++pos; return true; }
+          if ( text[pos] == '\\' && pos+1 < text.size() ) {
+            ++pos;
+            if ( text[pos] == 'u' && pos+4 < text.size() ) {
+              str += static_cast<char>(
+                std::strtol( text.substr( pos+1, 4 ).c_str(), nullptr, 16 ) );
+              pos += 4;
+              continue;
+            }
+          }
+          str += text[pos];
+        }
+        return false;
+      }
+
+      bool read_csv( const std::string& text ) {
+        std::vector< std::vector<std::string> > rows;
+        std::vector<std::string> row;
+        std::string cell;
+        bool quoted = false;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+          const char c = text[i];
+          if ( quoted ) {
+            if ( c == '"' && i+1 < text.size() && text[i+1] == '"' ) {
+              cell += '"';
+              ++i;
+            }
+            else if ( c == '"' ) { quoted = false; }
+            else { cell += c; }
+          }
+          else if ( c == '"' ) { quoted = true; }
+          else if ( c == ',' ) { row.push_back( cell ); cell.clear(); }
+          else if ( c == '\n' ) {
+            row.push_back( cell );
+            cell.clear();
+            rows.push_back( row );
+            row.clear();
+          }
+          else if ( c != '\r' ) { cell += c; }
+        }
+        if ( rows.empty() ) { return false; }
+
+        const std::vector<std::string>& header = rows.front();
+        for (std::size_t r = 1; r < rows.size(); ++r) {
+          fields_t f;
+          for (std::size_t c = 0; c < header.size() && c < rows[r].size(); ++c) {
+            f[ header[c] ] = rows[r][c];
+          }
+          add_fields( f );
+        }
+        return true;
+      }
+  };
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <cstddef>
+
+#include "benchmark.hpp"
+#include "bench_report.hpp"
+#include "trace.hpp"
+
+namespace shared {
+
+  /* input data */
+
+  enum data_distribution {
+    dist_sorted,
+    dist_reversed,
+    dist_shuffled,
+    dist_few_unique,
+    dist_organ_pipe,
+    dist_count
+  };
+
+  inline const char* distribution_name( unsigned d ) {
+    static const char* names[dist_count] = {
+      "sorted", "reversed", "shuffled", "few-unique", "organ-pipe"
+    };
+    return names[d];
+  }
+
+  /*
+    Fills a sized random access container with keys in [0, size), converted
+    to its value_type: 0..n-1, n-1..0, a permutation of 0..n-1, 16 distinct
+    keys in random order, or 0..n/2..0. The data is generated in place, so
+    even a billion elements need no more memory than the container itself.
+  */
+  template< class C >
+  void fill_data( C& con, data_distribution d, unsigned seed = 1 ) {
+    typedef typename C::value_type value_type;
+    const std::size_t n = con.size();
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<std::size_t> few(0, 15);
+    for (std::size_t i = 0; i < n; ++i) {
+      std::size_t key = i;
+      switch (d) {
+        case dist_reversed:   key = n - 1 - i; break;
+        case dist_few_unique: key = few(gen); break;
+        case dist_organ_pipe: key = (i < n / 2) ? i : n - 1 - i; break;
+        default: break;
+      }
+      con[i] = static_cast<value_type>(key);
+    }
+    if ( d == dist_shuffled ) { std::shuffle( con.begin(), con.end(), gen ); }
+  }
+
+  /* ======================================================================== */
+
+  struct bench_options {
+    std::vector<std::size_t> sizes;
+    std::vector<data_distribution> distributions;
+    unsigned samples;
+    double min_sample_ms;
+    bool counters;
+    unsigned seed;
+    std::string filter;
+    std::string output;
+    std::string trace;
+
+    bench_options()
+    : sizes( 1, 1000000 ), samples(10), min_sample_ms(2.0),
+      counters(false), seed(1)
+    {
+      for (unsigned d = 0; d < dist_count; ++d) {
+        distributions.push_back( static_cast<data_distribution>(d) );
+      }
+    }
+
+    static void usage( const char* program ) {
+      std::cerr << "usage: " << program << " [options]\n"
+        "  --size N[,N...]   element counts, with K/M/B suffixes (1M)\n"
+        "  --dist D[,D...]   sorted, reversed, shuffled, few-unique,\n"
+        "                    organ-pipe or all (all)\n"
+        "  --samples N       timed samples per benchmark (10)\n"
+        "  --min-time MS     shortest sample for repeated calls (2)\n"
+        "  --counters        collect hardware performance counters\n"
+        "  --seed N          random data seed (1)\n"
+        "  --filter TEXT     run only benchmarks whose name contains TEXT\n"
+        "  --output FILE     save results as .json or .csv\n"
+        "  --trace FILE      save scope traces as Chrome trace-event JSON\n"
+        "                    (needs a build with SHARED_TRACE defined)"
+        << std::endl;
+    }
+
+    // 1K = 1000, 1M = 10^6, 1B = 10^9; 0 for malformed input
+    static std::size_t parse_size( const std::string& str ) {
+      char* end = nullptr;
+      const double value = std::strtod( str.c_str(), &end );
+      double scale = 1.0;
+      switch (*end) {
+        case 'k': case 'K': scale = 1e3; ++end; break;
+        case 'm': case 'M': scale = 1e6; ++end; break;
+        case 'b': case 'B': case 'g': case 'G': scale = 1e9; ++end; break;
+        default: break;
+      }
+      if ( end == str.c_str() || *end != '\0' || value <= 0.0 ) { return 0; }
+      return static_cast<std::size_t>( value * scale + 0.5 );
+    }
+
+    static std::vector<std::string> split( const std::string& list ) {
+      std::vector<std::string> items;
+      std::string::size_type start = 0, comma;
+      while ( (comma = list.find( ',', start )) != std::string::npos ) {
+        items.push_back( list.substr( start, comma - start ) );
+        start = comma + 1;
+      }
+      items.push_back( list.substr( start ) );
+      return items;
+    }
+
+    bool parse( int argc, char* argv[] ) {
+      for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ( arg == "--counters" ) { counters = true; continue; }
+        if ( arg == "--help" || arg == "-h" || i + 1 >= argc ) {
+          return false;
+        }
+        const std::string value = argv[++i];
+
+        if ( arg == "--size" ) {
+          sizes.clear();
+          for (const std::string& item : split(value)) {
+            const std::size_t size = parse_size( item );
+            if ( size == 0 ) { return false; }
+            sizes.push_back( size );
+          }
+        }
+        else if ( arg == "--dist" ) {
+          if ( value == "all" ) { continue; }
+          distributions.clear();
+          for (const std::string& item : split(value)) {
+            unsigned d = 0;
+            while ( d < dist_count && item != distribution_name(d) ) { ++d; }
+            if ( d == dist_count ) { return false; }
+            distributions.push_back( static_cast<data_distribution>(d) );
+          }
+        }
+        else if ( arg == "--samples" ) {
+          samples = std::strtoul( value.c_str(), nullptr, 10 );
+          if ( samples == 0 ) { return false; }
+        }
+        else if ( arg == "--min-time" ) {
+          min_sample_ms = std::atof( value.c_str() );
+        }
+        else if ( arg == "--seed" ) {
+          seed = std::strtoul( value.c_str(), nullptr, 10 );
+        }
+        else if ( arg == "--filter" ) { filter = value; }
+        else if ( arg == "--output" ) { output = value; }
+        else if ( arg == "--trace" ) { trace = value; }
+        else { return false; }
+      }
+      return true;
+    }
+  };
+
+  /* ======================================================================== */
+
+  /*
+    Driver for the standalone benchmark executables: parses bench_options,
+    runs every selected benchmark through the shared harness, prints one
+    line per result and collects them into a bench_report, saved by
+    finish() when --output is given.
+
+      int main( int argc, char* argv[] ) {
+        shared::bench_suite suite( argc, argv );
+        if (!suite) { return 2; }
+        for (std::size_t size : suite.options().sizes) {
+          suite.run( "name", "element type", "allocator", size, func );
+        }
+        return suite.finish();
+      }
+  */
+  class bench_suite {
+    private:
+      bench_options opts;
+      benchmark harness;
+      bench_report report;
+      bool valid;
+
+    public:
+      bench_suite( int argc, char* argv[] )
+      : valid( opts.parse( argc, argv ) )
+      {
+        if (!valid) { bench_options::usage( argv[0] ); }
+        harness = benchmark( opts.samples, 1, opts.min_sample_ms, opts.counters );
+      }
+
+      explicit operator bool() const { return valid; }
+
+      inline const bench_options& options() const { return opts; }
+
+      // false for benchmarks excluded by --filter, to skip preparing data
+      bool selected( const std::string& name ) const {
+        return opts.filter.empty() || name.find( opts.filter ) != std::string::npos;
+      }
+
+      // a section header between groups of results
+      void section( const std::string& title ) const {
+        std::cout << "\n" << title << ":" << std::endl;
+      }
+
+      // the result, or all zeros when excluded by --filter
+      template< typename F >
+      bench_stats run( const std::string& name, const std::string& element_type,
+        const std::string& allocator, std::size_t size, F func )
+      {
+        if ( !selected(name) ) { return bench_stats(); }
+        return add( name, element_type, allocator, size, harness.run( func ) );
+      }
+
+      template< typename Setup, typename F >
+      bench_stats run( const std::string& name, const std::string& element_type,
+        const std::string& allocator, std::size_t size, Setup setup, F func )
+      {
+        if ( !selected(name) ) { return bench_stats(); }
+        return add( name, element_type, allocator, size,
+          harness.run( setup, func ) );
+      }
+
+      int finish() const {
+        if ( !opts.output.empty() && !report.save( opts.output ) ) {
+          std::cerr << "can't write " << opts.output << std::endl;
+          return 1;
+        }
+        if ( !opts.trace.empty() && !TRACE_FLUSH( opts.trace.c_str() ) ) {
+          std::cerr << "can't write " << opts.trace
+            << " (is SHARED_TRACE defined?)" << std::endl;
+          return 1;
+        }
+        return 0;
+      }
+
+    private:
+      const bench_stats& add( const std::string& name,
+        const std::string& element_type, const std::string& allocator,
+        std::size_t size, const bench_stats& s )
+      {
+        std::cout << "  " << name << " [" << element_type << ", " << allocator
+          << "]: " << s << std::endl;
+        if ( s.counters.any_valid() ) {
+          std::cout << "      " << s.counters << std::endl;
+        }
+        report.add( bench_record( name, element_type, allocator, size, s ) );
+        return s;
+      }
+  };
+}
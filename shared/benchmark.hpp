@@ -0,0 +1,175 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <sstream>
+#include <iomanip>
+#include <atomic>
+#include <memory>
+
+#include "perf_counters.hpp"
+
+namespace shared {
+
+  /* optimization barriers */
+
+  // makes the compiler assume value is read, so computing it can't be elided
+  template< typename T >
+  inline void do_not_optimize( const T& value ) {
+    #if defined(__GNUC__)
+      asm volatile( "" : : "r,m"(value) : "memory" );
+    #else
+      static const void* volatile sink;
+      sink = &value;
+      std::atomic_signal_fence( std::memory_order_seq_cst );
+    #endif
+  }
+
+  // makes the compiler assume all memory is read and written
+  inline void clobber_memory() {
+    #if defined(__GNUC__)
+      asm volatile( "" : : : "memory" );
+    #else
+      std::atomic_signal_fence( std::memory_order_seq_cst );
+    #endif
+  }
+
+  /* ======================================================================== */
+
+  // all times are nanoseconds per single call
+  struct bench_stats {
+    std::size_t samples;
+    std::size_t iterations;  // calls per sample
+    double min, median, mean, stddev, p99;
+    perf_sample counters;    // per single call, when collected
+
+    // sorts the samples in place
+    static bench_stats from_samples( std::vector<double>& ns,
+      std::size_t iterations )
+    {
+      bench_stats s = bench_stats();
+      s.samples = ns.size();
+      s.iterations = iterations;
+      if ( ns.empty() ) { return s; }
+
+      std::sort( ns.begin(), ns.end() );
+      const std::size_t n = ns.size();
+      s.min = ns.front();
+      s.median = (n % 2) ? ns[n/2] : (ns[n/2 - 1] + ns[n/2]) / 2.0;
+      // nearest-rank percentile
+      s.p99 = ns[ static_cast<std::size_t>( std::ceil( 0.99 * n ) ) - 1 ];
+
+      double sum = 0.0;
+      for (double x : ns) { sum += x; }
+      s.mean = sum / n;
+      double sq_sum = 0.0;
+      for (double x : ns) { sq_sum += (x - s.mean) * (x - s.mean); }
+      s.stddev = (n > 1) ? std::sqrt( sq_sum / (n - 1) ) : 0.0;
+      return s;
+    }
+
+    static std::string format_time( double ns ) {
+      static const char* units[] = { "ns", "us", "ms", "s" };
+      unsigned unit = 0;
+      while ( unit < 3 && ns >= 1000.0 ) { ns /= 1000.0; ++unit; }
+      std::ostringstream os;
+      os << std::fixed << std::setprecision( (ns < 10.0) ? 2 : 1 )
+         << ns << " " << units[unit];
+      return os.str();
+    }
+  };
+
+  inline std::ostream& operator<< ( std::ostream& os, const bench_stats& s ) {
+    return os << "median " << bench_stats::format_time( s.median )
+      << " (min " << bench_stats::format_time( s.min )
+      << ", mean " << bench_stats::format_time( s.mean )
+      << " +- " << bench_stats::format_time( s.stddev )
+      << ", p99 " << bench_stats::format_time( s.p99 )
+      << "; " << s.samples << "x" << s.iterations << ")";
+  }
+
+  /* ======================================================================== */
+
+  /*
+    Repeated measurement with warm-up: run(func) first finds how many calls
+    make a sample last at least min_sample_ns, then times that many calls
+    per sample. run(setup, func) calls untimed setup() before every single
+    timed func() call, for functions that consume their input (sorting).
+    Results should go through do_not_optimize() or clobber_memory() inside
+    func, otherwise the optimizer may drop the work altogether.
+    With count_events set, hardware counters are collected around every
+    sample too (see perf_counters.hpp) and averaged per call.
+  */
+  struct benchmark {
+    typedef std::chrono::steady_clock clock;
+
+    unsigned samples;
+    unsigned warmup_runs;
+    double min_sample_ns;
+    bool count_events;
+
+    explicit benchmark( unsigned sample_count = 30, unsigned warmup = 1,
+      double min_sample_ms = 2.0, bool events = false )
+    : samples(sample_count), warmup_runs(warmup),
+      min_sample_ns(min_sample_ms * 1e6), count_events(events) {}
+
+    template< typename F >
+    bench_stats run( F func ) const {
+      for (unsigned i = 0; i < warmup_runs; ++i) { func(); }
+
+      std::size_t iterations = 1;
+      for (;;) {
+        const double elapsed = time_calls( func, iterations );
+        if ( elapsed >= min_sample_ns ) { break; }
+        const double factor = (elapsed > 0.0) ?
+          std::min( 10.0, std::ceil( 1.2 * min_sample_ns / elapsed ) ) : 10.0;
+        iterations = static_cast<std::size_t>( iterations * factor );
+      }
+
+      return run_samples( []() {}, func, iterations );
+    }
+
+    template< typename Setup, typename F >
+    bench_stats run( Setup setup, F func ) const {
+      for (unsigned i = 0; i < warmup_runs; ++i) { setup(); func(); }
+      return run_samples( setup, func, 1 );
+    }
+
+    template< typename F >
+    static double time_calls( F& func, std::size_t iterations ) {
+      clobber_memory();
+      const clock::time_point start = clock::now();
+      for (std::size_t i = 0; i < iterations; ++i) { func(); }
+      const clock::time_point end = clock::now();
+      clobber_memory();
+      return std::chrono::duration<double, std::nano>( end - start ).count();
+    }
+
+  private:
+    template< typename Setup, typename F >
+    bench_stats run_samples( const Setup& setup, F& func,
+      std::size_t iterations ) const
+    {
+      std::unique_ptr<perf_counters> counters(
+        count_events ? new perf_counters() : nullptr );
+      perf_sample counted;
+
+      std::vector<double> ns( samples );
+      for (double& sample : ns) {
+        setup();
+        if (counters) { counters->start(); }
+        sample = time_calls( func, iterations ) / iterations;
+        if (counters) { counted += counters->stop(); }
+      }
+
+      bench_stats s = bench_stats::from_samples( ns, iterations );
+      s.counters = counted;
+      s.counters /= static_cast<double>(samples) * iterations;
+      return s;
+    }
+  };
+}
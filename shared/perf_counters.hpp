@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <iomanip>
+
+#if defined(__linux__)
+  #include <unistd.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <linux/perf_event.h>
+#endif
+
+namespace shared {
+
+  /*
+    Hardware performance counters of the calling thread, and its page
+    faults (a software event), via Linux perf_event_open. Each event is
+    opened on its own, so a machine (or a container, or perf_event_paranoid
+    setting) that lacks some of them still reports the rest; on other
+    systems nothing is available and every call is a no-op. Counts are
+    scaled by enabled/running time, in case the kernel had to multiplex the
+    counters.
+  */
+
+  enum perf_event_id {
+    perf_cycles,
+    perf_instructions,
+    perf_cache_misses,
+    perf_branch_misses,
+    perf_tlb_misses,
+    perf_page_faults,
+    perf_events_count
+  };
+
+  struct perf_sample {
+    double value[perf_events_count];
+    bool valid[perf_events_count];
+
+    perf_sample() {
+      for (unsigned e = 0; e < perf_events_count; ++e) {
+        value[e] = 0.0;
+        valid[e] = false;
+      }
+    }
+
+    bool any_valid() const {
+      for (unsigned e = 0; e < perf_events_count; ++e) {
+        if ( valid[e] ) { return true; }
+      }
+      return false;
+    }
+
+    perf_sample& operator+= ( const perf_sample& other ) {
+      for (unsigned e = 0; e < perf_events_count; ++e) {
+        value[e] += other.value[e];
+        valid[e] = other.valid[e];
+      }
+      return *this;
+    }
+
+    perf_sample& operator/= ( double divisor ) {
+      for (unsigned e = 0; e < perf_events_count; ++e) {
+        value[e] /= divisor;
+      }
+      return *this;
+    }
+
+    static const char* name( unsigned e ) {
+      static const char* names[perf_events_count] = {
+        "cycles", "instructions", "cache-misses", "branch-misses", "tlb-misses",
+        "page-faults"
+      };
+      return names[e];
+    }
+  };
+
+  inline std::ostream& operator<< ( std::ostream& os, const perf_sample& s ) {
+    if ( !s.any_valid() ) { return os << "counters n/a"; }
+    const std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(0);
+    for (unsigned e = 0; e < perf_events_count; ++e) {
+      os << (e ? ", " : "") << perf_sample::name(e) << " ";
+      if ( s.valid[e] ) { os << s.value[e]; } else { os << "n/a"; }
+    }
+    if ( s.valid[perf_cycles] && s.valid[perf_instructions] &&
+         s.value[perf_cycles] > 0 )
+    {
+      os << std::setprecision(2) << ", IPC "
+         << s.value[perf_instructions] / s.value[perf_cycles];
+    }
+    os.flags(flags);
+    return os;
+  }
+
+  /* ======================================================================== */
+
+  class perf_counters {
+    private:
+      int fd[perf_events_count];
+
+    public:
+      perf_counters() {
+        #if defined(__linux__)
+          static const std::uint32_t types[perf_events_count] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+            PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_SOFTWARE
+          };
+          static const std::uint64_t configs[perf_events_count] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_DTLB |
+              (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_SW_PAGE_FAULTS
+          };
+          for (unsigned e = 0; e < perf_events_count; ++e) {
+            perf_event_attr attr;
+            std::memset( &attr, 0, sizeof(attr) );
+            attr.size = sizeof(attr);
+            attr.type = types[e];
+            attr.config = configs[e];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fd[e] = static_cast<int>(
+              syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 ) );
+          }
+        #else
+          for (unsigned e = 0; e < perf_events_count; ++e) { fd[e] = -1; }
+        #endif
+      }
+
+      ~perf_counters() {
+        #if defined(__linux__)
+          for (unsigned e = 0; e < perf_events_count; ++e) {
+            if ( fd[e] >= 0 ) { close( fd[e] ); }
+          }
+        #endif
+      }
+
+      bool available() const {
+        for (unsigned e = 0; e < perf_events_count; ++e) {
+          if ( fd[e] >= 0 ) { return true; }
+        }
+        return false;
+      }
+
+      void start() {
+        #if defined(__linux__)
+          for (unsigned e = 0; e < perf_events_count; ++e) {
+            if ( fd[e] < 0 ) { continue; }
+            ioctl( fd[e], PERF_EVENT_IOC_RESET, 0 );
+            ioctl( fd[e], PERF_EVENT_IOC_ENABLE, 0 );
+          }
+        #endif
+      }
+
+      perf_sample stop() {
+        perf_sample s;
+        #if defined(__linux__)
+          for (unsigned e = 0; e < perf_events_count; ++e) {
+            if ( fd[e] >= 0 ) { ioctl( fd[e], PERF_EVENT_IOC_DISABLE, 0 ); }
+          }
+          for (unsigned e = 0; e < perf_events_count; ++e) {
+            std::uint64_t data[3];  // value, time enabled, time running
+            if ( fd[e] < 0 ||
+                 read( fd[e], data, sizeof(data) ) != sizeof(data) ) {
+              continue;
+            }
+            s.valid[e] = true;
+            s.value[e] = (data[2] > 0) ?
+              static_cast<double>(data[0]) * data[1] / data[2] : 0.0;
+          }
+        #endif
+        return s;
+      }
+
+    private:
+      perf_counters( const perf_counters& );
+      perf_counters& operator= ( const perf_counters& );
+  };
+}
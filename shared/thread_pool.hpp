@@ -0,0 +1,481 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+  #include <sched.h>
+  #include <pthread.h>
+#endif
+
+namespace shared {
+
+  class thread_pool;
+  class task_group;
+
+  namespace pool_detail {
+
+    struct task {
+      task_group* group;
+      explicit task( task_group* g ) : group(g) {}
+      virtual ~task() {}
+      virtual void run() = 0;
+    };
+
+    template< typename F >
+    struct task_impl : task {
+      F func;
+      task_impl( task_group* g, F&& f ) : task(g), func( std::move(f) ) {}
+      void run() { func(); }
+    };
+
+    /*
+      Chase-Lev deque of one worker (Le et al., "Correct and efficient
+      work-stealing for weak memory models", 2013). The owner pushes and
+      takes at the bottom without locks, thieves take the oldest task at
+      the top with one compare-exchange. When full, the ring is doubled;
+      the old rings are kept until the deque is destroyed, since a thief
+      may still read from them.
+    */
+    class work_deque {
+      private:
+        struct ring {
+          std::int64_t capacity;
+          std::unique_ptr< std::atomic<task*>[] > slots;
+
+          explicit ring( std::int64_t cap )
+          : capacity(cap), slots( new std::atomic<task*>[cap] ) {}
+
+          inline task* get( std::int64_t i ) const {
+            return slots[i & (capacity - 1)].load( std::memory_order_relaxed );
+          }
+          inline void put( std::int64_t i, task* t ) {
+            slots[i & (capacity - 1)].store( t, std::memory_order_relaxed );
+          }
+        };
+
+        // top and bottom on their own cache lines, thieves only write top
+        std::atomic<std::int64_t> top;
+        char pad_top[64 - sizeof(std::atomic<std::int64_t>)];
+        std::atomic<std::int64_t> bottom;
+        char pad_bottom[64 - sizeof(std::atomic<std::int64_t>)];
+        std::atomic<ring*> array;
+        std::vector< std::unique_ptr<ring> > rings;
+
+      public:
+        work_deque() : top(0), bottom(0) {
+          rings.emplace_back( new ring( 256 ) );
+          array.store( rings.back().get() );
+        }
+
+        inline bool empty() const {
+          return top.load( std::memory_order_acquire )
+            >= bottom.load( std::memory_order_acquire );
+        }
+
+        // by the owner
+        void push( task* t ) {
+          const std::int64_t b = bottom.load( std::memory_order_relaxed );
+          const std::int64_t tp = top.load( std::memory_order_acquire );
+          ring* a = array.load( std::memory_order_relaxed );
+          if ( b - tp > a->capacity - 1 ) { a = grow( a, tp, b ); }
+          a->put( b, t );
+          bottom.store( b + 1, std::memory_order_release );
+        }
+
+        // by the owner, the newest task or nullptr
+        task* take() {
+          const std::int64_t b = bottom.load( std::memory_order_relaxed ) - 1;
+          ring* a = array.load( std::memory_order_relaxed );
+          bottom.store( b, std::memory_order_seq_cst );
+          std::int64_t t = top.load( std::memory_order_seq_cst );
+          task* x = nullptr;
+          if ( t <= b ) {
+            x = a->get( b );
+            if ( t == b ) {
+              // the last task, a thief may be taking it too
+              if ( !top.compare_exchange_strong( t, t + 1,
+                     std::memory_order_seq_cst, std::memory_order_relaxed ) )
+              {
+                x = nullptr;
+              }
+              bottom.store( b + 1, std::memory_order_relaxed );
+            }
+          }
+          else {
+            bottom.store( b + 1, std::memory_order_relaxed );
+          }
+          return x;
+        }
+
+        // by any thread, the oldest task or nullptr (also on a lost race)
+        task* steal() {
+          std::int64_t t = top.load( std::memory_order_seq_cst );
+          const std::int64_t b = bottom.load( std::memory_order_seq_cst );
+          if ( t >= b ) { return nullptr; }
+          ring* a = array.load( std::memory_order_acquire );
+          task* x = a->get( t );
+          if ( !top.compare_exchange_strong( t, t + 1,
+                 std::memory_order_seq_cst, std::memory_order_relaxed ) )
+          {
+            return nullptr;
+          }
+          return x;
+        }
+
+      private:
+        ring* grow( ring* a, std::int64_t t, std::int64_t b ) {
+          rings.emplace_back( new ring( 2 * a->capacity ) );
+          ring* bigger = rings.back().get();
+          for (std::int64_t i = t; i < b; ++i) { bigger->put( i, a->get(i) ); }
+          array.store( bigger, std::memory_order_release );
+          return bigger;
+        }
+    };
+
+  } //end of namespace "pool_detail"
+
+  /*
+    Work-stealing task scheduler. A pool of N threads starts N-1 workers,
+    each with its own deque: tasks spawned by a worker go to the bottom of
+    its deque and it runs them newest first, which keeps recursive
+    fork/join depth-first and cache-warm; idle workers steal the oldest
+    task of a random other worker, i.e. the largest piece of work left.
+    Tasks spawned by other threads go through a shared queue. A thread
+    waiting in task_group::sync() runs tasks itself instead of blocking,
+    so the caller is the N-th thread and nested fork/join never deadlocks.
+    thread_pool(1) runs every task on the spot. Workers spin briefly when
+    out of work, then sleep until the next spawn. With pin = true, worker
+    w is pinned to CPU w+1, CPU 0 being left to the caller.
+  */
+  class thread_pool {
+    friend class task_group;
+
+    private:
+      typedef pool_detail::task task;
+
+      struct worker {
+        pool_detail::work_deque deque;
+        std::thread thread;
+      };
+
+      struct thread_slot {
+        thread_pool* pool;
+        unsigned index;       // of the worker, none for other threads
+      };
+
+      enum : unsigned {
+        none = ~0u,          // thread_slot index of a thread not in the pool
+        idle_rounds = 64     // steal attempts before a worker goes to sleep
+      };
+
+      std::vector< std::unique_ptr<worker> > workers;
+      bool pinned;
+
+      std::mutex inject_mutex;
+      std::deque<task*> injected;
+      std::atomic<std::size_t> injected_count;
+
+      std::mutex mutex;
+      std::condition_variable wake;
+      std::atomic<unsigned> sleepers;
+      unsigned long epoch;
+      bool stopping;
+
+    public:
+      explicit thread_pool( unsigned threads = default_threads(),
+        bool pin = false )
+      : pinned(pin), injected_count(0), sleepers(0), epoch(0), stopping(false)
+      {
+        workers.reserve( std::max( 1u, threads ) - 1 );
+        for (unsigned w = 1; w < std::max( 1u, threads ); ++w) {
+          workers.emplace_back( new worker() );
+        }
+        try {
+          for (unsigned w = 0; w < workers.size(); ++w) {
+            workers[w]->thread = std::thread( [this, w]() { work( w ); } );
+          }
+        } catch (...) {
+          // no destructor will run, and a joinable std::thread must not
+          // be destroyed
+          stop();
+          throw;
+        }
+      }
+
+      ~thread_pool() { stop(); }
+
+      // the pool shared by the sorts and parallel algorithms, one thread per core
+      static thread_pool& instance() {
+        static thread_pool pool;
+        return pool;
+      }
+
+      static unsigned default_threads() {
+        return std::max( 1u, std::thread::hardware_concurrency() );
+      }
+
+      // threads running tasks, the caller included
+      inline unsigned size() const {
+        return static_cast<unsigned>( workers.size() ) + 1;
+      }
+
+      inline bool is_pinned() const { return pinned; }
+
+      /*
+        body(0) ... body(count-1) as tasks, the range is split in halves
+        down to single indices so idle threads steal large pieces. Returns
+        when all calls are done; the first exception thrown by a body is
+        rethrown then.
+      */
+      template< typename F >
+      void parallel_for( std::size_t count, F body );
+
+    private:
+      thread_pool( const thread_pool& );
+      thread_pool& operator= ( const thread_pool& );
+
+      // wakes the workers to exit and joins the started ones
+      void stop() {
+        {
+          std::lock_guard<std::mutex> lock( mutex );
+          stopping = true;
+          ++epoch;
+        }
+        wake.notify_all();
+        for (std::unique_ptr<worker>& w : workers) {
+          if ( w->thread.joinable() ) { w->thread.join(); }
+        }
+      }
+
+      static thread_slot& current() {
+        static thread_local thread_slot slot = { nullptr, none };
+        return slot;
+      }
+
+      // the index of the calling worker of this pool, or none
+      inline unsigned own_index() const {
+        const thread_slot& slot = current();
+        return (slot.pool == this) ? slot.index : none;
+      }
+
+      void submit( task* t ) {
+        const unsigned self = own_index();
+        if ( self != none ) {
+          workers[self]->deque.push( t );
+        }
+        else {
+          std::lock_guard<std::mutex> lock( inject_mutex );
+          injected.push_back( t );
+          injected_count.fetch_add( 1 );
+        }
+        notify();
+      }
+
+      // wakes a sleeping worker, if any, after new work was published
+      void notify() {
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( sleepers.load( std::memory_order_relaxed ) == 0 ) { return; }
+        {
+          std::lock_guard<std::mutex> lock( mutex );
+          ++epoch;
+        }
+        wake.notify_one();
+      }
+
+      // own newest task, else a stolen one, else an injected one
+      task* find_task( unsigned self ) {
+        if ( self != none ) {
+          task* t = workers[self]->deque.take();
+          if ( t != nullptr ) { return t; }
+        }
+        const unsigned count = static_cast<unsigned>( workers.size() );
+        if ( count == 0 ) { return nullptr; }
+        const unsigned start = next_random() % count;
+        for (unsigned i = 0; i < count; ++i) {
+          const unsigned victim = (start + i) % count;
+          if ( victim == self ) { continue; }
+          task* t = workers[victim]->deque.steal();
+          if ( t != nullptr ) { return t; }
+        }
+        if ( injected_count.load( std::memory_order_acquire ) != 0 ) {
+          std::lock_guard<std::mutex> lock( inject_mutex );
+          if ( !injected.empty() ) {
+            task* t = injected.front();
+            injected.pop_front();
+            injected_count.fetch_sub( 1 );
+            return t;
+          }
+        }
+        return nullptr;
+      }
+
+      bool has_work() const {
+        if ( injected_count.load() != 0 ) { return true; }
+        for (const std::unique_ptr<worker>& w : workers) {
+          if ( !w->deque.empty() ) { return true; }
+        }
+        return false;
+      }
+
+      inline void execute( task* t );
+
+      void work( unsigned index ) {
+        current().pool = this;
+        current().index = index;
+        if ( pinned ) { pin( index + 1 ); }
+        for (;;) {
+          task* t = nullptr;
+          for (unsigned round = 0; t == nullptr && round < idle_rounds; ++round) {
+            t = find_task( index );
+            if ( t == nullptr ) { std::this_thread::yield(); }
+          }
+          if ( t != nullptr ) {
+            execute( t );
+            continue;
+          }
+          std::unique_lock<std::mutex> lock( mutex );
+          sleepers.fetch_add( 1 );
+          std::atomic_thread_fence( std::memory_order_seq_cst );
+          if ( !stopping && !has_work() ) {
+            const unsigned long seen = epoch;
+            wake.wait( lock, [&]() { return stopping || epoch != seen; } );
+          }
+          sleepers.fetch_sub( 1 );
+          if ( stopping ) { return; }
+        }
+      }
+
+      static unsigned next_random() {
+        static thread_local unsigned state = static_cast<unsigned>(
+          std::hash<std::thread::id>()( std::this_thread::get_id() ) ) | 1u;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+      }
+
+      static void pin( unsigned cpu ) {
+        #if defined(__linux__)
+          cpu_set_t set;
+          CPU_ZERO( &set );
+          CPU_SET( cpu % default_threads(), &set );
+          pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+        #else
+          (void)cpu;
+        #endif
+      }
+  };
+
+  /* ======================================================================== */
+
+  /*
+    Fork/join on a thread_pool: spawn() queues a call, sync() waits until
+    all calls spawned so far are done, running queued tasks meanwhile, and
+    rethrows the first exception one of them threw. Tasks may spawn into
+    their own or other groups. The destructor waits too, but never throws.
+  */
+  class task_group {
+    friend class thread_pool;
+
+    private:
+      thread_pool& pool;
+      std::atomic<std::size_t> pending;
+      std::exception_ptr error;
+      std::mutex error_mutex;
+
+    public:
+      explicit task_group( thread_pool& p = thread_pool::instance() )
+      : pool(p), pending(0) {}
+
+      ~task_group() { wait(); }
+
+      template< typename F >
+      void spawn( F func ) {
+        if ( pool.workers.empty() ) {
+          try { func(); }
+          catch (...) { fail( std::current_exception() ); }
+          return;
+        }
+        pending.fetch_add( 1, std::memory_order_relaxed );
+        pool.submit( new pool_detail::task_impl<F>( this, std::move(func) ) );
+      }
+
+      void sync() {
+        wait();
+        if ( error ) {
+          std::exception_ptr e;
+          std::swap( e, error );
+          std::rethrow_exception( e );
+        }
+      }
+
+    private:
+      task_group( const task_group& );
+      task_group& operator= ( const task_group& );
+
+      void wait() {
+        const unsigned self = pool.own_index();
+        while ( pending.load( std::memory_order_acquire ) != 0 ) {
+          pool_detail::task* t = pool.find_task( self );
+          if ( t != nullptr ) { pool.execute( t ); }
+          else { std::this_thread::yield(); }
+        }
+      }
+
+      void fail( std::exception_ptr e ) {
+        std::lock_guard<std::mutex> lock( error_mutex );
+        if ( !error ) { error = e; }
+      }
+
+      // the group may be gone once pending drops, so it is the last access
+      void done() { pending.fetch_sub( 1, std::memory_order_release ); }
+  };
+
+  inline void thread_pool::execute( task* t ) {
+    task_group* group = t->group;
+    try { t->run(); }
+    catch (...) { group->fail( std::current_exception() ); }
+    delete t;
+    group->done();
+  }
+
+  namespace pool_detail {
+    template< typename F >
+    void split_range( task_group& group, std::size_t from, std::size_t to,
+      const F& body )
+    {
+      while ( to - from > 1 ) {
+        const std::size_t mid = from + (to - from) / 2;
+        group.spawn( [&group, mid, to, &body]() {
+          split_range( group, mid, to, body );
+        } );
+        to = mid;
+      }
+      body( from );
+    }
+  } //end of namespace "pool_detail"
+
+  template< typename F >
+  void thread_pool::parallel_for( std::size_t count, F body ) {
+    if ( count == 0 ) { return; }
+    if ( workers.empty() || count == 1 ) {
+      for (std::size_t i = 0; i < count; ++i) { body(i); }
+      return;
+    }
+    task_group group( *this );
+    try { pool_detail::split_range( group, 0, count, body ); }
+    catch (...) { group.fail( std::current_exception() ); }
+    group.sync();
+  }
+}
@@ -0,0 +1,72 @@
+/*
+  Compares two benchmark result files written by shared::bench_report.
+  usage: bench_compare <baseline.json|csv> <current.json|csv> [threshold %]
+  Prints the median change of every configuration found in both files and
+  marks significant ones (see shared::bench_change); exits with 1 if any
+  of them regressed by more than the threshold (5% by default), so it can
+  gate a build.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <map>
+#include <cstdlib>
+
+#include <bench_report.hpp>
+
+int main( int argc, char* argv[] ) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0]
+      << " <baseline> <current> [threshold %]" << std::endl;
+    return 2;
+  }
+  const double threshold = (argc > 3) ? std::atof( argv[3] ) / 100.0 : 0.05;
+
+  shared::bench_report baseline, current;
+  if ( !baseline.load( argv[1] ) || baseline.records().empty() ) {
+    std::cerr << "can't read " << argv[1] << std::endl;
+    return 2;
+  }
+  if ( !current.load( argv[2] ) || current.records().empty() ) {
+    std::cerr << "can't read " << argv[2] << std::endl;
+    return 2;
+  }
+
+  std::map<std::string, const shared::bench_record*> before;
+  for (const shared::bench_record& r : baseline.records()) {
+    before[ r.key() ] = &r;
+  }
+
+  unsigned regressions = 0, improvements = 0, missing = 0;
+  std::cout << std::fixed << std::setprecision(1);
+  for (const shared::bench_record& r : current.records()) {
+    const auto it = before.find( r.key() );
+    if ( it == before.end() ) {
+      ++missing;
+      continue;
+    }
+    const shared::bench_record& old = *it->second;
+    const shared::bench_change c =
+      shared::bench_change::compare( old.stats, r.stats, threshold );
+    regressions += c.regression;
+    improvements += c.improvement;
+
+    std::cout << r.key() << ": "
+      << shared::bench_stats::format_time( old.stats.median ) << " -> "
+      << shared::bench_stats::format_time( r.stats.median ) << " ("
+      << std::showpos << (c.ratio - 1.0) * 100.0 << std::noshowpos << "%)"
+      << ( c.regression ? "  REGRESSION" :
+           c.improvement ? "  improved" :
+           c.significant ? "" : "  (noise)" )
+      << std::endl;
+  }
+
+  std::cout << "\n" << baseline.records().front().revision << " -> "
+    << current.records().front().revision << ": " << regressions
+    << " regressions, " << improvements << " improvements beyond "
+    << threshold * 100.0 << "%";
+  if (missing) { std::cout << ", " << missing << " new configurations"; }
+  std::cout << std::endl;
+  return regressions ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+/*
+  Scope tracing for hot paths. TRACE_SCOPE("name") records the time spent
+  until the end of the enclosing block, TRACE_FLUSH("file.json") writes
+  everything recorded so far as a Chrome trace-event file (chrome://tracing,
+  Perfetto). Both expand to nothing unless SHARED_TRACE is defined, which
+  has to be done for the whole program, as instrumented headers change.
+
+  Every thread records into its own ring buffer of the last trace_capacity
+  scopes, so recording takes no locks: the thread writes the slot and
+  publishes it with a release store. Timestamps are TSC ticks on x86 and
+  steady_clock (the clock of shared::measure) elsewhere; ticks are
+  converted to microseconds at flush time, calibrated against
+  steady_clock. Flushing while traced threads run is safe: slots are
+  atomics guarded by a sequence number like a seqlock, and scopes
+  overwritten during the copy are dropped.
+*/
+
+#if defined(SHARED_TRACE)
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
+
+namespace shared {
+namespace trace {
+
+  typedef std::uint64_t tick_t;
+  typedef std::chrono::steady_clock clock;
+
+  inline tick_t now() {
+    #if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+    #else
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        clock::now().time_since_epoch() ).count();
+    #endif
+  }
+
+  static const std::size_t trace_capacity = std::size_t(1) << 16;
+
+  struct event {
+    const char* name;  // string literal, never copied
+    tick_t start;
+    tick_t end;
+  };
+
+  /* ======================================================================== */
+
+  // single writer (the owning thread), any number of readers
+  class thread_buffer {
+    private:
+      // seq is the index of the event in the slot plus one, 0 while the
+      // writer changes it; relaxed stores, plain moves on x86
+      struct slot {
+        std::atomic<std::size_t> seq;
+        std::atomic<const char*> name;
+        std::atomic<tick_t> start;
+        std::atomic<tick_t> end;
+      };
+
+      slot slots[trace_capacity];
+      std::atomic<std::size_t> head;
+
+    public:
+      const unsigned thread_id;
+
+      explicit thread_buffer( unsigned id ) : head(0), thread_id(id) {
+        for (slot& s : slots) { s.seq.store( 0, std::memory_order_relaxed ); }
+      }
+
+      inline void push( const char* name, tick_t start, tick_t end ) {
+        const std::size_t h = head.load( std::memory_order_relaxed );
+        slot& s = slots[ h & (trace_capacity - 1) ];
+        s.seq.store( 0, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+        s.name.store( name, std::memory_order_relaxed );
+        s.start.store( start, std::memory_order_relaxed );
+        s.end.store( end, std::memory_order_relaxed );
+        s.seq.store( h + 1, std::memory_order_release );
+        head.store( h + 1, std::memory_order_release );
+      }
+
+      // slots the writer changed while they were copied are skipped
+      void snapshot( std::vector<event>& out ) const {
+        const std::size_t last = head.load( std::memory_order_acquire );
+        const std::size_t first = (last > trace_capacity) ? last - trace_capacity : 0;
+        for (std::size_t i = first; i < last; ++i) {
+          const slot& s = slots[ i & (trace_capacity - 1) ];
+          if ( s.seq.load( std::memory_order_acquire ) != i + 1 ) { continue; }
+          event e;
+          e.name = s.name.load( std::memory_order_relaxed );
+          e.start = s.start.load( std::memory_order_relaxed );
+          e.end = s.end.load( std::memory_order_relaxed );
+          std::atomic_thread_fence( std::memory_order_acquire );
+          if ( s.seq.load( std::memory_order_relaxed ) == i + 1 ) {
+            out.push_back( e );
+          }
+        }
+      }
+
+    private:
+      thread_buffer( const thread_buffer& );
+      thread_buffer& operator= ( const thread_buffer& );
+  };
+
+  /* ======================================================================== */
+
+  // owns the buffers of all threads, which outlive them until exit
+  class registry {
+    private:
+      std::mutex lock;
+      std::vector< std::unique_ptr<thread_buffer> > buffers;
+      const clock::time_point clock_start;
+      const tick_t tick_start;
+
+      registry() : clock_start( clock::now() ), tick_start( now() ) {}
+
+    public:
+      static registry& instance() {
+        static registry r;
+        return r;
+      }
+
+      thread_buffer* add() {
+        std::lock_guard<std::mutex> guard( lock );
+        buffers.emplace_back(
+          new thread_buffer( static_cast<unsigned>( buffers.size() ) ) );
+        return buffers.back().get();
+      }
+
+      bool write( const char* path ) {
+        const double ticks_per_us = calibrate();
+        std::ofstream file( path );
+        if (!file) { return false; }
+
+        file << std::fixed << std::setprecision(3)
+          << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+        const char* separator = "\n  ";
+        std::lock_guard<std::mutex> guard( lock );
+        std::vector<event> events;
+        for (const std::unique_ptr<thread_buffer>& buffer : buffers) {
+          events.clear();
+          buffer->snapshot( events );
+          for (const event& e : events) {
+            file << separator << "{\"name\": \"" << e.name
+              << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->thread_id
+              << ", \"ts\": "
+              << static_cast<std::int64_t>(e.start - tick_start) / ticks_per_us
+              << ", \"dur\": " << (e.end - e.start) / ticks_per_us << "}";
+            separator = ",\n  ";
+          }
+        }
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+      }
+
+    private:
+      double calibrate() const {
+        const tick_t ticks = now() - tick_start;
+        const double us = std::chrono::duration<double, std::micro>(
+          clock::now() - clock_start ).count();
+        return (us > 0.0 && ticks > 0) ? ticks / us : 1e3;
+      }
+  };
+
+  inline thread_buffer& local_buffer() {
+    static thread_local thread_buffer* buffer = registry::instance().add();
+    return *buffer;
+  }
+
+  // the buffer is looked up before the clock starts, which also makes
+  // the registry start its clock before the first scope does
+  class scope {
+    private:
+      thread_buffer* buffer;
+      const char* name;
+      tick_t start;
+
+    public:
+      explicit scope( const char* scope_name )
+      : buffer( &local_buffer() ), name(scope_name), start( now() ) {}
+
+      ~scope() { buffer->push( name, start, now() ); }
+
+    private:
+      scope( const scope& );
+      scope& operator= ( const scope& );
+  };
+
+  inline bool flush( const char* path ) {
+    return registry::instance().write( path );
+  }
+
+} //end of namespace "trace"
+} //end of namespace "shared"
+
+#define SHARED_TRACE_JOIN2(a, b) a##b
+#define SHARED_TRACE_JOIN(a, b) SHARED_TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(name) \
+  ::shared::trace::scope SHARED_TRACE_JOIN(trace_scope_, __LINE__)( name )
+#define TRACE_FLUSH(path) ::shared::trace::flush( path )
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_FLUSH(path) (false)
+
+#endif